@@ -0,0 +1,89 @@
+/**
+ * Copyright (c) 2025 Paul-Louis Ageneau
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+#include "bench.hpp"
+
+#include <cerrno>
+#include <cstdlib>
+
+namespace {
+
+thread_local uint64_t AllocationsCount = 0;
+
+} // namespace
+
+#if defined(__GLIBC__)
+
+// Allocation functions of the executable interpose those of the C library for the whole
+// process, including FFmpeg and libstdc++, and forward to the glibc implementation
+extern "C" {
+
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t count, size_t size);
+void *__libc_realloc(void *ptr, size_t size);
+void *__libc_memalign(size_t alignment, size_t size);
+
+void *malloc(size_t size) {
+	++AllocationsCount;
+	return __libc_malloc(size);
+}
+
+void *calloc(size_t count, size_t size) {
+	++AllocationsCount;
+	return __libc_calloc(count, size);
+}
+
+void *realloc(void *ptr, size_t size) {
+	++AllocationsCount;
+	return __libc_realloc(ptr, size);
+}
+
+void *memalign(size_t alignment, size_t size) {
+	++AllocationsCount;
+	return __libc_memalign(alignment, size);
+}
+
+void *aligned_alloc(size_t alignment, size_t size) {
+	++AllocationsCount;
+	return __libc_memalign(alignment, size);
+}
+
+int posix_memalign(void **ptr, size_t alignment, size_t size) {
+	if (alignment < sizeof(void *) || (alignment & (alignment - 1)) != 0)
+		return EINVAL;
+
+	++AllocationsCount;
+	void *p = __libc_memalign(alignment, size);
+	if (!p)
+		return ENOMEM;
+
+	*ptr = p;
+	return 0;
+}
+
+} // extern "C"
+
+#endif
+
+namespace rtcast {
+
+namespace bench {
+
+bool AllocationsCounted() {
+#if defined(__GLIBC__)
+	return true;
+#else
+	return false;
+#endif
+}
+
+uint64_t ThreadAllocationsCount() { return AllocationsCount; }
+
+} // namespace bench
+
+} // namespace rtcast
@@ -0,0 +1,157 @@
+/**
+ * Copyright (c) 2025 Paul-Louis Ageneau
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+#include "bench.hpp"
+
+#include <algorithm>
+#include <atomic>
+
+namespace rtcast {
+
+namespace bench {
+
+namespace {
+
+const int ChunkDurationMs = 10; // typical capture period
+const int WarmupChunks = 50; // before counting allocations, lets pools and buffers settle
+const int PacketOverhead = 12 + 10 + 8 + 20; // RTP header, SRTP tag, UDP and IPv4 headers
+const std::chrono::microseconds DefaultFrameDuration(20000);
+const std::chrono::microseconds LowLatencyFrameDurations[] = {std::chrono::microseconds(10000),
+                                                              std::chrono::microseconds(5000),
+                                                              std::chrono::microseconds(2500)};
+
+// Encodes regardless of clients and counts the output
+class BenchAudioEncoder final : public AudioEncoder {
+public:
+	BenchAudioEncoder(shared_ptr<Endpoint> endpoint) : AudioEncoder(AudioCodecName, endpoint) {}
+
+	uint64_t packetsCount() const { return mPacketsCount.load(); }
+	uint64_t bytesCount() const { return mBytesCount.load(); }
+
+protected:
+	bool active() const override { return true; }
+
+	void output(AVPacket *packet) override {
+		mPacketsCount.fetch_add(1, std::memory_order_relaxed);
+		mBytesCount.fetch_add(uint64_t(packet->size), std::memory_order_relaxed);
+		AudioEncoder::output(packet);
+	}
+
+private:
+	std::atomic<uint64_t> mPacketsCount = 0;
+	std::atomic<uint64_t> mBytesCount = 0;
+};
+
+json run(int inputSampleRate, std::chrono::microseconds frameDuration, double seconds) {
+	// Interleaved S16 tone for the whole duration, pushed in capture-sized chunks
+	const int chunkSamples = inputSampleRate * ChunkDurationMs / 1000;
+	const int chunksCount = int(seconds * 1000.) / ChunkDurationMs;
+	std::vector<int16_t> samples(size_t(chunkSamples) * size_t(chunksCount) * AudioChannelsCount);
+	FillTone(samples.data(), chunkSamples * chunksCount, inputSampleRate);
+
+	auto endpoint = std::make_shared<Endpoint>(0);
+	auto encoder = std::make_shared<BenchAudioEncoder>(endpoint);
+	encoder->setFrameDuration(frameDuration);
+	encoder->setDropPolicy(DropPolicy::Block); // backpressure from the ring, measure throughput
+	encoder->start();
+
+	LatencyHistogram pushLatency; // resampling and buffering on the capture thread
+	uint64_t allocationsStart = 0;
+	Meter meter;
+	for (int i = 0; i < chunksCount; ++i) {
+		if (i == WarmupChunks)
+			allocationsStart = ThreadAllocationsCount();
+
+		AudioEncoder::InputFrame input;
+		input.format = AV_SAMPLE_FMT_S16;
+		input.sampleRate = inputSampleRate;
+		input.nbChannels = AudioChannelsCount;
+		input.nbSamples = chunkSamples;
+		input.data = samples.data() + size_t(i) * size_t(chunkSamples) * AudioChannelsCount;
+		input.size = size_t(chunkSamples) * AudioChannelsCount * sizeof(int16_t);
+
+		auto start = std::chrono::steady_clock::now();
+		encoder->push(std::move(input));
+		pushLatency.record(std::chrono::duration_cast<std::chrono::microseconds>(
+		    std::chrono::steady_clock::now() - start));
+	}
+	const uint64_t allocations =
+	    chunksCount > WarmupChunks ? ThreadAllocationsCount() - allocationsStart : 0;
+	encoder->stop();
+	meter.stop();
+
+	auto stats = encoder->stats();
+	json result = meter.report(encoder->packetsCount());
+	result["codec"] = AudioCodecName;
+	result["input_sample_rate"] = inputSampleRate;
+	result["output_sample_rate"] = encoder->sampleRate();
+	result["resampled"] = inputSampleRate != encoder->sampleRate();
+	result["audio_s"] = seconds;
+	result["frame_duration_ms"] = double(frameDuration.count()) / 1000.;
+	result["realtime_factor"] = meter.wallSeconds() > 0. ? seconds / meter.wallSeconds() : 0.;
+	result["cpu_load_realtime"] = meter.cpuSeconds() / seconds; // in cores for a live stream
+	result["packets_per_second"] = double(encoder->packetsCount()) / seconds;
+	result["bitrate"] = double(encoder->bytesCount()) * 8. / seconds;
+	result["wire_bitrate"] =
+	    double(encoder->bytesCount() + encoder->packetsCount() * PacketOverhead) * 8. / seconds;
+	result["push_latency"] = ToJson(pushLatency.summary());
+	if (AllocationsCounted() && chunksCount > WarmupChunks) {
+		// Steady state on the capture thread, excluding the encoder thread
+		result["push_allocations"] = allocations;
+		result["push_allocations_per_chunk"] =
+		    double(allocations) / double(chunksCount - WarmupChunks);
+	}
+	auto ring = encoder->ringStats();
+	result["ring"] = {{"written", ring.written},
+	                  {"read", ring.read},
+	                  {"dropped_newest", ring.droppedNewest},
+	                  {"dropped_oldest", ring.droppedOldest},
+	                  {"underruns", ring.underruns},
+	                  {"blocked", ring.blocked}};
+	result["latency"] = ToJson(stats.latency);
+	return result;
+}
+
+} // namespace
+
+json RunAudio(const Options &options, bool &failed) {
+	// Same duration as the video runs
+	const double seconds = std::max(double(options.frames) / 30., 1.);
+
+	// Resampling at the default frame duration, then the CPU and bandwidth cost of shorter frames
+	std::vector<std::pair<int, std::chrono::microseconds>> configs = {
+	    {48000, DefaultFrameDuration}, {44100, DefaultFrameDuration}};
+	for (auto frameDuration : LowLatencyFrameDurations)
+		configs.emplace_back(48000, frameDuration);
+
+	json results = json::array();
+	for (auto [sampleRate, frameDuration] : configs) {
+		try {
+			json result = run(sampleRate, frameDuration, seconds);
+			if (result.value("push_allocations", uint64_t(0)) > 0) {
+				RTCAST_LOG_ERROR << "Audio push allocated in steady state at " << sampleRate
+				                 << " Hz: " << result["push_allocations"].get<uint64_t>();
+				failed = true;
+			}
+			results.push_back(std::move(result));
+
+		} catch (const std::exception &e) {
+			RTCAST_LOG_ERROR << "Audio run failed at " << sampleRate << " Hz: " << e.what();
+			failed = true;
+			results.push_back({{"codec", AudioCodecName},
+			                   {"input_sample_rate", sampleRate},
+			                   {"frame_duration_ms", double(frameDuration.count()) / 1000.},
+			                   {"error", e.what()}});
+		}
+	}
+	return results;
+}
+
+} // namespace bench
+
+} // namespace rtcast
@@ -0,0 +1,280 @@
+/**
+ * Copyright (c) 2025 Paul-Louis Ageneau
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+#include "bench.hpp"
+
+#include "rtcast/reddepacketizer.hpp"
+#include "rtcast/redencoder.hpp"
+
+#include "rtc/rtc.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+namespace rtcast {
+
+namespace bench {
+
+namespace {
+
+using namespace std::chrono_literals;
+
+const int SampleRate = 48000;
+const int ChunkDurationMs = 20;
+const auto TalkDuration = 3s; // then as long of silence, for DTX
+const auto ReportInterval = 1s; // receiver reports, in audio time
+const int OpusPayloadType = 97;
+const int RedPayloadType = 63;
+const size_t RtpHeaderSize = 12;
+
+struct Config {
+	bool adaptive;
+	unsigned int redundancy; // RED distance, 0 without RED
+};
+
+// Encodes regardless of clients and sends through a link dropping packets at random
+// The link reports the fraction lost per interval to the controller, as receiver reports would,
+// with time derived from RTP timestamps. Frames suppressed by DTX never reach the link, so they
+// do not count as lost, as with sequence numbers on the wire. With RED, packets surviving the
+// link go through the depacketizer of the receiving side, which forwards recovered frames.
+class LossyAudioEncoder final : public AudioEncoder {
+public:
+	LossyAudioEncoder(shared_ptr<Endpoint> endpoint, double lossRate, unsigned int redundancy)
+	    : AudioEncoder(AudioCodecName, endpoint), mLossRate(lossRate),
+	      mRedCounters(std::make_shared<RedDepacketizer::Counters>()) {
+		if (redundancy > 0) {
+			mRedEncoder = std::make_unique<RedEncoder>(OpusPayloadType, redundancy);
+			mRedDepacketizer = std::make_shared<RedDepacketizer>(RedPayloadType, mRedCounters);
+		}
+	}
+
+	void setController(shared_ptr<AudioController> controller) {
+		mController = std::move(controller);
+	}
+
+	uint64_t sentCount() const { return mSent; }
+	uint64_t lostCount() const { return mLost; }
+	uint64_t sentBytes() const { return mSentBytes; }
+	uint64_t deliveredBytes() const { return mDeliveredBytes; }
+	uint64_t deliveredFrames() const { return mDeliveredFrames; }
+	uint64_t recoveredFrames() const { return mRedCounters->recovered.load(); }
+
+protected:
+	bool active() const override { return true; }
+
+	// On the encoder thread
+	void send(shared_ptr<EncodedFrame> frame) override {
+		const auto elapsed = std::chrono::microseconds(int64_t(frame->rtpTimestamp) * 1000000 /
+		                                               SampleRate);
+		if (elapsed - mLastReport >= ReportInterval) {
+			if (mController && mIntervalSent > 0)
+				mController->onLoss(double(mIntervalLost) / double(mIntervalSent),
+				                    mOrigin + elapsed);
+
+			mIntervalSent = mIntervalLost = 0;
+			mLastReport = elapsed;
+		}
+
+		shared_ptr<const EncodedFrame> payload = frame;
+		if (mRedEncoder)
+			payload = mRedEncoder->encode(frame);
+
+		++mSent;
+		++mIntervalSent;
+		mSentBytes += payload->size();
+		const uint16_t sequence = mSequence++;
+		mState ^= mState << 13;
+		mState ^= mState >> 17;
+		mState ^= mState << 5;
+		if (double(mState) / 4294967296. < mLossRate) {
+			++mLost;
+			++mIntervalLost;
+			return;
+		}
+
+		mDeliveredBytes += payload->size();
+		if (mRedDepacketizer)
+			mDeliveredFrames += receive(*payload, sequence);
+		else
+			++mDeliveredFrames;
+
+		AudioEncoder::send(std::move(frame));
+	}
+
+private:
+	// Returns the number of frames forwarded to the decoder
+	size_t receive(const EncodedFrame &payload, uint16_t sequence) {
+		auto packet = rtc::make_message(RtpHeaderSize + payload.size(), rtc::Message::Binary);
+		byte *data = packet->data();
+		std::memset(data, 0, RtpHeaderSize);
+		data[0] = byte(0x80);
+		data[1] = byte(RedPayloadType);
+		data[2] = byte(sequence >> 8);
+		data[3] = byte(sequence);
+		for (int i = 0; i < 4; ++i)
+			data[4 + i] = byte(payload.rtpTimestamp >> (24 - 8 * i));
+
+		std::memcpy(data + RtpHeaderSize, payload.data(), payload.size());
+
+		rtc::message_vector messages;
+		messages.push_back(std::move(packet));
+		mRedDepacketizer->incoming(messages, [](rtc::message_ptr) {});
+		return messages.size();
+	}
+
+	const double mLossRate;
+	shared_ptr<AudioController> mController;
+	unique_ptr<RedEncoder> mRedEncoder;
+	shared_ptr<RedDepacketizer> mRedDepacketizer;
+	const shared_ptr<RedDepacketizer::Counters> mRedCounters;
+	const std::chrono::steady_clock::time_point mOrigin = std::chrono::steady_clock::now();
+
+	// Owned by the encoder thread, read once it is stopped
+	uint32_t mState = 2463534242;
+	std::chrono::microseconds mLastReport = {};
+	uint64_t mIntervalSent = 0;
+	uint64_t mIntervalLost = 0;
+	uint64_t mSent = 0;
+	uint64_t mLost = 0;
+	uint64_t mSentBytes = 0;
+	uint64_t mDeliveredBytes = 0;
+	uint64_t mDeliveredFrames = 0;
+	uint16_t mSequence = 0;
+};
+
+json run(double lossRate, Config config, double seconds) {
+	auto endpoint = std::make_shared<Endpoint>(0);
+	auto encoder = std::make_shared<LossyAudioEncoder>(endpoint, lossRate, config.redundancy);
+	encoder->setDropPolicy(DropPolicy::Block);
+
+	shared_ptr<AudioController> controller;
+	if (config.adaptive) {
+		controller = std::make_shared<AudioController>(encoder);
+		encoder->setController(controller);
+	}
+
+	encoder->start();
+
+	// Tone talk spurts separated by digital silence, pushed as fast as the encoder takes them
+	const int chunkSamples = SampleRate * ChunkDurationMs / 1000;
+	const int chunksCount = int(seconds * 1000.) / ChunkDurationMs;
+	const int talkChunks = int(std::chrono::milliseconds(TalkDuration).count()) / ChunkDurationMs;
+	std::vector<int16_t> samples(size_t(chunkSamples) * AudioChannelsCount);
+	Meter meter;
+	for (int i = 0; i < chunksCount; ++i) {
+		if ((i / talkChunks) % 2 == 0)
+			FillTone(samples.data(), chunkSamples, SampleRate, int64_t(i) * chunkSamples);
+		else
+			std::fill(samples.begin(), samples.end(), int16_t(0));
+
+		AudioEncoder::InputFrame input;
+		input.format = AV_SAMPLE_FMT_S16;
+		input.sampleRate = SampleRate;
+		input.nbChannels = AudioChannelsCount;
+		input.nbSamples = chunkSamples;
+		input.data = samples.data();
+		input.size = samples.size() * sizeof(int16_t);
+		encoder->push(std::move(input));
+	}
+	encoder->stop();
+	encoder->setController(nullptr); // they reference each other
+	meter.stop();
+
+	auto output = encoder->outputStats();
+	json result = meter.report(output.frames);
+	result["loss_rate"] = lossRate;
+	result["adaptive"] = config.adaptive;
+	result["redundancy"] = config.redundancy;
+	result["audio_s"] = seconds;
+	const double sent = double(encoder->sentCount());
+	result["measured_loss"] = sent > 0 ? double(encoder->lostCount()) / sent : 0.;
+	// Frames missing for the decoder, the audible gaps
+	result["frame_loss"] = sent > 0 ? 1. - double(encoder->deliveredFrames()) / sent : 0.;
+	result["recovered_frames"] = encoder->recoveredFrames();
+	result["packets_per_second"] = sent / seconds;
+	result["bitrate"] = double(output.bytes) * 8. / seconds;
+	result["sent_bitrate"] = double(encoder->sentBytes()) * 8. / seconds;
+	result["red_overhead"] =
+	    output.bytes > 0 ? double(encoder->sentBytes()) / double(output.bytes) - 1. : 0.;
+	result["delivered_bitrate"] = double(encoder->deliveredBytes()) * 8. / seconds;
+	result["fec_frames"] = output.fecFrames;
+	result["fec_bytes"] = output.fecBytes;
+	result["fec_share"] = output.bytes > 0 ? double(output.fecBytes) / double(output.bytes) : 0.;
+	result["dtx_frames"] = output.dtxFrames;
+	result["dtx_share"] = output.frames + output.dtxFrames > 0
+	                          ? double(output.dtxFrames) / double(output.frames + output.dtxFrames)
+	                          : 0.;
+	result["reopens"] = output.reopens;
+	// Gap heard on each reopen
+	result["reopen_gap_ms"] =
+	    output.reopens > 0
+	        ? double(output.paddingSamples) * 1000. / double(SampleRate) / double(output.reopens)
+	        : 0.;
+	if (controller) {
+		auto stats = controller->stats();
+		result["controller"] = {{"smoothed_loss", stats.fractionLost},
+		                        {"reports", stats.reports},
+		                        {"changes", stats.changes},
+		                        {"fec", stats.options.fec},
+		                        {"packet_loss", stats.options.packetLoss},
+		                        {"dtx", stats.options.dtx},
+		                        {"bitrate", stats.options.bitrate.value_or(0)}};
+	}
+	return result;
+}
+
+} // namespace
+
+json RunAudioLoss(const Options &options, bool &failed) {
+	// Long enough for several reports and changes at the default interval
+	const double seconds = std::max(double(options.frames) / 30., 20.);
+
+	std::vector<double> lossRates = {0., 0.05, 0.2};
+	if (!options.quick)
+		lossRates = {0., 0.01, 0.02, 0.05, 0.1, 0.2};
+
+	const std::vector<Config> configs = {{false, 0}, {true, 0}, {true, 1}, {true, 2}};
+
+	json results = json::array();
+	for (double lossRate : lossRates) {
+		for (const auto &config : configs) {
+			try {
+				json result = run(lossRate, config, seconds);
+				// The controller must react to significant loss
+				if (config.adaptive && lossRate >= 0.05 &&
+				    result["fec_frames"].get<uint64_t>() == 0) {
+					RTCAST_LOG_ERROR << "Audio FEC was not enabled at " << lossRate << " loss";
+					failed = true;
+				}
+				// RED must recover frames without waiting for later packets
+				if (config.redundancy > 0 && lossRate >= 0.05 &&
+				    result["frame_loss"].get<double>() >= result["measured_loss"].get<double>()) {
+					RTCAST_LOG_ERROR << "Audio RED did not reduce frame loss at " << lossRate
+					                 << " loss";
+					failed = true;
+				}
+				results.push_back(std::move(result));
+
+			} catch (const std::exception &e) {
+				RTCAST_LOG_ERROR << "Audio loss run failed at " << lossRate
+				                 << " loss: " << e.what();
+				failed = true;
+				results.push_back({{"codec", AudioCodecName},
+				                   {"loss_rate", lossRate},
+				                   {"adaptive", config.adaptive},
+				                   {"redundancy", config.redundancy},
+				                   {"error", e.what()}});
+			}
+		}
+	}
+	return results;
+}
+
+} // namespace bench
+
+} // namespace rtcast
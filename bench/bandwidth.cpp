@@ -0,0 +1,222 @@
+/**
+ * Copyright (c) 2025 Paul-Louis Ageneau
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+#include "bench.hpp"
+
+#include "rtcast/bandwidthestimator.hpp"
+
+#include <algorithm>
+
+namespace rtcast {
+
+namespace bench {
+
+namespace {
+
+using namespace std::chrono_literals;
+
+const int64_t MinBitrate = 100000;
+const int64_t MaxBitrate = 8000000;
+const int64_t StartBitrate = 1000000;
+
+const auto Tick = 10ms;
+const auto ReportInterval = 1s; // receiver reports
+const auto BufferDuration = 200ms; // bottleneck queue size at the link capacity
+const double ConvergenceLow = 0.7;
+const double ConvergenceHigh = 1.1;
+
+// Pass thresholds, convergence and utilization only apply to links with loss low enough for the
+// estimate to increase up to the capacity
+const double MaxConvergenceSeconds = 15.;
+const double MinUtilization = 0.8;
+const double MaxExcessLoss = 0.02; // over the random loss, from overflowing the queue
+const double MaxMeanQueueDelayMs = 100.;
+
+struct Phase {
+	std::chrono::seconds start;
+	int64_t capacity; // in bits per second
+};
+
+struct Link {
+	const char *name;
+	std::vector<Phase> phases;
+	double randomLoss;
+	std::chrono::milliseconds baseRtt;
+	bool saturates; // the estimate is expected to reach the capacity
+};
+
+const std::chrono::seconds Duration = 120s;
+
+// Fluid model of a bottleneck link with a drop-tail queue, driven with simulated time
+json simulate(const Link &link) {
+	using clock = BandwidthEstimator::clock;
+	const clock::time_point origin = clock::now();
+	BandwidthEstimator estimator(MinBitrate, MaxBitrate, StartBitrate);
+
+	const double dt = std::chrono::duration<double>(Tick).count();
+	double queueBytes = 0.;
+	double intervalSent = 0., intervalLost = 0.;
+	double totalSent = 0., totalLost = 0.;
+	double maxQueueDelay = 0., queueDelaySum = 0.;
+	uint64_t ticks = 0;
+
+	struct PhaseResult {
+		optional<double> convergence; // seconds after the phase start
+		double delivered = 0.;         // in bytes
+		double estimateSum = 0.;
+		uint64_t ticks = 0;
+	};
+	std::vector<PhaseResult> results(link.phases.size());
+
+	size_t phase = 0;
+	auto nextReport = origin + ReportInterval;
+	for (auto elapsed = clock::duration::zero(); elapsed < Duration; elapsed += Tick) {
+		const auto now = origin + elapsed;
+		while (phase + 1 < link.phases.size() && elapsed >= link.phases[phase + 1].start)
+			++phase;
+
+		const double capacity = double(link.phases[phase].capacity) / 8.; // bytes per second
+		const double rate = double(estimator.estimate(now)) / 8.;
+		auto &result = results[phase];
+		double sinceStart =
+		    std::chrono::duration<double>(elapsed - link.phases[phase].start).count();
+		if (!result.convergence && rate >= capacity * ConvergenceLow &&
+		    rate <= capacity * ConvergenceHigh)
+			result.convergence = sinceStart;
+
+		// Random loss before the bottleneck, then overflow of the bottleneck queue
+		double offered = rate * dt;
+		double lost = offered * link.randomLoss;
+		queueBytes += offered - lost;
+		double served = std::min(queueBytes, capacity * dt);
+		queueBytes -= served;
+		double overflow = std::max(queueBytes - capacity * std::chrono::duration<double>(
+		                                                       BufferDuration)
+		                                                       .count(),
+		                           0.);
+		queueBytes -= overflow;
+		lost += overflow;
+
+		intervalSent += offered;
+		intervalLost += lost;
+		totalSent += offered;
+		totalLost += lost;
+		result.delivered += served;
+		result.estimateSum += rate * 8.;
+		++result.ticks;
+
+		double queueDelay = queueBytes / capacity;
+		maxQueueDelay = std::max(maxQueueDelay, queueDelay);
+		queueDelaySum += queueDelay;
+		++ticks;
+
+		if (now >= nextReport) {
+			double fractionLost = intervalSent > 0. ? intervalLost / intervalSent : 0.;
+			auto rtt = std::chrono::microseconds(link.baseRtt) +
+			           std::chrono::microseconds(int64_t(queueDelay * 1e6));
+			estimator.onReceiverReport(fractionLost, rtt, now);
+			intervalSent = intervalLost = 0.;
+			nextReport += ReportInterval;
+		}
+	}
+
+	json phases = json::array();
+	double deliveredBits = 0., capacityBits = 0.;
+	for (size_t i = 0; i < link.phases.size(); ++i) {
+		const auto &result = results[i];
+		double seconds = double(result.ticks) * dt;
+		double capacity = double(link.phases[i].capacity);
+		deliveredBits += result.delivered * 8.;
+		capacityBits += capacity * seconds;
+
+		json entry;
+		entry["start_s"] = link.phases[i].start.count();
+		entry["capacity"] = link.phases[i].capacity;
+		entry["convergence_s"] = result.convergence ? json(*result.convergence) : json(nullptr);
+		entry["utilization"] = seconds > 0. ? result.delivered * 8. / (capacity * seconds) : 0.;
+		entry["mean_estimate"] = result.ticks > 0 ? result.estimateSum / double(result.ticks) : 0.;
+		phases.push_back(std::move(entry));
+	}
+
+	json result;
+	result["link"] = link.name;
+	result["random_loss"] = link.randomLoss;
+	result["base_rtt_ms"] = link.baseRtt.count();
+	result["duration_s"] = Duration.count();
+	result["utilization"] = capacityBits > 0. ? deliveredBits / capacityBits : 0.;
+	result["loss"] = totalSent > 0. ? totalLost / totalSent : 0.;
+	result["mean_queue_delay_ms"] = ticks > 0 ? queueDelaySum * 1e3 / double(ticks) : 0.;
+	result["max_queue_delay_ms"] = maxQueueDelay * 1e3;
+	result["phases"] = std::move(phases);
+	return result;
+}
+
+// Logs and returns false if the result is outside the thresholds
+bool check(const Link &link, const json &result) {
+	bool passed = true;
+	double excessLoss = result["loss"].get<double>() - link.randomLoss;
+	if (excessLoss > MaxExcessLoss) {
+		RTCAST_LOG_ERROR << "Link " << link.name << " overflowed, loss " << excessLoss
+		                 << " over the random loss";
+		passed = false;
+	}
+
+	if (double delay = result["mean_queue_delay_ms"].get<double>(); delay > MaxMeanQueueDelayMs) {
+		RTCAST_LOG_ERROR << "Link " << link.name << " mean queuing delay is " << delay << " ms";
+		passed = false;
+	}
+
+	if (!link.saturates)
+		return passed;
+
+	if (double utilization = result["utilization"].get<double>(); utilization < MinUtilization) {
+		RTCAST_LOG_ERROR << "Link " << link.name << " utilization is " << utilization;
+		passed = false;
+	}
+
+	for (const auto &phase : result["phases"]) {
+		const auto &convergence = phase["convergence_s"];
+		if (convergence.is_null() || convergence.get<double>() > MaxConvergenceSeconds) {
+			RTCAST_LOG_ERROR << "Link " << link.name << " did not converge to "
+			                 << phase["capacity"].get<int64_t>() << " bit/s within "
+			                 << MaxConvergenceSeconds << " s";
+			passed = false;
+		}
+	}
+
+	return passed;
+}
+
+} // namespace
+
+json RunBandwidth([[maybe_unused]] const Options &options, bool &failed) {
+	// Random loss between 2% and 10% holds the estimate, above it decreases
+	const std::vector<Link> links = {
+	    {"clean", {{0s, 2000000}}, 0., 40ms, true},
+	    {"lossy_1pct", {{0s, 2000000}}, 0.01, 40ms, true},
+	    {"lossy_5pct", {{0s, 2000000}}, 0.05, 40ms, false},
+	    {"lossy_15pct", {{0s, 2000000}}, 0.15, 40ms, false},
+	    {"step", {{0s, 3000000}, {40s, 1000000}, {80s, 3000000}}, 0., 40ms, true},
+	    {"long_rtt", {{0s, 2000000}}, 0.01, 300ms, true},
+	};
+
+	json results = json::array();
+	for (const auto &link : links) {
+		json result = simulate(link);
+		if (!check(link, result))
+			failed = true;
+
+		results.push_back(std::move(result));
+	}
+
+	return results;
+}
+
+} // namespace bench
+
+} // namespace rtcast
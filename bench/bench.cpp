@@ -0,0 +1,156 @@
+/**
+ * Copyright (c) 2025 Paul-Louis Ageneau
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+#include "bench.hpp"
+
+extern "C" {
+#include <libavutil/pixdesc.h>
+}
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <stdexcept>
+#include <thread>
+
+#include <sys/resource.h>
+#include <unistd.h>
+
+namespace rtcast {
+
+namespace bench {
+
+namespace {
+
+const double ToneFrequency = 440.;
+const double Pi = 3.14159265358979323846;
+
+} // namespace
+
+Meter::Meter() : mWallStart(clock::now()), mCpuStart(ProcessCpuSeconds()) {}
+
+void Meter::stop() {
+	if (mStopped)
+		return;
+
+	mWallEnd = clock::now();
+	mCpuEnd = ProcessCpuSeconds();
+	mStopped = true;
+}
+
+double Meter::wallSeconds() const {
+	auto end = mStopped ? mWallEnd : clock::now();
+	return std::chrono::duration<double>(end - mWallStart).count();
+}
+
+double Meter::cpuSeconds() const {
+	double end = mStopped ? mCpuEnd : ProcessCpuSeconds();
+	return end - mCpuStart;
+}
+
+json Meter::report(uint64_t frames) const {
+	double wall = wallSeconds();
+	double cpu = cpuSeconds();
+	json result;
+	result["frames"] = frames;
+	result["wall_s"] = wall;
+	result["cpu_s"] = cpu;
+	result["fps"] = wall > 0. ? double(frames) / wall : 0.;
+	result["cpu_us_per_frame"] = frames > 0 ? cpu * 1e6 / double(frames) : 0.;
+	result["cpu_load"] = wall > 0. ? cpu / wall : 0.; // in cores
+	result["rss_bytes"] = CurrentRssBytes();
+	result["peak_rss_bytes"] = PeakRssBytes();
+	return result;
+}
+
+unsigned int ThreadsCount(const Options &options) {
+	if (options.threads > 0)
+		return options.threads;
+
+	return std::max(std::thread::hardware_concurrency(), 1u);
+}
+
+double ProcessCpuSeconds() {
+	struct rusage usage = {};
+	if (getrusage(RUSAGE_SELF, &usage) != 0)
+		return 0.;
+
+	auto seconds = [](const struct timeval &tv) {
+		return double(tv.tv_sec) + double(tv.tv_usec) / 1e6;
+	};
+	return seconds(usage.ru_utime) + seconds(usage.ru_stime);
+}
+
+int64_t CurrentRssBytes() {
+	// Total and resident sizes in pages
+	std::ifstream statm("/proc/self/statm");
+	int64_t size = 0, resident = 0;
+	if (!(statm >> size >> resident))
+		return 0;
+
+	return resident * int64_t(sysconf(_SC_PAGESIZE));
+}
+
+int64_t PeakRssBytes() {
+	struct rusage usage = {};
+	if (getrusage(RUSAGE_SELF, &usage) != 0)
+		return 0;
+
+	return int64_t(usage.ru_maxrss) * 1024; // in kilobytes on Linux
+}
+
+json ToJson(const LatencySummary &summary) {
+	return json{{"count", summary.count},
+	            {"p50_us", summary.p50.count()},
+	            {"p99_us", summary.p99.count()},
+	            {"max_us", summary.max.count()}};
+}
+
+json ToJson(const LatencyStats &stats) {
+	json result = json::object();
+	for (const auto &[stage, summary] : stats)
+		if (summary.count > 0)
+			result[PipelineStageName(stage)] = ToJson(summary);
+
+	return result;
+}
+
+void FillPattern(AVFrame *frame, int seed) {
+	const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(AVPixelFormat(frame->format));
+	if (!desc)
+		throw std::invalid_argument("Unknown pixel format");
+
+	for (int p = 0; p < AV_NUM_DATA_POINTERS && frame->data[p]; ++p) {
+		int shift = p == 0 ? 0 : desc->log2_chroma_h;
+		int rows = (frame->height + (1 << shift) - 1) >> shift;
+		int bytes = std::abs(frame->linesize[p]);
+		for (int y = 0; y < rows; ++y) {
+			uint8_t *row = frame->data[p] + ptrdiff_t(y) * frame->linesize[p];
+			for (int x = 0; x < bytes; ++x) {
+				// Triangle wave moving with the seed, within the limited range
+				int t = (x + 2 * y + seed * 8 + p * 85) % 512;
+				int v = t < 256 ? t : 511 - t;
+				row[x] = uint8_t(16 + v * 219 / 255);
+			}
+		}
+	}
+}
+
+void FillTone(int16_t *samples, int count, int sampleRate, int64_t offset) {
+	for (int i = 0; i < count; ++i) {
+		double t = double(offset + i) / double(sampleRate);
+		auto value = int16_t(8000. * std::sin(2. * Pi * ToneFrequency * t));
+		for (int c = 0; c < AudioChannelsCount; ++c)
+			samples[size_t(i) * AudioChannelsCount + size_t(c)] = value;
+	}
+}
+
+} // namespace bench
+
+} // namespace rtcast
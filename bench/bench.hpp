@@ -0,0 +1,94 @@
+/**
+ * Copyright (c) 2025 Paul-Louis Ageneau
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef RTCAST_BENCH_H
+#define RTCAST_BENCH_H
+
+#include "rtcast/rtcast.hpp"
+
+#include <nlohmann/json.hpp>
+
+#include <chrono>
+
+namespace rtcast {
+
+namespace bench {
+
+using json = nlohmann::json;
+
+struct Options {
+	int width = 1280;
+	int height = 720;
+	int frames = 300; // per video run, audio runs use the equivalent duration at 30 fps
+	unsigned int clients = 100;
+	unsigned int threads = 0; // hardware concurrency if zero
+	bool quick = false;       // fewer configurations, for smoke runs
+	string url;               // viewers connect to this endpoint instead of an in-process one
+};
+
+// Wall time, CPU time of the whole process, and memory over a measured section
+class Meter final {
+public:
+	Meter();
+
+	void stop();
+
+	double wallSeconds() const;
+	double cpuSeconds() const;
+
+	// Throughput, CPU per unit, and resident memory
+	json report(uint64_t units) const;
+
+private:
+	using clock = std::chrono::steady_clock;
+
+	clock::time_point mWallStart;
+	clock::time_point mWallEnd;
+	double mCpuStart = 0.;
+	double mCpuEnd = 0.;
+	bool mStopped = false;
+};
+
+unsigned int ThreadsCount(const Options &options);
+
+double ProcessCpuSeconds();
+int64_t CurrentRssBytes();
+int64_t PeakRssBytes();
+
+// Heap allocations made by the calling thread, only counted if AllocationsCounted()
+bool AllocationsCounted();
+uint64_t ThreadAllocationsCount();
+
+json ToJson(const LatencySummary &summary); // in microseconds
+json ToJson(const LatencyStats &stats);
+
+// Deterministic content, smooth enough to be compressible and to compare scalers
+void FillPattern(AVFrame *frame, int seed);
+
+// Audio runs encode interleaved S16 input as captured
+const char *const AudioCodecName = "libopus";
+const int AudioChannelsCount = 2;
+
+// Tone of count samples per channel, offset is the position of the first sample in the stream
+void FillTone(int16_t *samples, int count, int sampleRate, int64_t offset = 0);
+
+// Scenarios return an array of results and set failed on a correctness error
+json RunConvert(const Options &options, bool &failed);
+json RunEncode(const Options &options, bool &failed);
+json RunAudio(const Options &options, bool &failed);
+json RunAudioLoss(const Options &options, bool &failed);
+json RunFanout(const Options &options, bool &failed);
+json RunBandwidth(const Options &options, bool &failed);
+json RunViewers(const Options &options, bool &failed);
+json RunDmaBuf(const Options &options, bool &failed);
+
+} // namespace bench
+
+} // namespace rtcast
+
+#endif
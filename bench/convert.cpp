@@ -0,0 +1,232 @@
+/**
+ * Copyright (c) 2025 Paul-Louis Ageneau
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+#include "bench.hpp"
+
+#include "rtcast/frameconverter.hpp"
+#include "rtcast/pixelconvert.hpp"
+
+extern "C" {
+#include <libswscale/swscale.h>
+}
+
+#include <algorithm>
+#include <cstdlib>
+#include <stdexcept>
+
+namespace rtcast {
+
+namespace bench {
+
+namespace {
+
+struct Format {
+	const char *name;
+	AVPixelFormat pixelFormat;
+	AVColorRange range;
+};
+
+const Format Formats[] = {
+    {"yuyv422", AV_PIX_FMT_YUYV422, AVCOL_RANGE_MPEG},
+    {"nv12", AV_PIX_FMT_NV12, AVCOL_RANGE_MPEG},
+    {"yuv422p", AV_PIX_FMT_YUV422P, AVCOL_RANGE_MPEG},
+    {"yuv444p", AV_PIX_FMT_YUV444P, AVCOL_RANGE_MPEG},
+    {"yuvj420p", AV_PIX_FMT_YUVJ420P, AVCOL_RANGE_JPEG}, // range compression only
+};
+
+// Tolerance of kernels against swscale, in LSB
+const int MaxSwscaleDiff = 4;
+const double MaxSwscaleMeanDiff = 1.;
+
+const pixel::Isa Isas[] = {pixel::Isa::Scalar, pixel::Isa::Sse41, pixel::Isa::Avx2,
+                           pixel::Isa::Neon};
+
+shared_ptr<AVFrame> alloc_frame(int width, int height, AVPixelFormat pixelFormat,
+                                AVColorRange range) {
+	auto frame = shared_ptr<AVFrame>(av_frame_alloc(), [](AVFrame *p) { av_frame_free(&p); });
+	if (!frame)
+		throw std::runtime_error("Failed to allocate AVFrame");
+
+	frame->format = pixelFormat;
+	frame->width = width;
+	frame->height = height;
+	frame->color_range = range;
+	if (av_frame_get_buffer(frame.get(), 0) < 0)
+		throw std::runtime_error("Failed to allocate buffer for frame");
+
+	return frame;
+}
+
+struct Difference {
+	int max = 0;
+	double mean = 0.;
+};
+
+// Compares two I420 frames of the same size
+Difference compare_i420(const AVFrame *a, const AVFrame *b) {
+	Difference diff;
+	uint64_t sum = 0, count = 0;
+	for (int p = 0; p < 3; ++p) {
+		int width = p == 0 ? a->width : (a->width + 1) / 2;
+		int height = p == 0 ? a->height : (a->height + 1) / 2;
+		for (int y = 0; y < height; ++y) {
+			const uint8_t *ra = a->data[p] + ptrdiff_t(y) * a->linesize[p];
+			const uint8_t *rb = b->data[p] + ptrdiff_t(y) * b->linesize[p];
+			for (int x = 0; x < width; ++x) {
+				int d = std::abs(int(ra[x]) - int(rb[x]));
+				diff.max = std::max(diff.max, d);
+				sum += uint64_t(d);
+			}
+			count += uint64_t(width);
+		}
+	}
+	diff.mean = count > 0 ? double(sum) / double(count) : 0.;
+	return diff;
+}
+
+// Runs the function once to warm up, then returns the mean duration in nanoseconds
+template <typename F> double time_ns(int iterations, F func) {
+	func();
+	auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < iterations; ++i)
+		func();
+
+	auto elapsed = std::chrono::steady_clock::now() - start;
+	return std::chrono::duration<double, std::nano>(elapsed).count() / double(iterations);
+}
+
+json throughput(double ns, int width, int height) {
+	return json{{"ns_per_frame", ns},
+	            {"fps", ns > 0. ? 1e9 / ns : 0.},
+	            {"mpix_per_s", ns > 0. ? double(width) * double(height) * 1e3 / ns : 0.}};
+}
+
+json run_format(const Format &format, const Options &options, bool &failed) {
+	const int width = options.width;
+	const int height = options.height;
+	const int iterations = options.quick ? std::max(options.frames / 10, 10) : options.frames;
+
+	auto input = alloc_frame(width, height, format.pixelFormat, format.range);
+	FillPattern(input.get(), 0);
+
+	json result;
+	result["format"] = format.name;
+	result["width"] = width;
+	result["height"] = height;
+	result["iterations"] = iterations;
+
+	auto reference = alloc_frame(width, height, AV_PIX_FMT_YUV420P, AVCOL_RANGE_MPEG);
+	const bool hasKernel = pixel::HasI420Kernel(format.pixelFormat, width, height);
+	result["has_kernel"] = hasKernel;
+
+	// Kernels, checked bit-exact against the scalar one
+	json kernels = json::array();
+	if (hasKernel) {
+		pixel::ConvertToI420(input.get(), reference.get(), 0, height, pixel::Isa::Scalar);
+		for (pixel::Isa isa : Isas) {
+			json kernel;
+			kernel["isa"] = pixel::IsaName(isa);
+			kernel["supported"] = pixel::IsSupported(isa);
+			if (!pixel::IsSupported(isa)) {
+				kernels.push_back(std::move(kernel));
+				continue;
+			}
+
+			auto output = alloc_frame(width, height, AV_PIX_FMT_YUV420P, AVCOL_RANGE_MPEG);
+			pixel::ConvertToI420(input.get(), output.get(), 0, height, isa);
+			Difference diff = compare_i420(reference.get(), output.get());
+			kernel["bit_exact"] = diff.max == 0;
+			if (diff.max != 0) {
+				RTCAST_LOG_ERROR << "Kernel " << pixel::IsaName(isa) << " for " << format.name
+				                 << " differs from scalar, max difference " << diff.max;
+				failed = true;
+			}
+
+			double ns = time_ns(iterations, [&]() {
+				pixel::ConvertToI420(input.get(), output.get(), 0, height, isa);
+			});
+			kernel.update(throughput(ns, width, height));
+			kernels.push_back(std::move(kernel));
+		}
+	}
+	result["kernels"] = std::move(kernels);
+
+	// swscale baseline with the flags of FrameConverter
+	{
+		auto context = unique_ptr_deleter<SwsContext>(
+		    sws_getContext(width, height, format.pixelFormat, width, height, AV_PIX_FMT_YUV420P,
+		                   SWS_FAST_BILINEAR | SWS_FULL_CHR_H_INT | SWS_ACCURATE_RND, nullptr,
+		                   nullptr, nullptr),
+		    sws_freeContext);
+		if (!context)
+			throw std::runtime_error("Failed to create swscale context");
+
+		const int *coefficients = sws_getCoefficients(SWS_CS_DEFAULT);
+		int srcRange = format.range == AVCOL_RANGE_JPEG ? 1 : 0;
+		sws_setColorspaceDetails(context.get(), coefficients, srcRange, coefficients, 0, 0,
+		                         1 << 16, 1 << 16);
+
+		auto output = alloc_frame(width, height, AV_PIX_FMT_YUV420P, AVCOL_RANGE_MPEG);
+		auto scale = [&]() {
+			sws_scale(context.get(), input->data, input->linesize, 0, height, output->data,
+			          output->linesize);
+		};
+
+		json swscale = throughput(time_ns(iterations, scale), width, height);
+		if (hasKernel) {
+			// Kernels average chroma over 2x2 blocks, swscale filters, so values differ slightly
+			Difference diff = compare_i420(reference.get(), output.get());
+			swscale["kernel_max_diff"] = diff.max;
+			swscale["kernel_mean_diff"] = diff.mean;
+			if (diff.max > MaxSwscaleDiff || diff.mean > MaxSwscaleMeanDiff) {
+				RTCAST_LOG_ERROR << "Kernels for " << format.name << " differ from swscale, max "
+				                 << "difference " << diff.max << ", mean " << diff.mean;
+				failed = true;
+			}
+		}
+		result["swscale"] = std::move(swscale);
+	}
+
+	// FrameConverter, which picks the best kernel and splits the frame across threads
+	json converters = json::array();
+	unsigned int maxThreads = ThreadsCount(options);
+	std::vector<unsigned int> threadCounts;
+	for (unsigned int threads : {1u, 2u, 4u})
+		if (threads < maxThreads)
+			threadCounts.push_back(threads);
+
+	threadCounts.push_back(maxThreads);
+	for (unsigned int threads : threadCounts) {
+		FrameConverter converter(threads);
+		auto output = alloc_frame(width, height, AV_PIX_FMT_YUV420P, AVCOL_RANGE_MPEG);
+		Meter meter;
+		double ns = time_ns(iterations, [&]() { converter.convert(input.get(), output.get()); });
+		meter.stop();
+
+		json entry = throughput(ns, width, height);
+		entry["threads"] = threads;
+		entry["cpu_us_per_frame"] = meter.cpuSeconds() * 1e6 / double(iterations + 1);
+		converters.push_back(std::move(entry));
+	}
+	result["converter"] = std::move(converters);
+	return result;
+}
+
+} // namespace
+
+json RunConvert(const Options &options, bool &failed) {
+	json results = json::array();
+	for (const auto &format : Formats)
+		results.push_back(run_format(format, options, failed));
+
+	return results;
+}
+
+} // namespace bench
+
+} // namespace rtcast
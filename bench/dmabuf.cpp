@@ -0,0 +1,166 @@
+/**
+ * Copyright (c) 2025 Paul-Louis Ageneau
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+#include "bench.hpp"
+
+#include "rtcast/dmabufcache.hpp"
+
+#ifdef __linux__
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#include <chrono>
+#include <stdexcept>
+
+namespace rtcast {
+
+namespace bench {
+
+namespace {
+
+#ifdef __linux__
+
+const size_t CacheEntries = 32; // default of DmaBufCache
+const size_t BufferSize = 64 * 1024;
+const int HitIterations = 100000;
+
+// memfd stands in for capture buffers, it is mappable like a DMA-BUF but has no sync ioctl
+class MemFd final {
+public:
+	explicit MemFd(uint8_t fill) {
+		mFd = ::memfd_create("rtcast-bench", MFD_CLOEXEC);
+		if (mFd < 0)
+			throw std::runtime_error("memfd_create failed");
+
+		std::vector<uint8_t> data(BufferSize, fill);
+		if (::ftruncate(mFd, off_t(BufferSize)) < 0 ||
+		    ::pwrite(mFd, data.data(), data.size(), 0) != ssize_t(data.size())) {
+			::close(mFd);
+			throw std::runtime_error("Failed to fill memfd");
+		}
+	}
+
+	~MemFd() { ::close(mFd); }
+
+	MemFd(const MemFd &) = delete;
+	MemFd &operator=(const MemFd &) = delete;
+
+	int fd() const { return mFd; }
+
+private:
+	int mFd = -1;
+};
+
+struct Delta {
+	uint64_t hits;
+	uint64_t misses;
+	uint64_t evictions;
+};
+
+Delta delta(const DmaBufCache::Stats &before, const DmaBufCache::Stats &after) {
+	return {after.hits - before.hits, after.misses - before.misses,
+	        after.evictions - before.evictions};
+}
+
+bool expect(bool condition, const char *what) {
+	if (!condition)
+		RTCAST_LOG_ERROR << "DMA-BUF cache: " << what;
+
+	return condition;
+}
+
+#endif
+
+} // namespace
+
+json RunDmaBuf([[maybe_unused]] const Options &options, [[maybe_unused]] bool &failed) {
+	json results = json::array();
+#ifdef __linux__
+	DmaBufCache cache(CacheEntries);
+	std::vector<unique_ptr<MemFd>> buffers;
+	for (size_t i = 0; i <= CacheEntries; ++i)
+		buffers.push_back(std::make_unique<MemFd>(uint8_t(i)));
+
+	bool passed = true;
+
+	// Repeated fds hit, including a duplicate with another number but the same inode
+	auto stats = cache.stats();
+	auto first = cache.map(buffers[0]->fd(), BufferSize);
+	auto again = cache.map(buffers[0]->fd(), BufferSize);
+	int dup = ::dup(buffers[0]->fd());
+	if (dup < 0)
+		throw std::runtime_error("Failed to duplicate memfd");
+
+	auto duplicate = cache.map(dup, BufferSize);
+	::close(dup);
+	auto d = delta(stats, cache.stats());
+	passed &= expect(d.misses == 1 && d.hits == 2, "repeated fds did not hit");
+	passed &= expect(first == again && first == duplicate, "repeated fds were mapped again");
+
+	// ENOTTY from DMA_BUF_IOCTL_SYNC disables synchronization instead of failing
+	first->beginAccess();
+	bool content = first->data()[0] == 0 && first->data()[BufferSize - 1] == 0;
+	first->endAccess();
+	passed &= expect(content, "mapping content differs from the buffer");
+	passed &= expect(!first->syncSupported(), "sync was not disabled on memfd");
+
+	// Fill the cache, touch the oldest entry, then one more buffer evicts the least recent one
+	for (size_t i = 1; i < CacheEntries; ++i)
+		cache.map(buffers[i]->fd(), BufferSize);
+
+	stats = cache.stats();
+	cache.map(buffers[0]->fd(), BufferSize);
+	cache.map(buffers[CacheEntries]->fd(), BufferSize);
+	d = delta(stats, cache.stats());
+	passed &= expect(d.hits == 1 && d.misses == 1 && d.evictions == 1,
+	                 "a full cache did not evict exactly one entry");
+	passed &= expect(cache.stats().entries == CacheEntries,
+	                 "the cache does not hold exactly its capacity");
+
+	stats = cache.stats();
+	cache.map(buffers[0]->fd(), BufferSize); // recently used, kept
+	cache.map(buffers[1]->fd(), BufferSize); // least recently used, evicted
+	d = delta(stats, cache.stats());
+	passed &= expect(d.hits == 1 && d.misses == 1, "eviction was not least recently used");
+
+	// Evicted mappings stay valid while referenced
+	cache.clear();
+	passed &= expect(first->data()[0] == 0, "mapping invalidated by eviction");
+
+	// Steady state as in capture, cycling through a set of buffers that fits
+	const size_t cycle = CacheEntries / 2;
+	for (size_t i = 0; i < cycle; ++i)
+		cache.map(buffers[i]->fd(), BufferSize);
+
+	stats = cache.stats();
+	auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < HitIterations; ++i)
+		cache.map(buffers[size_t(i) % cycle]->fd(), BufferSize);
+
+	auto elapsed = std::chrono::steady_clock::now() - start;
+	double seconds = std::chrono::duration<double>(elapsed).count();
+	d = delta(stats, cache.stats());
+	passed &= expect(d.misses == 0, "steady state cycle missed");
+
+	if (!passed)
+		failed = true;
+
+	json result;
+	result["entries"] = CacheEntries;
+	result["buffer_size"] = BufferSize;
+	result["passed"] = passed;
+	result["hit_ns"] = seconds * 1e9 / double(HitIterations);
+	results.push_back(std::move(result));
+#endif
+	return results;
+}
+
+} // namespace bench
+
+} // namespace rtcast
@@ -0,0 +1,141 @@
+/**
+ * Copyright (c) 2025 Paul-Louis Ageneau
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+#include "bench.hpp"
+
+#include <atomic>
+#include <stdexcept>
+
+namespace rtcast {
+
+namespace bench {
+
+namespace {
+
+const char *const CodecName = "libx264";
+const int Framerate = 30;
+const int64_t Bitrate = 2500000;
+const int SourceFramesCount = 16; // cycled, the pattern moves from one frame to the next
+
+// Encodes regardless of clients and counts the output
+class BenchVideoEncoder final : public VideoEncoder {
+public:
+	BenchVideoEncoder(shared_ptr<Endpoint> endpoint) : VideoEncoder(CodecName, endpoint) {}
+
+	// Must be called before start()
+	void configure(const char *preset, unsigned int threads) {
+		std::lock_guard lock(mCodecContextMutex);
+		av_opt_set(mCodecContext->priv_data, "preset", preset, 0);
+		mCodecContext->thread_count = int(threads);
+	}
+
+	uint64_t packetsCount() const { return mPacketsCount.load(); }
+	uint64_t bytesCount() const { return mBytesCount.load(); }
+
+protected:
+	bool active() const override { return true; }
+
+	void output(AVPacket *packet) override {
+		mPacketsCount.fetch_add(1, std::memory_order_relaxed);
+		mBytesCount.fetch_add(uint64_t(packet->size), std::memory_order_relaxed);
+		VideoEncoder::output(packet);
+	}
+
+private:
+	std::atomic<uint64_t> mPacketsCount = 0;
+	std::atomic<uint64_t> mBytesCount = 0;
+};
+
+json run(const char *preset, unsigned int threads, const Options &options,
+         const std::vector<shared_ptr<AVFrame>> &sources) {
+	// The endpoint only listens on an ephemeral port, nothing connects to it
+	auto endpoint = std::make_shared<Endpoint>(0);
+	auto encoder = std::make_shared<BenchVideoEncoder>(endpoint);
+	encoder->setSize(options.width, options.height);
+	encoder->setFramerate(Framerate);
+	encoder->setBitrate(Bitrate);
+	encoder->setDropPolicy(DropPolicy::Block); // measure throughput, not drops
+	encoder->configure(preset, threads);
+	encoder->start();
+
+	Meter meter;
+	for (int i = 0; i < options.frames; ++i) {
+		auto frame = shared_ptr<AVFrame>(av_frame_clone(sources[size_t(i) % sources.size()].get()),
+		                                 [](AVFrame *p) { av_frame_free(&p); });
+		if (!frame)
+			throw std::runtime_error("Failed to clone AVFrame");
+
+		frame->time_base = AVRational{1, 1000000};
+		frame->pts = int64_t(i) * 1000000 / Framerate;
+		encoder->push(std::move(frame));
+	}
+	encoder->stop(); // drains the queue
+	meter.stop();
+
+	auto stats = encoder->stats();
+	json result = meter.report(uint64_t(options.frames));
+	result["codec"] = CodecName;
+	result["preset"] = preset;
+	result["threads"] = threads;
+	result["packets"] = encoder->packetsCount();
+	result["bitrate"] = double(encoder->bytesCount()) * 8. * Framerate / double(options.frames);
+	result["latency"] = ToJson(stats.latency);
+	result["queue_blocked"] = stats.queue.blocked;
+	return result;
+}
+
+} // namespace
+
+json RunEncode(const Options &options, bool &failed) {
+	std::vector<shared_ptr<AVFrame>> sources;
+	auto pool = FramePool::Create(
+	    FramePool::VideoFormat{options.width, options.height, AV_PIX_FMT_YUV420P});
+	for (int i = 0; i < SourceFramesCount; ++i) {
+		auto frame = pool->get();
+		FillPattern(frame.get(), i);
+		sources.push_back(std::move(frame));
+	}
+
+	std::vector<const char *> presets = {"ultrafast"};
+	if (!options.quick)
+		presets.insert(presets.end(), {"superfast", "veryfast"});
+
+	const unsigned int maxThreads = ThreadsCount(options);
+	std::vector<unsigned int> threadCounts = {1};
+	if (!options.quick)
+		for (unsigned int threads : {2u, 4u})
+			if (threads < maxThreads)
+				threadCounts.push_back(threads);
+
+	if (maxThreads > 1)
+		threadCounts.push_back(maxThreads);
+
+	json results = json::array();
+	for (const char *preset : presets) {
+		for (unsigned int threads : threadCounts) {
+			try {
+				results.push_back(run(preset, threads, options, sources));
+
+			} catch (const std::exception &e) {
+				// The encoder may not be available in this build of FFmpeg
+				RTCAST_LOG_ERROR << "Encode run failed with preset " << preset << " and " << threads
+				                 << " threads: " << e.what();
+				failed = true;
+				results.push_back({{"codec", CodecName},
+				                   {"preset", preset},
+				                   {"threads", threads},
+				                   {"error", e.what()}});
+			}
+		}
+	}
+	return results;
+}
+
+} // namespace bench
+
+} // namespace rtcast
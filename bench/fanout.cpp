@@ -0,0 +1,322 @@
+/**
+ * Copyright (c) 2025 Paul-Louis Ageneau
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+#include "bench.hpp"
+
+#include "rtcast/sendpool.hpp"
+#include "rtcast/sharedpacketizer.hpp"
+
+#include "rtc/rtc.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <random>
+#include <thread>
+
+namespace rtcast {
+
+namespace bench {
+
+namespace {
+
+const int Framerate = 30;
+const int64_t Bitrate = 2500000;
+const int GopSize = 60;
+const uint8_t PayloadType = 96;
+const size_t QueueCapacity = 64;
+
+const unsigned int MaxEndpointClients = 100; // connected over loopback, which is costly
+const auto ConnectTimeout = std::chrono::seconds(30);
+const auto DrainTimeout = std::chrono::seconds(30);
+const auto PollInterval = std::chrono::milliseconds(10);
+
+// Annex-B access units with a single NAL unit, sized as an encoder would output them
+std::vector<shared_ptr<EncodedFrame>> make_frames(int count) {
+	std::mt19937 generator(42);
+	std::uniform_int_distribution<int> distribution(1, 255); // no start code emulation
+
+	const size_t averageSize = size_t(Bitrate / 8 / Framerate);
+	std::vector<shared_ptr<EncodedFrame>> frames;
+	for (int i = 0; i < count; ++i) {
+		bool keyframe = i % GopSize == 0;
+		binary data(keyframe ? averageSize * 4 : averageSize * 9 / 10);
+		data[0] = data[1] = data[2] = byte(0);
+		data[3] = byte(1);
+		data[4] = byte(keyframe ? 0x65 : 0x41); // IDR or non-IDR slice
+		for (size_t j = 5; j < data.size(); ++j)
+			data[j] = byte(distribution(generator));
+
+		auto frame = EncodedFrame::Create(std::move(data));
+		frame->keyframe = keyframe;
+		frame->timestamp = std::chrono::microseconds(int64_t(i) * 1000000 / Framerate);
+		frames.push_back(std::move(frame));
+	}
+	return frames;
+}
+
+unique_ptr<SharedPacketizer> make_packetizer() {
+	auto config = std::make_shared<rtc::RtpPacketizationConfig>(
+	    0, "bench-shared", PayloadType, rtc::H264RtpPacketizer::ClockRate);
+	return std::make_unique<SharedPacketizer>(std::make_shared<rtc::H264RtpPacketizer>(
+	    rtc::H264RtpPacketizer::Separator::ShortStartSequence, config));
+}
+
+struct Client {
+	unique_ptr<SharedPacketizer> packetizer; // if packetizing per client
+	shared_ptr<SharedPacketizer::Session> session;
+	SharedPacketizer::Session::sink sink;
+	shared_ptr<SendPool::Queue> queue;
+};
+
+json run(bool shared, unsigned int clientsCount, unsigned int threads,
+         const std::vector<shared_ptr<EncodedFrame>> &frames) {
+	const uint64_t expected = uint64_t(frames.size()) * clientsCount;
+	std::atomic<uint64_t> packetsCount = 0;
+	std::atomic<uint64_t> bytesCount = 0;
+	LatencyHistogram sendLatency; // from enqueuing to the last packet being sent
+
+	std::mutex mutex;
+	std::condition_variable condition;
+	uint64_t delivered = 0;
+
+	auto sharedPacketizer = make_packetizer();
+	std::vector<unique_ptr<Client>> clients;
+	auto pool = std::make_shared<SendPool>(threads);
+	for (unsigned int i = 0; i < clientsCount; ++i) {
+		auto client = std::make_unique<Client>();
+		auto config = std::make_shared<rtc::RtpPacketizationConfig>(
+		    1000 + i, "bench", PayloadType, rtc::H264RtpPacketizer::ClockRate);
+		if (!shared)
+			client->packetizer = make_packetizer();
+
+		client->session = (shared ? sharedPacketizer : client->packetizer)->createSession(config);
+		client->sink = [&bytesCount](binary packet) {
+			bytesCount.fetch_add(packet.size(), std::memory_order_relaxed);
+		};
+
+		Client *c = client.get();
+		auto handler = [&, c](const SendPool::Item &item, SendPool::clock::time_point enqueued) {
+			auto packets = item.packets;
+			if (!packets) {
+				const auto &frame = item.frame;
+				packets = c->packetizer->packetize(frame->data(), frame->size(), frame->timestamp);
+			}
+
+			size_t count = c->session->send(*packets, c->sink);
+			packetsCount.fetch_add(count, std::memory_order_relaxed);
+			sendLatency.record(std::chrono::duration_cast<std::chrono::microseconds>(
+			    SendPool::clock::now() - enqueued));
+
+			std::lock_guard lock(mutex);
+			if (++delivered == expected)
+				condition.notify_all();
+		};
+
+		client->queue = pool->createQueue(std::move(handler), QueueCapacity, DropPolicy::Block);
+		clients.push_back(std::move(client));
+	}
+
+	Meter meter;
+	for (const auto &frame : frames) {
+		SendPool::Item item;
+		item.frame = frame;
+		if (shared)
+			item.packets = sharedPacketizer->packetize(frame->data(), frame->size(),
+			                                           frame->timestamp);
+
+		for (const auto &client : clients)
+			client->queue->push(item);
+	}
+
+	{
+		std::unique_lock lock(mutex);
+		condition.wait(lock, [&]() { return delivered == expected; });
+	}
+	meter.stop();
+
+	for (const auto &client : clients)
+		client->queue->close();
+
+	pool.reset();
+
+	double wall = meter.wallSeconds();
+	json result = meter.report(uint64_t(frames.size()));
+	result["mode"] = shared ? "shared" : "per_client";
+	result["clients"] = clientsCount;
+	result["send_threads"] = threads;
+	result["client_frames_per_s"] = wall > 0. ? double(expected) / wall : 0.;
+	result["cpu_us_per_client_frame"] = meter.cpuSeconds() * 1e6 / double(expected);
+	result["packets"] = packetsCount.load();
+	result["packets_per_s"] = wall > 0. ? double(packetsCount.load()) / wall : 0.;
+	result["bytes"] = bytesCount.load();
+	result["send_latency"] = ToJson(sendLatency.summary());
+	return result;
+}
+
+// Same frames through Endpoint::broadcastVideo() to viewers connected over loopback. Without
+// shared packetization, each track packetizes in its own H264RtpPacketizer media handler chain,
+// as before frames were packetized once. Viewers run in-process, so CPU includes receiving.
+json run_endpoint(bool shared, unsigned int clientsCount,
+                  const std::vector<shared_ptr<EncodedFrame>> &frames, bool &failed) {
+	auto endpoint = std::make_shared<Endpoint>(0);
+	Endpoint::IceSettings ice;
+	ice.servers.clear();
+	ice.bindAddress = "127.0.0.1";
+	endpoint->setIceSettings(std::move(ice));
+	endpoint->setVideo(Endpoint::VideoCodec::H264);
+	endpoint->setSharedPacketization(shared);
+
+	// Backpressure instead of skipping, so that both modes send every frame to every client
+	endpoint->setSendQueue(QueueCapacity, DropPolicy::Block);
+	Endpoint::HealthThresholds thresholds;
+	thresholds.maxQueuedFrames = QueueCapacity;
+	thresholds.maxFractionLost = 1.;
+	thresholds.maxRtt = std::chrono::hours(1);
+	endpoint->setHealthThresholds(thresholds);
+
+	const string url = "ws://127.0.0.1:" + std::to_string(endpoint->port()) + "/";
+	std::vector<shared_ptr<Viewer>> viewers;
+	for (unsigned int i = 0; i < clientsCount; ++i) {
+		Viewer::Settings settings;
+		settings.url = url;
+		settings.bindAddress = "127.0.0.1";
+		auto viewer = std::make_shared<Viewer>(std::move(settings));
+		viewer->open();
+		viewers.push_back(std::move(viewer));
+	}
+
+	unsigned int connected = 0;
+	auto deadline = std::chrono::steady_clock::now() + ConnectTimeout;
+	while (std::chrono::steady_clock::now() < deadline) {
+		connected = 0;
+		unsigned int failures = 0;
+		for (const auto &viewer : viewers) {
+			connected += viewer->isConnected() ? 1 : 0;
+			failures += viewer->hasFailed() ? 1 : 0;
+		}
+		if (connected + failures == clientsCount)
+			break;
+
+		std::this_thread::sleep_for(PollInterval);
+	}
+
+	json result;
+	result["mode"] = shared ? "endpoint_shared" : "endpoint_per_track";
+	result["clients"] = clientsCount;
+	result["connected"] = connected;
+	if (connected == 0) {
+		RTCAST_LOG_ERROR << "No viewer connected to the fan-out endpoint out of " << clientsCount;
+		failed = true;
+		for (const auto &viewer : viewers)
+			viewer->close();
+
+		return result;
+	}
+
+	// Measured until every send queue is drained
+	auto queued = [&endpoint]() {
+		size_t total = 0;
+		for (const auto &client : endpoint->allStats())
+			if (auto health = endpoint->clientHealth(client.id))
+				total += health->queuedFrames;
+		return total;
+	};
+
+	Meter meter;
+	for (const auto &frame : frames)
+		endpoint->broadcastVideo(frame);
+
+	// Queues block instead of dropping, so a stalled viewer would never drain
+	deadline = std::chrono::steady_clock::now() + DrainTimeout;
+	bool drained = queued() == 0;
+	while (!drained && std::chrono::steady_clock::now() < deadline) {
+		std::this_thread::sleep_for(PollInterval);
+		drained = queued() == 0;
+	}
+
+	meter.stop();
+	if (!drained) {
+		RTCAST_LOG_ERROR << "Fan-out endpoint send queues did not drain with " << connected
+		                 << " viewers";
+		failed = true;
+	}
+
+	uint64_t packetsCount = 0, bytesCount = 0;
+	for (const auto &client : endpoint->allStats())
+		if (client.video) {
+			packetsCount += client.video->packetsSent;
+			bytesCount += client.video->bytesSent;
+		}
+
+	for (const auto &viewer : viewers)
+		viewer->close();
+
+	const uint64_t expected = uint64_t(frames.size()) * connected;
+	double wall = meter.wallSeconds();
+	result.update(meter.report(uint64_t(frames.size())));
+	result["drained"] = drained;
+	result["client_frames_per_s"] = wall > 0. ? double(expected) / wall : 0.;
+	result["cpu_us_per_client_frame"] =
+	    expected > 0 ? meter.cpuSeconds() * 1e6 / double(expected) : 0.;
+	result["packets"] = packetsCount;
+	result["packets_per_s"] = wall > 0. ? double(packetsCount) / wall : 0.;
+	result["bytes"] = bytesCount;
+	result["send_latency"] = ToJson(endpoint->stats().video);
+	return result;
+}
+
+} // namespace
+
+json RunFanout(const Options &options, bool &failed) {
+	auto frames = make_frames(options.frames);
+	const unsigned int threads = std::max(ThreadsCount(options) / 2, 1u); // as the Endpoint
+
+	std::vector<unsigned int> clientCounts = {1, 10};
+	if (!options.quick)
+		clientCounts.push_back(100);
+
+	clientCounts.push_back(std::max(options.clients, 1u));
+	std::sort(clientCounts.begin(), clientCounts.end());
+	clientCounts.erase(std::unique(clientCounts.begin(), clientCounts.end()), clientCounts.end());
+
+	json results = json::array();
+	for (unsigned int clientsCount : clientCounts) {
+		json perClient = run(false, clientsCount, threads, frames);
+		json shared = run(true, clientsCount, threads, frames);
+		double cpuPerClient = perClient["cpu_s"].get<double>();
+		double cpuShared = shared["cpu_s"].get<double>();
+		shared["cpu_ratio_vs_per_client"] = cpuPerClient > 0. ? cpuShared / cpuPerClient : 0.;
+		results.push_back(std::move(perClient));
+		results.push_back(std::move(shared));
+	}
+
+	// Baseline of the whole send path, on fewer clients
+	std::vector<unsigned int> endpointCounts = {10};
+	if (!options.quick)
+		endpointCounts.push_back(std::min(std::max(options.clients, 1u), MaxEndpointClients));
+
+	std::sort(endpointCounts.begin(), endpointCounts.end());
+	endpointCounts.erase(std::unique(endpointCounts.begin(), endpointCounts.end()),
+	                     endpointCounts.end());
+	for (unsigned int clientsCount : endpointCounts) {
+		json perTrack = run_endpoint(false, clientsCount, frames, failed);
+		json shared = run_endpoint(true, clientsCount, frames, failed);
+		double cpuPerTrack = perTrack.value("cpu_s", 0.);
+		double cpuShared = shared.value("cpu_s", 0.);
+		shared["cpu_ratio_vs_per_track"] = cpuPerTrack > 0. ? cpuShared / cpuPerTrack : 0.;
+		results.push_back(std::move(perTrack));
+		results.push_back(std::move(shared));
+	}
+	return results;
+}
+
+} // namespace bench
+
+} // namespace rtcast
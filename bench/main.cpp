@@ -0,0 +1,164 @@
+/**
+ * Copyright (c) 2025 Paul-Louis Ageneau
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+#include "bench.hpp"
+
+#include <fstream>
+#include <iostream>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+
+extern "C" {
+#include <libavutil/log.h>
+}
+
+using rtcast::string;
+using namespace rtcast::bench;
+
+namespace {
+
+struct Scenario {
+	const char *name;
+	json (*run)(const Options &options, bool &failed);
+};
+
+const Scenario Scenarios[] = {
+    {"convert", RunConvert},     {"encode", RunEncode},       {"audio", RunAudio},
+    {"audioloss", RunAudioLoss}, {"fanout", RunFanout},       {"bandwidth", RunBandwidth},
+    {"viewers", RunViewers},     {"dmabuf", RunDmaBuf},
+};
+
+void usage(const char *program) {
+	std::cerr << "Usage: " << program << " [options]\n"
+	          << "  --scenarios LIST  comma-separated among convert,encode,audio,audioloss,\n"
+	          << "                    fanout,bandwidth,viewers,dmabuf\n"
+	          << "  --width N         video width (default 1280)\n"
+	          << "  --height N        video height (default 720)\n"
+	          << "  --frames N        frames per video run (default 300)\n"
+	          << "  --clients N       largest fan-out client count (default 100)\n"
+	          << "  --threads N       worker threads, hardware concurrency if 0 (default 0)\n"
+	          << "  --quick           fewer configurations, for smoke runs\n"
+	          << "  --url URL         viewers connect to an external endpoint instead\n"
+	          << "  --output FILE     write the JSON report to a file instead of stdout\n";
+}
+
+int parse_int(const char *value, int min) {
+	int result = std::stoi(value);
+	if (result < min)
+		throw std::invalid_argument(string("Invalid value: ") + value);
+
+	return result;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+	Options options;
+	std::set<string> selected;
+	string outputPath;
+	try {
+		for (int i = 1; i < argc; ++i) {
+			string arg = argv[i];
+			auto next = [&]() -> const char * {
+				if (i + 1 >= argc)
+					throw std::invalid_argument("Missing value for " + arg);
+
+				return argv[++i];
+			};
+
+			if (arg == "--scenarios") {
+				std::istringstream list(next());
+				string name;
+				while (std::getline(list, name, ','))
+					if (!name.empty())
+						selected.insert(name);
+			} else if (arg == "--width") {
+				options.width = parse_int(next(), 16);
+			} else if (arg == "--height") {
+				options.height = parse_int(next(), 16);
+			} else if (arg == "--frames") {
+				options.frames = parse_int(next(), 1);
+			} else if (arg == "--clients") {
+				options.clients = unsigned(parse_int(next(), 1));
+			} else if (arg == "--threads") {
+				options.threads = unsigned(parse_int(next(), 0));
+			} else if (arg == "--url") {
+				options.url = next();
+			} else if (arg == "--quick") {
+				options.quick = true;
+			} else if (arg == "--output") {
+				outputPath = next();
+			} else if (arg == "--help" || arg == "-h") {
+				usage(argv[0]);
+				return 0;
+			} else {
+				throw std::invalid_argument("Unknown option " + arg);
+			}
+		}
+
+		for (const auto &name : selected) {
+			bool known = false;
+			for (const auto &scenario : Scenarios)
+				known = known || name == scenario.name;
+
+			if (!known)
+				throw std::invalid_argument("Unknown scenario " + name);
+		}
+
+	} catch (const std::exception &e) {
+		std::cerr << e.what() << std::endl;
+		usage(argv[0]);
+		return 2;
+	}
+
+	// Keep stdout for the report
+	rtcast::InitLogger(rtcast::LogLevel::Warning);
+	av_log_set_level(AV_LOG_ERROR);
+
+	bool failed = false;
+	json report;
+	report["version"] = RTCAST_BENCH_VERSION;
+	report["options"] = {{"width", options.width},     {"height", options.height},
+	                     {"frames", options.frames},   {"clients", options.clients},
+	                     {"threads", ThreadsCount(options)}, {"quick", options.quick}};
+
+	json results = json::object();
+	for (const auto &scenario : Scenarios) {
+		if (!selected.empty() && selected.find(scenario.name) == selected.end())
+			continue;
+
+		std::cerr << "Running " << scenario.name << "..." << std::endl;
+		try {
+			results[scenario.name] = scenario.run(options, failed);
+
+		} catch (const std::exception &e) {
+			RTCAST_LOG_ERROR << "Scenario " << scenario.name << " failed: " << e.what();
+			results[scenario.name] = {{"error", e.what()}};
+			failed = true;
+		}
+	}
+	report["results"] = std::move(results);
+	report["peak_rss_bytes"] = PeakRssBytes();
+	report["failed"] = failed;
+
+	rtcast::FlushLogger();
+
+	if (!outputPath.empty()) {
+		std::ofstream file(outputPath);
+		if (!file) {
+			std::cerr << "Failed to open " << outputPath << std::endl;
+			return 1;
+		}
+		file << report.dump(2) << std::endl;
+	} else {
+		std::cout << report.dump(2) << std::endl;
+	}
+
+	return failed ? 1 : 0;
+}
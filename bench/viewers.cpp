@@ -0,0 +1,231 @@
+/**
+ * Copyright (c) 2025 Paul-Louis Ageneau
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+#include "bench.hpp"
+
+#include <algorithm>
+#include <thread>
+
+namespace rtcast {
+
+namespace bench {
+
+namespace {
+
+using namespace std::chrono_literals;
+
+const int Width = 640;
+const int Height = 360;
+const int Framerate = 30;
+const int64_t Bitrate = 1000000;
+const auto ConnectTimeout = 30s;
+const auto PollInterval = 100ms;
+
+// Source, encoders and endpoint serving the viewers on loopback
+struct Server {
+	shared_ptr<Endpoint> endpoint;
+	shared_ptr<VideoEncoder> videoEncoder;
+	shared_ptr<AudioEncoder> audioEncoder;
+	unique_ptr<SyntheticVideoDevice> video;
+	unique_ptr<SyntheticAudioDevice> audio;
+
+	Server() {
+		endpoint = std::make_shared<Endpoint>(0);
+		Endpoint::IceSettings ice;
+		ice.servers.clear();
+		ice.bindAddress = "127.0.0.1";
+		endpoint->setIceSettings(std::move(ice));
+
+		videoEncoder = std::make_shared<VideoEncoder>("libx264", endpoint);
+		videoEncoder->setBitrate(Bitrate);
+		audioEncoder = std::make_shared<AudioEncoder>("libopus", endpoint);
+
+		std::weak_ptr<VideoEncoder> weakEncoder = videoEncoder;
+		endpoint->onKeyframeRequest([weakEncoder](int, unsigned int rendition) {
+			if (auto encoder = weakEncoder.lock())
+				encoder->requestKeyframe(rendition);
+		});
+
+		SyntheticVideoDevice::Settings videoSettings;
+		videoSettings.width = Width;
+		videoSettings.height = Height;
+		videoSettings.framerate = Framerate;
+		video = std::make_unique<SyntheticVideoDevice>(videoEncoder, videoSettings);
+		audio = std::make_unique<SyntheticAudioDevice>(audioEncoder);
+		video->start();
+		audio->start();
+	}
+
+	~Server() {
+		video->stop();
+		audio->stop();
+	}
+
+	string url() const { return "ws://127.0.0.1:" + std::to_string(endpoint->port()) + "/"; }
+};
+
+json to_json(const Viewer::TrackStats &stats) {
+	json result;
+	result["frames"] = stats.frames;
+	result["packets"] = stats.packets;
+	result["bytes"] = stats.bytes;
+	result["lost"] = stats.lost;
+	result["fps"] = stats.framerate;
+	result["jitter_us"] = stats.jitter.count();
+	result["time_to_first_frame_us"] =
+	    stats.timeToFirstFrame ? json(stats.timeToFirstFrame->count()) : json(nullptr);
+	return result;
+}
+
+// Distribution over viewers of one track
+json summarize(const std::vector<Viewer::TrackStats> &tracks) {
+	LatencyHistogram jitter, timeToFirstFrame;
+	double minFps = 0., sumFps = 0.;
+	uint64_t lost = 0, packets = 0;
+	unsigned int received = 0;
+	for (const auto &track : tracks) {
+		jitter.record(track.jitter);
+		lost += track.lost;
+		packets += track.packets;
+		if (track.timeToFirstFrame) {
+			timeToFirstFrame.record(*track.timeToFirstFrame);
+			minFps = received == 0 ? track.framerate : std::min(minFps, track.framerate);
+			++received;
+		}
+		sumFps += track.framerate;
+	}
+
+	json result;
+	result["receiving"] = received;
+	result["min_fps"] = minFps;
+	result["mean_fps"] = tracks.empty() ? 0. : sumFps / double(tracks.size());
+	result["loss"] = packets + lost > 0 ? double(lost) / double(packets + lost) : 0.;
+	result["jitter"] = ToJson(jitter.summary());
+	result["time_to_first_frame"] = ToJson(timeToFirstFrame.summary());
+	return result;
+}
+
+json run(unsigned int count, const Options &options) {
+	unique_ptr<Server> server;
+	string url = options.url;
+	if (url.empty()) {
+		server = std::make_unique<Server>();
+		url = server->url();
+	}
+
+	Meter meter;
+	std::vector<shared_ptr<Viewer>> viewers;
+	for (unsigned int i = 0; i < count; ++i) {
+		Viewer::Settings settings;
+		settings.url = url;
+		if (server)
+			settings.bindAddress = "127.0.0.1";
+
+		auto viewer = std::make_shared<Viewer>(std::move(settings));
+		viewer->open();
+		viewers.push_back(std::move(viewer));
+	}
+
+	// Wait for all viewers to connect or fail, then measure over the run duration
+	auto deadline = std::chrono::steady_clock::now() + ConnectTimeout;
+	unsigned int connected = 0;
+	while (std::chrono::steady_clock::now() < deadline) {
+		connected = 0;
+		unsigned int failed = 0;
+		for (const auto &viewer : viewers) {
+			connected += viewer->isConnected() ? 1 : 0;
+			failed += viewer->hasFailed() ? 1 : 0;
+		}
+		if (connected + failed == count)
+			break;
+
+		std::this_thread::sleep_for(PollInterval);
+	}
+	auto connectSeconds = meter.wallSeconds();
+
+	const auto duration = std::chrono::milliseconds(int64_t(options.frames) * 1000 / Framerate);
+	std::this_thread::sleep_for(duration);
+
+	// Server side view of the same clients, before they disconnect
+	uint64_t nacks = 0, retransmissions = 0;
+	if (server)
+		for (const auto &client : server->endpoint->allStats())
+			if (client.video) {
+				nacks += client.video->nacksReceived;
+				retransmissions += client.video->retransmissions;
+			}
+
+	std::vector<Viewer::TrackStats> video, audio;
+	uint64_t framesCount = 0; // received by all viewers
+	json perViewer = json::array();
+	LatencyHistogram timeToConnected;
+	for (const auto &viewer : viewers) {
+		auto stats = viewer->stats();
+		if (stats.timeToConnected)
+			timeToConnected.record(*stats.timeToConnected);
+
+		framesCount += stats.video.frames;
+		video.push_back(stats.video);
+		audio.push_back(stats.audio);
+		perViewer.push_back({{"connected", viewer->isConnected()},
+		                     {"failed", viewer->hasFailed()},
+		                     {"video", to_json(stats.video)},
+		                     {"audio", to_json(stats.audio)}});
+	}
+	meter.stop();
+
+	for (const auto &viewer : viewers)
+		viewer->close();
+
+	json result = meter.report(framesCount);
+	result["viewers"] = count;
+	result["connected"] = connected;
+	result["external"] = !server;
+	result["connect_s"] = connectSeconds;
+	result["measured_s"] = std::chrono::duration<double>(duration).count();
+	result["time_to_connected"] = ToJson(timeToConnected.summary());
+	result["video"] = summarize(video);
+	result["audio"] = summarize(audio);
+	if (server) {
+		auto stats = server->endpoint->stats();
+		result["endpoint"] = {{"video", ToJson(stats.video)},
+		                      {"audio", ToJson(stats.audio)},
+		                      {"time_to_first_frame", ToJson(stats.timeToFirstFrame)},
+		                      {"primed_clients", stats.primedClients},
+		                      {"video_nacks", nacks},
+		                      {"video_retransmissions", retransmissions}};
+	}
+	result["per_viewer"] = std::move(perViewer);
+	return result;
+}
+
+} // namespace
+
+json RunViewers(const Options &options, bool &failed) {
+	std::vector<unsigned int> viewerCounts = {10};
+	if (!options.quick)
+		viewerCounts.push_back(std::max(options.clients, 1u));
+
+	std::sort(viewerCounts.begin(), viewerCounts.end());
+	viewerCounts.erase(std::unique(viewerCounts.begin(), viewerCounts.end()), viewerCounts.end());
+
+	json results = json::array();
+	for (unsigned int count : viewerCounts) {
+		json result = run(count, options);
+		if (result["connected"].get<unsigned int>() == 0) {
+			RTCAST_LOG_ERROR << "No viewer connected out of " << count;
+			failed = true;
+		}
+		results.push_back(std::move(result));
+	}
+	return results;
+}
+
+} // namespace bench
+
+} // namespace rtcast
@@ -26,6 +26,33 @@ int main() {
 
 		videoEncoder->setBitrate(4000000);
 
+		// The endpoint outlives the encoders, callbacks must not keep them alive
+		std::weak_ptr<rtcast::VideoEncoder> weakEncoder = videoEncoder;
+
+		// Follow the bandwidth estimated from clients' RTCP feedback
+		endpoint->setBitrateRange(300000, 4000000);
+		endpoint->onTargetBitrate([weakEncoder](int64_t bitrate) {
+			if (auto encoder = weakEncoder.lock())
+				encoder->setBitrate(bitrate);
+		});
+
+		// Adapt Opus FEC, DTX and bitrate to the audio loss reported by clients
+		auto audioController = make_shared<rtcast::AudioController>(audioEncoder);
+		std::weak_ptr<rtcast::AudioController> weakController = audioController;
+		endpoint->onAudioLoss([weakController](double fractionLost) {
+			if (auto controller = weakController.lock())
+				controller->onLoss(fractionLost);
+		});
+
+		// Also offer RED so that a lost frame is recovered from the next packet
+		endpoint->setAudioRedundancy(1);
+
+		// Joining clients, PLI and FIR trigger a keyframe, coalesced by the encoder
+		endpoint->onKeyframeRequest([weakEncoder](int, unsigned int rendition) {
+			if (auto encoder = weakEncoder.lock())
+				encoder->requestKeyframe(rendition);
+		});
+
 #if RTCAST_HAS_LIBCAMERA
 		rtcast::CameraDevice video("default", videoEncoder);
 		video.start();
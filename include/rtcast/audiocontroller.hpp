@@ -0,0 +1,71 @@
+/**
+ * Copyright (c) 2025 Paul-Louis Ageneau
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef AUDIO_CONTROLLER_H
+#define AUDIO_CONTROLLER_H
+
+#include "common.hpp"
+#include "audioencoder.hpp"
+
+#include <chrono>
+#include <mutex>
+
+namespace rtcast {
+
+// Loss-adaptive control of an Opus encoder from the audio receiver reports of clients
+// In-band FEC and the expected loss percentage follow the smoothed fraction lost, the bitrate is
+// lowered in proportion to loss, and DTX stops sending frames during silence. Each change
+// reopens the codec, so changes are rate-limited, except enabling FEC on a loss burst.
+// Time is passed explicitly so that the controller can be driven by a simulated link.
+class AudioController final {
+public:
+	using clock = std::chrono::steady_clock;
+
+	struct Settings {
+		static Settings Default() { return {}; }
+		int64_t minBitrate = 24000;
+		int64_t maxBitrate = 128000;
+		double fecThreshold = 0.02; // smoothed loss enabling FEC, disabled under half of it
+		bool dtx = true;
+		std::chrono::milliseconds minInterval = std::chrono::milliseconds(5000); // between changes
+	};
+
+	AudioController(shared_ptr<AudioEncoder> encoder, Settings settings = Settings::Default());
+
+	// Typically called from Endpoint::onAudioLoss(), the smoothing depends on time, not on the
+	// number of reports
+	void onLoss(double fractionLost, clock::time_point now = clock::now());
+
+	struct Stats {
+		double fractionLost = 0.; // smoothed
+		AudioEncoder::OpusOptions options;
+		uint64_t reports = 0;
+		uint64_t changes = 0;
+	};
+
+	Stats stats() const;
+
+private:
+	AudioEncoder::OpusOptions target(double fractionLost) const;
+	bool differs(const AudioEncoder::OpusOptions &options) const;
+
+	const shared_ptr<AudioEncoder> mEncoder;
+	const Settings mSettings;
+
+	mutable std::mutex mMutex;
+	double mFractionLost = 0.;
+	optional<clock::time_point> mLastReport;
+	AudioEncoder::OpusOptions mOptions;
+	optional<clock::time_point> mLastChange;
+	uint64_t mReports = 0;
+	uint64_t mChanges = 0;
+};
+
+} // namespace rtcast
+
+#endif
@@ -42,6 +42,8 @@ private:
 	AVStream *mInputStream;
 	const AVCodec *mInputCodec;
 	unique_ptr_deleter<AVCodecContext> mInputCodecContext;
+
+	shared_ptr<FramePool> mFramePool = FramePool::Create();
 };
 
 } // namespace rtcast
@@ -9,11 +9,11 @@
 #ifndef AUDIO_ENCODER_H
 #define AUDIO_ENCODER_H
 
+#include "audioring.hpp"
 #include "encoder.hpp"
 #include "endpoint.hpp"
 
 extern "C" {
-#include <libavutil/audio_fifo.h>
 #include <libswresample/swresample.h>
 }
 
@@ -29,6 +29,40 @@ public:
 	int sampleRate() const;
 	int channelsCount() const;
 
+	// Duration of encoded frames, 20 ms by default, must be set before start()
+	// Opus accepts 2.5, 5, 10, 20, 40 and 60 ms, it is restricted to its low-delay mode under
+	// 10 ms. The endpoint announces the duration to clients connecting afterwards.
+	void setFrameDuration(std::chrono::microseconds duration);
+	std::chrono::microseconds frameDuration() const;
+
+	// Opus options which may change while encoding, see AudioController
+	// libopus only reads them on initialization, so a change while running reopens the codec
+	// between two frames on the encoder thread. Each reopen plays as a short gap: the padding
+	// ending the last frame of the previous encoder, then the lookahead of the new one (6.5 ms
+	// with libopus). Both are counted in OutputStats::paddingSamples.
+	struct OpusOptions {
+		optional<int64_t> bitrate; // unchanged if unset
+		bool fec = false;          // in-band forward error correction
+		int packetLoss = 0;        // expected loss percentage, sizes the FEC
+		bool dtx = false;          // discontinuous transmission, silent frames are not sent
+	};
+
+	void setOpusOptions(OpusOptions options);
+	OpusOptions opusOptions() const;
+
+	// Encoded output, frames suppressed by DTX are not counted in frames and bytes
+	struct OutputStats {
+		uint64_t frames = 0;
+		uint64_t bytes = 0;
+		uint64_t fecFrames = 0; // encoded with FEC enabled
+		uint64_t fecBytes = 0;
+		uint64_t dtxFrames = 0; // suppressed by DTX
+		uint64_t reopens = 0;
+		uint64_t paddingSamples = 0; // inserted by reopens
+	};
+
+	OutputStats outputStats() const;
+
 	using finished_callback_t = std::function<void()>;
 
 	struct InputFrame {
@@ -42,20 +76,80 @@ public:
 	};
 
 	virtual void push(shared_ptr<AVFrame> frame) override;
+
+	// Samples are consumed and finished is called before returning
 	virtual void push(InputFrame input);
 
+	// Direct write into the ring buffer for capture threads producing interleaved samples in the
+	// codec format, see sampleFormat(). The region is empty while inactive. Must not be mixed
+	// with push() from another thread.
+	AudioRing::Region beginWrite(int nbSamples);
+	void commitWrite(int nbSamples);
+
+	AVSampleFormat sampleFormat() const;
+
+	// Applies to the ring buffer, Deadline behaves as DropOldest
+	void setDropPolicy(DropPolicy policy) override;
+	AudioRing::Stats ringStats() const;
+
+	void start() override;
+	void stop() override;
+
 protected:
+	// Input is discarded while inactive, by default when the endpoint has no clients
+	virtual bool active() const;
+
 	void output(AVPacket *packet) override;
 
+	// Sends an encoded frame, by default broadcasts it to the endpoint
+	virtual void send(shared_ptr<EncodedFrame> frame);
+
+	// Slices codec frames out of the ring buffer instead of the frame queue
+	std::optional<FrameQueue<QueuedFrame>::Item> pop() override;
+
 private:
+	// Converts to the codec format if necessary, directly into the ring buffer
+	// Nothing is allocated in steady state.
+	void write(const uint8_t *const *data, const AVChannelLayout &layout,
+	           AVSampleFormat sampleFormat, int sampleRate, int nbSamples,
+	           clock::time_point origin);
+
+	int frameSize() const;
+	void configure(AVCodecContext *context, const OpusOptions &options);
+	void reopen();
+
 	shared_ptr<Endpoint> mEndpoint;
+	std::chrono::microseconds mFrameDuration;
+
+	// Between the producer (capture) thread and the encoder thread
+	unique_ptr<AudioRing> mRing;
+	std::atomic<int64_t> mLastWriteUs = 0; // origin of the samples in the ring
 
-	unique_ptr_deleter<AVAudioFifo> mAudioFifo;
+	// Owned by the producer thread
 	unique_ptr_deleter<SwrContext> mSwrContext;
 	AVSampleFormat mSwrInputSampleFormat;
 	int mSwrInputNbChannels;
 	int mSwrInputSampleRate;
+	std::vector<uint8_t *> mInputPlanes; // into the buffer of an InputFrame
+
+	mutable std::mutex mOpusOptionsMutex;
+	OpusOptions mOpusOptions;
+	std::atomic<bool> mOpusOptionsChanged = false;
+
+	// Owned by the encoder thread
 	std::int64_t mSamplesCount = 0;
+	uint32_t mRtpTimestamp = 0;
+	OpusOptions mAppliedOpusOptions;
+
+	struct {
+		std::atomic<uint64_t> frames = 0;
+		std::atomic<uint64_t> bytes = 0;
+		std::atomic<uint64_t> fecFrames = 0;
+		std::atomic<uint64_t> fecBytes = 0;
+		std::atomic<uint64_t> dtxFrames = 0;
+		std::atomic<uint64_t> reopens = 0;
+		std::atomic<uint64_t> paddingSamples = 0;
+	} mOutputCounters;
 };
 
 } // namespace rtcast
@@ -0,0 +1,123 @@
+/**
+ * Copyright (c) 2025 Paul-Louis Ageneau
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef AUDIO_RING_H
+#define AUDIO_RING_H
+
+#include "common.hpp"
+#include "framequeue.hpp" // for DropPolicy
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+
+namespace rtcast {
+
+// Single-producer single-consumer ring of interleaved audio samples
+// The producer writes in place into regions of the ring and the consumer reads fixed-size
+// slices. With DropOldest, the producer advances the read position to make room and the
+// consumer detects it, the same way FrameQueue lets the producer evict elements. Locking only
+// happens to put a thread to sleep. Positions and sizes are counted in samples per channel.
+class AudioRing final {
+public:
+	using clock = std::chrono::steady_clock;
+
+	struct Stats {
+		uint64_t written = 0;
+		uint64_t read = 0;
+		uint64_t droppedNewest = 0; // samples which did not fit with DropNewest
+		uint64_t droppedOldest = 0; // samples overwritten with DropOldest
+		uint64_t underruns = 0;     // starvation episodes, reads timing out in a row count once
+		uint64_t blocked = 0;       // writes which waited with Block
+	};
+
+	// Deadline is not supported, it behaves as DropOldest
+	AudioRing(size_t capacity, size_t sampleSize, DropPolicy policy = DropPolicy::DropOldest);
+	~AudioRing();
+
+	AudioRing(const AudioRing &) = delete;
+	AudioRing &operator=(const AudioRing &) = delete;
+
+	size_t capacity() const { return mMask + 1; }
+	size_t sampleSize() const { return mSampleSize; } // bytes for all channels
+	size_t size() const;
+
+	void setPolicy(DropPolicy policy) { mPolicy.store(policy, std::memory_order_relaxed); }
+	DropPolicy policy() const { return mPolicy.load(std::memory_order_relaxed); }
+
+	// Contiguous parts of a write region, the second one is used when the ring wraps around
+	struct Region {
+		byte *first = nullptr;
+		size_t firstSize = 0;
+		byte *second = nullptr;
+		size_t secondSize = 0;
+
+		size_t size() const { return firstSize + secondSize; }
+	};
+
+	// Producer: reserves room for up to count samples according to the policy, the region may
+	// be smaller with DropNewest or once closed, then commits the samples actually written
+	Region beginWrite(size_t count);
+	void commitWrite(size_t count);
+
+	// Producer: copies count samples, returns the number written
+	size_t write(const byte *data, size_t count);
+
+	enum class ReadResult {
+		Ok,
+		Underrun, // not enough samples before the timeout
+		Closed,
+	};
+
+	// Consumer: reads exactly count samples, waiting up to timeout for them
+	ReadResult read(byte *data, size_t count, std::chrono::microseconds timeout);
+
+	// Wake up waiting threads, subsequent writes are rejected and reads return Closed once fewer
+	// than the requested samples remain
+	void close();
+	void reopen(); // discards remaining samples, must not race with the consumer
+	bool isClosed() const { return mClosed.load(std::memory_order_acquire); }
+
+	Stats stats() const;
+
+private:
+	static size_t RoundUpPowerOfTwo(size_t n);
+
+	byte *at(uint64_t pos) { return mData.data() + (pos & mMask) * mSampleSize; }
+	void notify(std::atomic<int> &waiting);
+
+	binary mData;
+	const size_t mMask;
+	const size_t mSampleSize;
+
+	alignas(64) std::atomic<uint64_t> mWritePos = 0;
+	alignas(64) std::atomic<uint64_t> mReadPos = 0;
+
+	std::atomic<DropPolicy> mPolicy;
+	std::atomic<bool> mClosed = false;
+	bool mStarved = false; // owned by the consumer
+
+	std::mutex mMutex;
+	std::condition_variable mCondition;
+	std::atomic<int> mWaitingConsumers = 0;
+	std::atomic<int> mWaitingProducers = 0;
+
+	struct {
+		std::atomic<uint64_t> written = 0;
+		std::atomic<uint64_t> read = 0;
+		std::atomic<uint64_t> droppedNewest = 0;
+		std::atomic<uint64_t> droppedOldest = 0;
+		std::atomic<uint64_t> underruns = 0;
+		std::atomic<uint64_t> blocked = 0;
+	} mCounters;
+};
+
+} // namespace rtcast
+
+#endif
@@ -0,0 +1,58 @@
+/**
+ * Copyright (c) 2025 Paul-Louis Ageneau
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef BANDWIDTH_ESTIMATOR_H
+#define BANDWIDTH_ESTIMATOR_H
+
+#include "common.hpp"
+
+#include <chrono>
+#include <deque>
+#include <mutex>
+
+namespace rtcast {
+
+// Sender-side bandwidth estimation for one client from RTCP feedback
+// Loss-based control from receiver reports (as in GCC), delay-based backoff when the RTT rises
+// above its recent minimum, capped by the receiver estimate (REMB) when the client sends one.
+// Time is passed explicitly so that the estimator can be driven by a simulated link.
+class BandwidthEstimator final {
+public:
+	using clock = std::chrono::steady_clock;
+
+	BandwidthEstimator(int64_t minBitrate, int64_t maxBitrate, int64_t startBitrate);
+
+	void onReceiverReport(double fractionLost, optional<std::chrono::microseconds> rtt,
+	                      clock::time_point now);
+	void onRemb(int64_t bitrate, clock::time_point now);
+
+	void setRange(int64_t minBitrate, int64_t maxBitrate);
+
+	int64_t estimate(clock::time_point now = clock::now()) const;
+	optional<int64_t> remb(clock::time_point now = clock::now()) const;
+
+private:
+	int64_t clamp(int64_t bitrate) const;
+	bool isDelayOveruse(std::chrono::microseconds rtt, clock::time_point now);
+
+	mutable std::mutex mMutex;
+	int64_t mMinBitrate;
+	int64_t mMaxBitrate;
+	int64_t mEstimate;
+	optional<clock::time_point> mLastUpdate;
+	clock::time_point mHoldUntil = {}; // no increase before this time after a decrease
+
+	std::deque<std::pair<clock::time_point, std::chrono::microseconds>> mRttHistory;
+
+	optional<int64_t> mRemb;
+	clock::time_point mRembTime = {};
+};
+
+} // namespace rtcast
+
+#endif
@@ -11,6 +11,8 @@
 
 #if RTCAST_HAS_LIBCAMERA
 
+#include "decodestage.hpp"
+#include "dmabufcache.hpp"
 #include "videoencoder.hpp"
 
 extern "C" {
@@ -45,13 +47,16 @@ public:
 		int width = 0;
 		int height = 0;
 		int framerate = 0;
+		unsigned int decodeThreads = 0; // for MJPEG, 0 for automatic
 	};
 
 	CameraDevice(string deviceName, shared_ptr<VideoEncoder> encoder,
 	             Settings settings = Settings::Default());
 	~CameraDevice();
 
+	// Compressed input is decoded on a separate stage so that requests are requeued immediately
 	void initInputCodec(AVCodecID codecId);
+	optional<DecodeStage::Stats> decodeStats() const;
 
 	void start();
 	void stop();
@@ -79,6 +84,7 @@ private:
 	static std::unique_ptr<libcamera::CameraManager> CameraManager;
 
 	void requestComplete(libcamera::Request *request);
+	void releaseMappings(const std::vector<std::unique_ptr<libcamera::FrameBuffer>> &buffers);
 
 	shared_ptr<VideoEncoder> mEncoder;
 	Settings mSettings;
@@ -89,7 +95,8 @@ private:
 	shared_ptr<DmaFrameBufferAllocator> mDmaAllocator;
 	shared_ptr<libcamera::FrameBufferAllocator> mAllocator;
 
-	unique_ptr_deleter<AVCodecContext> mInputCodecContext;
+	unique_ptr<DecodeStage> mDecodeStage;
+	DmaBufCache mMappings; // compressed buffers copied for the decode stage
 };
 
 } // namespace rtcast
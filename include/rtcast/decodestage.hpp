@@ -0,0 +1,84 @@
+/**
+ * Copyright (c) 2025 Paul-Louis Ageneau
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef DECODE_STAGE_H
+#define DECODE_STAGE_H
+
+#include "common.hpp"
+#include "framepool.hpp"
+#include "framequeue.hpp"
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+}
+
+#include <atomic>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <thread>
+
+namespace rtcast {
+
+// Decoding of intra-only video like MJPEG across threads, each with its own decoder context
+// Frames are delivered in push order. A packet which fails to decode is skipped without holding
+// back the following ones, and packets are dropped when all decoders are busy.
+class DecodeStage final {
+public:
+	using frame_callback = std::function<void(shared_ptr<AVFrame> frame)>;
+
+	// The callback is invoked on the decoding threads, one call at a time
+	DecodeStage(AVCodecID codecId, unsigned int threads, frame_callback callback);
+	~DecodeStage();
+
+	DecodeStage(const DecodeStage &) = delete;
+	DecodeStage &operator=(const DecodeStage &) = delete;
+
+	unsigned int threadsCount() const { return unsigned(mThreads.size()); }
+
+	// Must be called from a single producer thread, returns false if the packet was dropped
+	bool push(shared_ptr<AVPacket> packet);
+
+	struct Stats {
+		uint64_t decoded = 0;
+		uint64_t failed = 0;
+		uint64_t dropped = 0;
+	};
+
+	Stats stats() const;
+
+private:
+	struct Job {
+		uint64_t sequence = 0;
+		shared_ptr<AVPacket> packet;
+	};
+
+	void run(AVCodecContext *context);
+	shared_ptr<AVFrame> decode(AVCodecContext *context, const AVPacket *packet);
+	void deliver(uint64_t sequence, shared_ptr<AVFrame> frame);
+
+	const frame_callback mCallback;
+	std::vector<unique_ptr_deleter<AVCodecContext>> mContexts;
+	std::vector<std::thread> mThreads;
+	FrameQueue<Job> mQueue;
+	shared_ptr<FramePool> mFramePool = FramePool::Create();
+
+	uint64_t mNextSequence = 0; // owned by the producer
+
+	std::mutex mOutputMutex;
+	std::map<uint64_t, shared_ptr<AVFrame>> mCompleted; // null if decoding failed
+	uint64_t mNextOutput = 0;
+	bool mDelivering = false;
+
+	std::atomic<uint64_t> mDecoded = 0;
+	std::atomic<uint64_t> mFailed = 0;
+};
+
+} // namespace rtcast
+
+#endif
@@ -0,0 +1,92 @@
+/**
+ * Copyright (c) 2025 Paul-Louis Ageneau
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef DMABUF_CACHE_H
+#define DMABUF_CACHE_H
+
+#include "common.hpp"
+
+#include <atomic>
+#include <list>
+#include <mutex>
+
+namespace rtcast {
+
+// Cache of read-only memory mappings of DMA-BUF file descriptors
+// Capture devices cycle through a fixed set of buffers, so each one is mapped once and the
+// mapping is reused for every frame. Entries are keyed by the device and inode of the fd, which
+// survive fd renumbering, and hold a duplicate of the fd so that the key cannot be recycled while
+// mapped. CPU access is bracketed with DMA_BUF_IOCTL_SYNC for coherency with the device, which
+// is skipped for plain shared memory like memfd.
+class DmaBufCache final {
+public:
+	class Mapping final {
+	public:
+		~Mapping();
+
+		Mapping(const Mapping &) = delete;
+		Mapping &operator=(const Mapping &) = delete;
+
+		uint8_t *data() const { return static_cast<uint8_t *>(mData); }
+		size_t size() const { return mSize; }
+
+		// Must bracket CPU reads of the buffer
+		void beginAccess() const;
+		void endAccess() const;
+
+		// False once the fd turned out not to support DMA_BUF_IOCTL_SYNC
+		bool syncSupported() const { return mSyncSupported.load(std::memory_order_relaxed); }
+
+	private:
+		friend class DmaBufCache;
+		Mapping(int fd, size_t size);
+		void sync(uint64_t flags) const;
+
+		int mFd = -1; // duplicate
+		void *mData = nullptr;
+		size_t mSize = 0;
+		mutable std::atomic<bool> mSyncSupported = true;
+	};
+
+	explicit DmaBufCache(size_t maxEntries = 32);
+
+	// Returns a mapping of at least size bytes, mappings stay valid while referenced even if
+	// they are evicted from the cache
+	shared_ptr<const Mapping> map(int fd, size_t size);
+
+	// Drops the entry for the buffer, or all entries, to be called when buffers are freed
+	void evict(int fd);
+	void clear();
+
+	struct Stats {
+		uint64_t hits = 0;
+		uint64_t misses = 0;
+		uint64_t evictions = 0;
+		size_t entries = 0;
+	};
+
+	Stats stats() const;
+
+private:
+	struct Entry {
+		uint64_t device = 0;
+		uint64_t inode = 0;
+		shared_ptr<const Mapping> mapping;
+	};
+
+	const size_t mMaxEntries;
+	mutable std::mutex mMutex;
+	std::list<Entry> mEntries; // most recently used first
+	uint64_t mHits = 0;
+	uint64_t mMisses = 0;
+	uint64_t mEvictions = 0;
+};
+
+} // namespace rtcast
+
+#endif
@@ -0,0 +1,49 @@
+/**
+ * Copyright (c) 2025 Paul-Louis Ageneau
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef ENCODED_FRAME_H
+#define ENCODED_FRAME_H
+
+#include "common.hpp"
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+}
+
+#include <chrono>
+
+namespace rtcast {
+
+// Encoded frame published once by an encoder and shared read-only by all client send queues
+class EncodedFrame final {
+public:
+	// References the packet data, which is only copied if the packet is not reference-counted
+	static shared_ptr<EncodedFrame> Create(const AVPacket *packet);
+	static shared_ptr<EncodedFrame> Create(const byte *data, size_t size);
+	static shared_ptr<EncodedFrame> Create(binary data);
+
+	const byte *data() const { return mData; }
+	size_t size() const { return mSize; }
+
+	bool keyframe = false;
+	std::chrono::microseconds timestamp = {}; // presentation time, for video
+	uint32_t rtpTimestamp = 0;                // in samples, for audio
+	unsigned int rendition = 0;               // for video
+
+private:
+	EncodedFrame() = default;
+
+	const byte *mData = nullptr;
+	size_t mSize = 0;
+	unique_ptr_deleter<AVPacket> mPacket;
+	binary mBuffer;
+};
+
+} // namespace rtcast
+
+#endif
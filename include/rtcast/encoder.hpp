@@ -10,6 +10,9 @@
 #define ENCODER_H
 
 #include "common.hpp"
+#include "framepool.hpp"
+#include "framequeue.hpp"
+#include "latency.hpp"
 
 extern "C" {
 #include <libavcodec/avcodec.h>
@@ -18,11 +21,11 @@ extern "C" {
 }
 
 #include <atomic>
-#include <condition_variable>
+#include <chrono>
 #include <functional>
 #include <memory>
 #include <mutex>
-#include <queue>
+#include <optional>
 #include <string>
 #include <thread>
 
@@ -36,31 +39,90 @@ public:
 	string codecName() const;
 	AVCodecID codecID() const;
 
+	// Thread-safe and non-blocking, applied by the encoder thread before the next frame
 	void setBitrate(int64_t bitrate);
 
-	void start();
-	void stop();
+	// Force the next frame to be a keyframe, requests are coalesced so that at most one keyframe
+	// is forced per window, a request within the window is deferred until the window ends
+	void requestKeyframe();
+	void setKeyframeCoalescing(std::chrono::milliseconds window);
+
+	using clock = std::chrono::steady_clock;
+
+	struct QueuedFrame {
+		shared_ptr<AVFrame> frame;
+		clock::time_point origin; // when the frame was pushed to the encoder
+	};
+
+	using QueueStats = FrameQueue<QueuedFrame>::Stats;
+
+	// Frame queue between the producer (capture) thread and the encoder thread
+	virtual void setDropPolicy(DropPolicy policy);
+	void setQueueDeadline(std::chrono::milliseconds deadline); // for DropPolicy::Deadline
+	QueueStats queueStats() const;
+
+	// Frames allocated by the encoder are drawn from pools sized to the encoder geometry
+	void setHugePages(bool enabled);
+	FramePool::Stats framePoolStats() const;
+
+	// Per-stage latency, stages upstream of the encoder are recorded by the capture devices
+	void recordLatency(PipelineStage stage, std::chrono::microseconds value);
+	LatencyStats latencyStats() const;
+	void resetLatencyStats();
+
+	struct Stats {
+		LatencyStats latency;
+		QueueStats queue;
+		FramePool::Stats framePool;
+		uint64_t keyframeRequests = 0;
+		uint64_t forcedKeyframes = 0;
+	};
+
+	Stats stats() const;
+
+	virtual void start();
+	virtual void stop();
+	bool isRunning() const;
 
 	virtual void push(shared_ptr<AVFrame> frame);
 
 protected:
 	virtual void output(AVPacket *packet) = 0;
 
+	void enqueue(shared_ptr<AVFrame> frame, clock::time_point origin);
+
+	// Called by the encoder thread, blocking, returns nullopt once stopped
+	virtual std::optional<FrameQueue<QueuedFrame>::Item> pop();
+
+	// Apply the bitrate set last, mCodecContextMutex must be locked
+	void applyBitrate();
+
 	const AVCodec *mCodec;
 	unique_ptr_deleter<AVCodecContext> mCodecContext;
 	std::mutex mCodecContextMutex;
 
+	shared_ptr<FramePool::Counters> mFramePoolCounters;
+	shared_ptr<FramePool> mEmptyFramePool;
+	shared_ptr<FramePool> mFramePool; // owned by the producer thread
+	std::atomic<bool> mHugePages = false;
+
+	PipelineLatency mLatency;
+
 private:
-	shared_ptr<AVFrame> pop();
 	void run();
 
 	string mCodecName;
 	std::thread mThread;
-	std::mutex mMutex;
-	std::condition_variable mCondition;
 	std::atomic<bool> mRunning = false;
 
-	std::queue<shared_ptr<AVFrame>> mFrameQueue;
+	FrameQueue<QueuedFrame> mFrameQueue;
+
+	std::atomic<int64_t> mPendingBitrate = -1; // none
+	std::atomic<bool> mKeyframeRequested = false;
+	std::atomic<int64_t> mKeyframeCoalescingUs;
+	std::atomic<uint64_t> mKeyframeRequests = 0;
+	std::atomic<uint64_t> mForcedKeyframes = 0;
+	optional<clock::time_point> mLastForcedKeyframe; // owned by the encoder thread
 };
 
 } // namespace rtcast
@@ -11,6 +11,13 @@
 
 #include "common.hpp"
 #include "audiodecoder.hpp"
+#include "bandwidthestimator.hpp"
+#include "encodedframe.hpp"
+#include "gopcache.hpp"
+#include "latency.hpp"
+#include "redencoder.hpp"
+#include "sendpool.hpp"
+#include "sharedpacketizer.hpp"
 
 #include <atomic>
 #include <chrono>
@@ -24,6 +31,7 @@ class WebSocketServer;
 class PeerConnection;
 class DataChannel;
 class Track;
+class RtpPacketizationConfig;
 
 } // namespace rtc
 
@@ -54,6 +62,47 @@ public:
 	void setVideo(VideoCodec codec);
 	void setAudio(AudioCodec codec);
 
+	// Duration of audio frames, each sent in its own packet, announced with ptime and maxptime
+	// Only affects clients connecting afterwards.
+	void setAudioFrameDuration(std::chrono::microseconds duration);
+
+	// Offer RED (RFC 2198) with Opus, each packet also carrying up to distance previous frames
+	// for clients accepting it, 0 to disable. Only affects clients connecting afterwards.
+	void setAudioRedundancy(unsigned int distance);
+
+	// Video renditions, ordered from the highest to the lowest nominal bitrate, must be set
+	// before clients connect. Encoded frames are tagged with their rendition.
+	void setRenditions(std::vector<int64_t> bitrates);
+	unsigned int renditionsCount() const;
+
+	// Each client receives a single rendition, selected from its bandwidth estimate unless set
+	// explicitly, or requested over the data channel with {"type":"rendition","rendition":N}
+	// ("auto" to revert). Switching happens on the next keyframe of the new rendition.
+	void setClientRendition(int id, optional<unsigned int> rendition);
+
+	// Packetize video frames once and rewrite RTP headers per client (H264 and H265 only)
+	// Only affects clients connecting afterwards
+	void setSharedPacketization(bool enabled);
+
+	// Per-client send queues, only affects clients connecting afterwards
+	// Unless the policy is Block, a client whose video queue is full skips until the next
+	// keyframe, so frames are never dropped from the middle of a GOP.
+	void setSendQueue(size_t capacity, DropPolicy policy);
+
+	// ICE settings, only affect clients connecting afterwards
+	// Without servers, only host candidates are gathered, for instance for loopback tests.
+	struct IceSettings {
+		std::vector<string> servers = {"stun:stun.l.google.com:19302"};
+		optional<string> bindAddress;
+	};
+
+	void setIceSettings(IceSettings settings);
+
+	uint16_t port() const; // of the WebSocket server, useful when created on port 0
+
+	// Frames are queued per client and sent asynchronously by the send pool
+	void broadcastVideo(shared_ptr<const EncodedFrame> frame);
+	void broadcastAudio(shared_ptr<const EncodedFrame> frame);
 	void broadcastVideo(const byte *data, size_t size, std::chrono::microseconds timestamp);
 	void broadcastAudio(const byte *data, size_t size, uint32_t timestamp);
 	void broadcastMessage(string message);
@@ -67,33 +116,252 @@ public:
 
 	unsigned int clientsCount() const;
 
+	// A video client exceeding any threshold stops receiving frames until the next keyframe
+	struct HealthThresholds {
+		size_t maxQueuedFrames = 8;
+		double maxFractionLost = 0.2;
+		std::chrono::milliseconds maxRtt = std::chrono::milliseconds(1000);
+	};
+
+	void setHealthThresholds(HealthThresholds thresholds);
+
+	struct ClientHealth {
+		size_t queuedFrames = 0;
+		double fractionLost = 0.;
+		optional<std::chrono::microseconds> rtt;
+		bool skipping = false;       // waiting for a keyframe
+		uint64_t skips = 0;          // times the client entered the skipping state
+		uint64_t withheldFrames = 0; // frames not sent while skipping
+		optional<int64_t> estimatedBitrate;
+		optional<int64_t> remb; // if the client sends REMB
+		unsigned int rendition = 0;
+	};
+
+	optional<ClientHealth> clientHealth(int id);
+
+	// Transport counters of a track, maintained on the send path
+	struct TrackStats {
+		uint64_t packetsSent = 0; // retransmissions excluded
+		uint64_t bytesSent = 0;
+		uint64_t nacksReceived = 0; // packets requested by the client
+		uint64_t retransmissions = 0;
+		uint64_t retransmittedBytes = 0;
+		double fractionLost = 0.; // from the last receiver report
+		int32_t cumulativeLost = 0;
+		optional<std::chrono::microseconds> rtt;
+		size_t bufferedAmount = 0;
+	};
+
+	struct ClientStats {
+		int id = -1;
+		std::chrono::milliseconds age = {}; // since the WebSocket connection
+		bool connected = false;
+		optional<string> localCandidate; // selected ICE candidate pair
+		optional<string> remoteCandidate;
+		size_t transportBytesSent = 0; // including RTCP and data channel messages
+		size_t transportBytesReceived = 0;
+		optional<TrackStats> video;
+		optional<TrackStats> audio;
+	};
+
+	optional<ClientStats> clientStats(int id);
+	std::vector<ClientStats> allStats();
+
+	// Called when a client needs a keyframe: on join, on PLI or FIR, to recover from skipping,
+	// or to switch to another rendition
+	using keyframe_request_callback = std::function<void(int id, unsigned int rendition)>;
+	void onKeyframeRequest(keyframe_request_callback callback);
+
+	// Request a keyframe when a client's video track opens instead of waiting for the next GOP
+	// Clients primed from the GOP cache do not need one.
+	void setKeyframeOnJoin(bool enabled);
+
+	// Keep the video since the last keyframe to prime joining clients, who can start decoding
+	// immediately. The cached GOP is sent paced at the priming bitrate with timestamps compressed
+	// up to the live frame. A zero size disables the cache.
+	void setGopCache(size_t maxBytes);
+	void setPrimingBitrate(int64_t bitrate);
+
+	// The target video bitrate is derived from per-client bandwidth estimates
+	enum class BitratePolicy {
+		Min,          // The slowest client sets the bitrate
+		Percentile,   // Bitrate at the given percentile, slower clients rely on frame skipping
+		PerRendition, // Minimum per rendition, same as Min with a single rendition
+	};
+
+	void setBitratePolicy(BitratePolicy policy, double percentile = 0.1);
+	void setBitrateRange(int64_t minBitrate, int64_t maxBitrate);
+
+	using target_bitrate_callback = std::function<void(int64_t bitrate)>;
+	void onTargetBitrate(target_bitrate_callback callback);
+	optional<int64_t> targetBitrate() const;
+
+	// With PerRendition and several renditions, the target of each rendition is reported with
+	// onRenditionBitrate instead of onTargetBitrate, capped to the rendition nominal bitrate
+	using rendition_bitrate_callback = std::function<void(unsigned int rendition, int64_t bitrate)>;
+	void onRenditionBitrate(rendition_bitrate_callback callback);
+
+	// Called on each audio receiver report with the highest fraction lost among audio clients,
+	// for instance to feed an AudioController
+	using audio_loss_callback = std::function<void(double fractionLost)>;
+	void onAudioLoss(audio_loss_callback callback);
+
+	// Queue wait and send latency are recorded per client, the other stages are reported by
+	// the encoders
+	struct Stats {
+		LatencyStats video;
+		LatencyStats audio;
+		LatencySummary timeToFirstFrame; // from the video track opening to the first frame sent
+		GopCache::Stats gopCache; // summed over renditions
+		uint64_t primedClients = 0;
+	};
+
+	Stats stats() const;
+	void resetStats();
+
 private:
+	struct Client;
+	struct Transport; // per track
+	struct VideoStream;
+
 	int connect(shared_ptr<rtc::WebSocket> ws);
 	void remove(int id);
+	void sendVideo(Client &client, const SendPool::Item &item, SendPool::clock::time_point queued);
+	void sendAudio(Client &client, const SendPool::Item &item, SendPool::clock::time_point queued);
+	void deliverVideo(Client &client, const SendPool::Item &item);
+	bool startPriming(Client &client, const SendPool::Item &item);
+	void continuePriming(Client &client);
+	void cacheVideo(VideoStream &stream, shared_ptr<const EncodedFrame> frame,
+	                shared_ptr<const SharedPacketizer::Frame> packets);
+	void recordFirstFrame(Client &client);
+	ClientStats collectStats(Client &client);
+	bool isCongested(Client &client, bool countDrops);
+	void requestKeyframe(Client &client);
+	void selectRendition(Client &client);
+	bool handleControlMessage(Client &client, const string &message);
+	void updateTargetBitrate();
+	void updateRenditionBitrates(std::chrono::steady_clock::time_point now);
+	void updateAudioLoss();
+	void negotiateAudio(Client &client);
 
 	std::atomic<VideoCodec> mVideoCodec = VideoCodec::None;
 	std::atomic<AudioCodec> mAudioCodec = AudioCodec::None;
+	std::atomic<int64_t> mAudioFrameDurationUs = 20000;
+	std::atomic<unsigned int> mAudioRedundancy = 0;
 	std::atomic<bool> mReceiveVideo = false;
 	std::atomic<bool> mReceiveAudio = false;
+	std::atomic<bool> mSharedPacketization = true;
+	std::atomic<bool> mKeyframeOnJoin = true;
 
 	unique_ptr<rtc::WebSocketServer> mWebSocketServer;
 
-	struct Client {
+	struct Health {
+		std::atomic<double> fractionLost = 0.;
+		std::atomic<int64_t> rttUs = -1; // unknown
+		std::atomic<bool> skipping = false;
+		std::atomic<bool> priming = false; // the next frame starts sending the cached GOP
+		std::atomic<uint64_t> skips = 0;
+		std::atomic<uint64_t> withheldFrames = 0;
+		uint64_t lastDropped = 0; // queue drops seen, guarded by the client's video send mutex
+		std::atomic<int64_t> openedAtUs = 0; // until the first frame is sent
+	};
+
+	// Cached GOP being sent to a joining client, paced without blocking a send worker
+	struct Priming {
+		std::vector<SendPool::Item> items;
+		std::vector<std::chrono::microseconds> timestamps; // compressed up to the live frame
+		size_t next = 0;
+		size_t bytes = 0; // sent so far
+		std::chrono::steady_clock::time_point start;
+		std::vector<SendPool::Item> held; // live frames arriving meanwhile
+	};
+
+	struct Client : std::enable_shared_from_this<Client> {
+		int id;
 		std::shared_ptr<rtc::PeerConnection> pc;
 		std::shared_ptr<rtc::DataChannel> dc;
 		std::shared_ptr<rtc::Track> video;
 		std::shared_ptr<rtc::Track> audio;
+		std::shared_ptr<SharedPacketizer::Session> videoSession;
+		std::shared_ptr<SendPool::Queue> videoQueue;
+		std::shared_ptr<SendPool::Queue> audioQueue;
+		std::shared_ptr<rtc::RtpPacketizationConfig> audioConfig;
+		std::atomic<bool> audioRed = false;    // accepted in the answer
+		std::atomic<int> opusPayloadType = -1; // negotiated, tags RED blocks, offered if negative
+		Health videoHealth;
+		std::mutex videoSendMutex;  // serializes the video queue with paced priming
+		unique_ptr<Priming> priming; // while the cached GOP is being sent
+		std::shared_ptr<Transport> videoTransport;
+		std::shared_ptr<Transport> audioTransport;
+		std::shared_ptr<BandwidthEstimator> estimator;
+		std::chrono::steady_clock::time_point createdAt;
+
+		std::mutex renditionMutex;                // serializes switching with broadcasting
+		std::atomic<unsigned int> rendition = 0;  // being sent
+		std::atomic<unsigned int> targetRendition = 0;
+		std::atomic<int> requestedRendition = -1; // automatic selection if negative
+	};
+
+	// Encoded video of one rendition
+	struct VideoStream {
+		unique_ptr<SharedPacketizer> packetizer; // if shared packetization is supported
+		GopCache gopCache;
+		binary parameterSets; // owned by the broadcasting thread
+		int64_t bitrate = 0;  // nominal
+
+		explicit VideoStream(size_t gopCacheSize) : gopCache(gopCacheSize) {}
 	};
 
 	std::shared_mutex mMutex;
 	std::atomic<int> mNextClientId = 0;
 	std::map<int, shared_ptr<Client>> mClients;
 
+	std::vector<unique_ptr<VideoStream>> mVideoStreams; // per rendition, created by setVideo()
+	unique_ptr<RedEncoder> mRedEncoder; // owned by the broadcasting thread, kept once created
+	std::atomic<size_t> mGopCacheSize;
+	std::atomic<int64_t> mPrimingBitrate;
+	std::atomic<uint64_t> mPrimedClients = 0;
+
 	std::mutex mMessageCallbackMutex;
 	message_callback mMessageCallback;
 
 	std::mutex mDecoderCallbackMutex;
 	audio_decoder_callback mAudioDecoderCallback;
+
+	std::mutex mKeyframeRequestCallbackMutex;
+	keyframe_request_callback mKeyframeRequestCallback;
+
+	std::atomic<size_t> mMaxQueuedFrames;
+	std::atomic<double> mMaxFractionLost;
+	std::atomic<int64_t> mMaxRttUs;
+
+	std::atomic<BitratePolicy> mBitratePolicy = BitratePolicy::Min;
+	std::atomic<double> mBitratePercentile = 0.1;
+	std::atomic<int64_t> mMinBitrate;
+	std::atomic<int64_t> mMaxBitrate;
+
+	std::mutex mTargetBitrateMutex;
+	target_bitrate_callback mTargetBitrateCallback;
+	std::atomic<int64_t> mTargetBitrate = 0; // 0 if unknown
+	std::chrono::steady_clock::time_point mLastTargetIncrease;
+	rendition_bitrate_callback mRenditionBitrateCallback;
+	std::vector<int64_t> mRenditionTargets; // 0 if unknown
+	std::vector<std::chrono::steady_clock::time_point> mLastRenditionIncreases;
+
+	std::mutex mAudioLossMutex;
+	audio_loss_callback mAudioLossCallback;
+
+	PipelineLatency mVideoLatency;
+	PipelineLatency mAudioLatency;
+	LatencyHistogram mTimeToFirstFrame;
+
+	std::atomic<size_t> mSendQueueCapacity;
+	std::atomic<DropPolicy> mSendQueuePolicy;
+
+	mutable std::mutex mIceSettingsMutex;
+	IceSettings mIceSettings;
+
+	shared_ptr<SendPool> mSendPool; // last so that workers are joined first
 };
 
 } // namespace rtcast
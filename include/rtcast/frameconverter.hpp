@@ -0,0 +1,85 @@
+/**
+ * Copyright (c) 2025 Paul-Louis Ageneau
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef FRAME_CONVERTER_H
+#define FRAME_CONVERTER_H
+
+#include "common.hpp"
+
+extern "C" {
+#include <libavutil/frame.h>
+#include <libswscale/swscale.h>
+}
+
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <thread>
+
+namespace rtcast {
+
+// Pixel format conversion and scaling, optionally across threads
+// Conversions to I420 without scaling use the SIMD kernels of pixelconvert.hpp when available,
+// otherwise swscale. Conversions without scaling are split in horizontal slices, each with its
+// own SwsContext, and scaling relies on the threaded swscale API where available.
+class FrameConverter final {
+public:
+	explicit FrameConverter(unsigned int threads = 1);
+	~FrameConverter();
+
+	FrameConverter(const FrameConverter &) = delete;
+	FrameConverter &operator=(const FrameConverter &) = delete;
+
+	unsigned int threadsCount() const { return mThreadsCount; }
+
+	// The output frame must be allocated with the target size and pixel format
+	// Full range input is compressed to limited range if the output range is MPEG.
+	void convert(const AVFrame *input, AVFrame *output);
+
+private:
+	struct Geometry {
+		int width = 0;
+		int height = 0;
+		AVPixelFormat pixelFormat = AV_PIX_FMT_NONE;
+		AVColorRange range = AVCOL_RANGE_UNSPECIFIED;
+
+		bool operator==(const Geometry &other) const;
+		bool operator!=(const Geometry &other) const { return !(*this == other); }
+	};
+
+	struct Slice {
+		unique_ptr_deleter<SwsContext> context; // null for a conversion kernel
+		int begin = 0; // first row
+		int height = 0;
+	};
+
+	void configure(Geometry input, Geometry output);
+	void convertSlice(const Slice &slice);
+	void run();
+
+	const unsigned int mThreadsCount;
+	Geometry mInputGeometry;
+	Geometry mOutputGeometry;
+	unique_ptr_deleter<SwsContext> mContext; // if not sliced
+	std::vector<Slice> mSlices;
+
+	std::vector<std::thread> mThreads;
+	std::mutex mMutex;
+	std::condition_variable mCondition;
+	std::condition_variable mDoneCondition;
+	const AVFrame *mInput = nullptr;
+	AVFrame *mOutput = nullptr;
+	size_t mNextSlice = 0;
+	size_t mPendingSlices = 0;
+	std::exception_ptr mError;
+	bool mStopping = false;
+};
+
+} // namespace rtcast
+
+#endif
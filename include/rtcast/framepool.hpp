@@ -0,0 +1,117 @@
+/**
+ * Copyright (c) 2025 Paul-Louis Ageneau
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef FRAME_POOL_H
+#define FRAME_POOL_H
+
+#include "common.hpp"
+
+extern "C" {
+#include <libavutil/buffer.h>
+#include <libavutil/channel_layout.h>
+#include <libavutil/frame.h>
+#include <libavutil/pixfmt.h>
+#include <libavutil/samplefmt.h>
+}
+
+#include <atomic>
+#include <mutex>
+
+namespace rtcast {
+
+// Pool of AVFrames whose buffers are drawn from AVBufferPools sized for a fixed geometry
+class FramePool final : public std::enable_shared_from_this<FramePool> {
+public:
+	struct Stats {
+		uint64_t hits = 0;
+		uint64_t misses = 0;
+		uint64_t allocatedBytes = 0;
+		uint64_t hugePageBytes = 0;
+	};
+
+	// Counters may be shared between successive pools so statistics survive reconfiguration
+	struct Counters {
+		std::atomic<uint64_t> requests = 0;
+		std::atomic<uint64_t> misses = 0;
+		std::atomic<uint64_t> allocatedBytes = 0;
+		std::atomic<uint64_t> hugePageBytes = 0;
+
+		Stats stats() const;
+	};
+
+	struct VideoFormat {
+		int width = 0;
+		int height = 0;
+		AVPixelFormat pixelFormat = AV_PIX_FMT_NONE;
+
+		bool operator==(const VideoFormat &other) const;
+		bool operator!=(const VideoFormat &other) const { return !(*this == other); }
+	};
+
+	struct AudioFormat {
+		AVSampleFormat sampleFormat = AV_SAMPLE_FMT_NONE;
+		int sampleRate = 0;
+		int nbChannels = 0;
+		int nbSamples = 0;
+
+		bool operator==(const AudioFormat &other) const;
+		bool operator!=(const AudioFormat &other) const { return !(*this == other); }
+	};
+
+	// Pool of empty frames, for instance to receive decoded frames
+	static shared_ptr<FramePool> Create(shared_ptr<Counters> counters = nullptr);
+	static shared_ptr<FramePool> Create(VideoFormat format, bool hugePages = false,
+	                                    shared_ptr<Counters> counters = nullptr);
+	static shared_ptr<FramePool> Create(AudioFormat format, bool hugePages = false,
+	                                    shared_ptr<Counters> counters = nullptr);
+
+	~FramePool();
+
+	const optional<VideoFormat> &videoFormat() const { return mVideoFormat; }
+	const optional<AudioFormat> &audioFormat() const { return mAudioFormat; }
+
+	// Frame with pooled buffers and parameters set according to the pool format
+	shared_ptr<AVFrame> get();
+
+	// Recycled frame without buffers
+	shared_ptr<AVFrame> getEmpty();
+
+	// Frame from a set kept by the pool, reused once the caller and every reference to its
+	// buffers released it, so that steady-state use does not allocate. Not thread-safe.
+	shared_ptr<AVFrame> getReusable();
+
+	Stats stats() const;
+
+private:
+	FramePool(shared_ptr<Counters> counters, bool hugePages);
+
+	static AVBufferRef *PoolAlloc(void *opaque, size_t size);
+
+	void initPools(const size_t *sizes, int count);
+	void fill(AVFrame *frame);
+	AVBufferRef *alloc(size_t size);
+	AVFrame *takeFrame();
+	void recycleFrame(AVFrame *frame);
+
+	const shared_ptr<Counters> mCounters;
+	const bool mHugePages;
+
+	optional<VideoFormat> mVideoFormat;
+	optional<AudioFormat> mAudioFormat;
+	std::vector<unique_ptr_deleter<AVBufferPool>> mBufferPools;
+	int mLinesize[AV_NUM_DATA_POINTERS] = {};
+
+	std::mutex mFramesMutex;
+	std::vector<AVFrame *> mFrames;
+
+	std::vector<shared_ptr<AVFrame>> mReusableFrames; // owned by the caller's thread
+};
+
+} // namespace rtcast
+
+#endif
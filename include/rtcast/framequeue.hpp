@@ -0,0 +1,312 @@
+/**
+ * Copyright (c) 2025 Paul-Louis Ageneau
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef FRAME_QUEUE_H
+#define FRAME_QUEUE_H
+
+#include "common.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <stdexcept>
+
+namespace rtcast {
+
+// Behavior of a FrameQueue when it is full or when elements are too old
+enum class DropPolicy {
+	DropNewest, // Discard the incoming element
+	DropOldest, // Evict the oldest queued element to make room
+	Deadline,   // Like DropOldest, and also discard elements older than the deadline on pop
+	Block,      // Block the producer until there is room (backpressure for file sources)
+};
+
+// Bounded lock-free queue for frame hand-off between threads
+// The ring is a sequence-numbered slot array so that the producer may evict the oldest element
+// (acting as a second consumer) without racing with the consumer. Locking only happens to put a
+// thread to sleep when the queue is empty (consumer) or full with the Block policy (producer).
+// The slot array is rounded up to a power of two, but the queue holds at most capacity elements.
+template <typename T> class FrameQueue {
+public:
+	using clock = std::chrono::steady_clock;
+
+	struct Stats {
+		uint64_t pushed = 0;
+		uint64_t popped = 0;
+		uint64_t droppedNewest = 0;
+		uint64_t droppedOldest = 0;
+		uint64_t droppedDeadline = 0;
+		uint64_t blocked = 0;
+	};
+
+	struct Item {
+		T value;
+		clock::time_point enqueued;
+	};
+
+	explicit FrameQueue(size_t capacity, DropPolicy policy = DropPolicy::DropOldest);
+	~FrameQueue();
+
+	FrameQueue(const FrameQueue &) = delete;
+	FrameQueue &operator=(const FrameQueue &) = delete;
+
+	size_t capacity() const { return mCapacity; }
+	size_t size() const;
+	bool empty() const { return size() == 0; }
+
+	void setPolicy(DropPolicy policy) { mPolicy.store(policy, std::memory_order_relaxed); }
+	DropPolicy policy() const { return mPolicy.load(std::memory_order_relaxed); }
+
+	void setDeadline(std::chrono::microseconds deadline) {
+		mDeadline.store(deadline.count(), std::memory_order_relaxed);
+	}
+	std::chrono::microseconds deadline() const {
+		return std::chrono::microseconds(mDeadline.load(std::memory_order_relaxed));
+	}
+
+	// Returns false if the value was dropped or the queue is closed
+	bool push(T value);
+
+	// Non-blocking, returns nullopt if empty
+	optional<Item> tryPop();
+
+	// Blocking, returns nullopt once closed and empty
+	optional<Item> pop();
+
+	// Wake up waiting threads, subsequent pushes are rejected
+	void close();
+	void reopen();
+	bool isClosed() const { return mClosed.load(std::memory_order_acquire); }
+
+	Stats stats() const;
+
+private:
+	struct Slot {
+		std::atomic<size_t> sequence;
+		Item item;
+	};
+
+	static size_t RoundUpPowerOfTwo(size_t n) {
+		size_t p = 2;
+		while (p < n)
+			p <<= 1;
+		return p;
+	}
+
+	bool tryEnqueue(T &value);
+	bool tryDequeue(Item &item);
+	void notify(std::atomic<int> &waiting);
+
+	unique_ptr<Slot[]> mSlots;
+	const size_t mMask;
+	const size_t mCapacity;
+
+	alignas(64) std::atomic<size_t> mEnqueuePos = 0;
+	alignas(64) std::atomic<size_t> mDequeuePos = 0;
+
+	std::atomic<DropPolicy> mPolicy;
+	std::atomic<int64_t> mDeadline = 0;
+	std::atomic<bool> mClosed = false;
+
+	std::mutex mMutex;
+	std::condition_variable mCondition;
+	std::atomic<int> mWaitingConsumers = 0;
+	std::atomic<int> mWaitingProducers = 0;
+
+	struct {
+		std::atomic<uint64_t> pushed = 0;
+		std::atomic<uint64_t> popped = 0;
+		std::atomic<uint64_t> droppedNewest = 0;
+		std::atomic<uint64_t> droppedOldest = 0;
+		std::atomic<uint64_t> droppedDeadline = 0;
+		std::atomic<uint64_t> blocked = 0;
+	} mCounters;
+};
+
+template <typename T>
+FrameQueue<T>::FrameQueue(size_t capacity, DropPolicy policy)
+    : mSlots(new Slot[RoundUpPowerOfTwo(capacity)]),
+      mMask(RoundUpPowerOfTwo(capacity) - 1), mCapacity(capacity), mPolicy(policy) {
+	if (capacity == 0)
+		throw std::invalid_argument("Frame queue capacity must be positive");
+
+	for (size_t i = 0; i <= mMask; ++i)
+		mSlots[i].sequence.store(i, std::memory_order_relaxed);
+}
+
+template <typename T> FrameQueue<T>::~FrameQueue() { close(); }
+
+template <typename T> size_t FrameQueue<T>::size() const {
+	size_t dequeuePos = mDequeuePos.load(std::memory_order_acquire);
+	size_t enqueuePos = mEnqueuePos.load(std::memory_order_acquire);
+	return enqueuePos > dequeuePos ? enqueuePos - dequeuePos : 0;
+}
+
+template <typename T> bool FrameQueue<T>::tryEnqueue(T &value) {
+	size_t pos = mEnqueuePos.load(std::memory_order_relaxed);
+	while (true) {
+		Slot &slot = mSlots[pos & mMask];
+		size_t seq = slot.sequence.load(std::memory_order_acquire);
+		auto diff = static_cast<std::ptrdiff_t>(seq) - static_cast<std::ptrdiff_t>(pos);
+		if (diff == 0) {
+			// The slot is free but the queue may already hold capacity elements
+			if (pos - mDequeuePos.load(std::memory_order_acquire) >= mCapacity)
+				return false; // full
+
+			if (mEnqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+				slot.item.value = std::move(value);
+				slot.item.enqueued = clock::now();
+				slot.sequence.store(pos + 1, std::memory_order_release);
+				return true;
+			}
+		} else if (diff < 0) {
+			return false; // full
+		} else {
+			pos = mEnqueuePos.load(std::memory_order_relaxed);
+		}
+	}
+}
+
+template <typename T> bool FrameQueue<T>::tryDequeue(Item &item) {
+	size_t pos = mDequeuePos.load(std::memory_order_relaxed);
+	while (true) {
+		Slot &slot = mSlots[pos & mMask];
+		size_t seq = slot.sequence.load(std::memory_order_acquire);
+		auto diff = static_cast<std::ptrdiff_t>(seq) - static_cast<std::ptrdiff_t>(pos + 1);
+		if (diff == 0) {
+			if (mDequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+				item = std::move(slot.item);
+				slot.item = Item{};
+				slot.sequence.store(pos + mMask + 1, std::memory_order_release);
+				return true;
+			}
+		} else if (diff < 0) {
+			return false; // empty
+		} else {
+			pos = mDequeuePos.load(std::memory_order_relaxed);
+		}
+	}
+}
+
+template <typename T> void FrameQueue<T>::notify(std::atomic<int> &waiting) {
+	// Pairs with the fence in the waiting thread so that either the waiter sees the change or we
+	// see the waiter, this keeps the mutex off the fast path
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	if (waiting.load(std::memory_order_relaxed) > 0) {
+		std::lock_guard lock(mMutex);
+		mCondition.notify_all();
+	}
+}
+
+template <typename T> bool FrameQueue<T>::push(T value) {
+	if (mClosed.load(std::memory_order_acquire))
+		return false;
+
+	while (!tryEnqueue(value)) {
+		switch (mPolicy.load(std::memory_order_relaxed)) {
+		case DropPolicy::DropNewest:
+			mCounters.droppedNewest.fetch_add(1, std::memory_order_relaxed);
+			return false;
+
+		case DropPolicy::DropOldest:
+		case DropPolicy::Deadline: {
+			Item evicted;
+			if (tryDequeue(evicted)) {
+				mCounters.droppedOldest.fetch_add(1, std::memory_order_relaxed);
+				notify(mWaitingProducers);
+			}
+			break;
+		}
+
+		case DropPolicy::Block: {
+			mCounters.blocked.fetch_add(1, std::memory_order_relaxed);
+			std::unique_lock lock(mMutex);
+			mWaitingProducers.fetch_add(1, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			mCondition.wait(lock, [this]() {
+				return size() < capacity() || mClosed.load(std::memory_order_acquire);
+			});
+			mWaitingProducers.fetch_sub(1, std::memory_order_relaxed);
+			if (mClosed.load(std::memory_order_acquire))
+				return false;
+
+			break;
+		}
+		}
+	}
+
+	mCounters.pushed.fetch_add(1, std::memory_order_relaxed);
+	notify(mWaitingConsumers);
+	return true;
+}
+
+template <typename T> optional<typename FrameQueue<T>::Item> FrameQueue<T>::tryPop() {
+	Item item;
+	while (tryDequeue(item)) {
+		notify(mWaitingProducers);
+
+		if (mPolicy.load(std::memory_order_relaxed) == DropPolicy::Deadline) {
+			auto limit = deadline();
+			if (limit.count() > 0 && clock::now() - item.enqueued > limit) {
+				mCounters.droppedDeadline.fetch_add(1, std::memory_order_relaxed);
+				continue;
+			}
+		}
+
+		mCounters.popped.fetch_add(1, std::memory_order_relaxed);
+		return std::make_optional(std::move(item));
+	}
+
+	return nullopt;
+}
+
+template <typename T> optional<typename FrameQueue<T>::Item> FrameQueue<T>::pop() {
+	while (true) {
+		if (auto item = tryPop())
+			return item;
+
+		std::unique_lock lock(mMutex);
+		mWaitingConsumers.fetch_add(1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		mCondition.wait(lock,
+		                [this]() { return !empty() || mClosed.load(std::memory_order_acquire); });
+		mWaitingConsumers.fetch_sub(1, std::memory_order_relaxed);
+		if (empty() && mClosed.load(std::memory_order_acquire))
+			return nullopt;
+	}
+}
+
+template <typename T> void FrameQueue<T>::close() {
+	std::lock_guard lock(mMutex);
+	mClosed.store(true, std::memory_order_release);
+	mCondition.notify_all();
+}
+
+template <typename T> void FrameQueue<T>::reopen() {
+	Item item;
+	while (tryDequeue(item))
+		;
+
+	mClosed.store(false, std::memory_order_release);
+}
+
+template <typename T> typename FrameQueue<T>::Stats FrameQueue<T>::stats() const {
+	Stats stats;
+	stats.pushed = mCounters.pushed.load(std::memory_order_relaxed);
+	stats.popped = mCounters.popped.load(std::memory_order_relaxed);
+	stats.droppedNewest = mCounters.droppedNewest.load(std::memory_order_relaxed);
+	stats.droppedOldest = mCounters.droppedOldest.load(std::memory_order_relaxed);
+	stats.droppedDeadline = mCounters.droppedDeadline.load(std::memory_order_relaxed);
+	stats.blocked = mCounters.blocked.load(std::memory_order_relaxed);
+	return stats;
+}
+
+} // namespace rtcast
+
+#endif
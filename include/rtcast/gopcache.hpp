@@ -0,0 +1,56 @@
+/**
+ * Copyright (c) 2025 Paul-Louis Ageneau
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef GOP_CACHE_H
+#define GOP_CACHE_H
+
+#include "common.hpp"
+#include "sendpool.hpp"
+
+#include <chrono>
+#include <mutex>
+
+namespace rtcast {
+
+// Encoded video since the most recent keyframe, to prime joining clients without forcing a new
+// keyframe for everyone. Frames are held by reference, and the GOP is dropped until the next
+// keyframe if it exceeds the memory cap.
+class GopCache final {
+public:
+	explicit GopCache(size_t maxBytes);
+
+	struct Stats {
+		size_t frames = 0;
+		size_t bytes = 0;
+		uint64_t overflows = 0; // GOPs dropped for exceeding the cap
+	};
+
+	void setMaxBytes(size_t maxBytes); // 0 disables the cache
+	bool enabled() const;
+
+	// A keyframe starts a new GOP, other frames are ignored until the first keyframe
+	void push(SendPool::Item item);
+	void clear();
+
+	// Frames of the current GOP up to the frame with the given timestamp, empty if the frame is
+	// not part of the cached GOP
+	std::vector<SendPool::Item> get(std::chrono::microseconds until) const;
+
+	Stats stats() const;
+
+private:
+	mutable std::mutex mMutex;
+	size_t mMaxBytes;
+	std::vector<SendPool::Item> mItems;
+	size_t mBytes = 0;
+	uint64_t mOverflows = 0;
+};
+
+} // namespace rtcast
+
+#endif
@@ -0,0 +1,91 @@
+/**
+ * Copyright (c) 2025 Paul-Louis Ageneau
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef LATENCY_H
+#define LATENCY_H
+
+#include "common.hpp"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <map>
+
+namespace rtcast {
+
+struct LatencySummary {
+	uint64_t count = 0;
+	std::chrono::microseconds p50 = {};
+	std::chrono::microseconds p99 = {};
+	std::chrono::microseconds max = {};
+};
+
+// Lock-free log-linear histogram of durations (HDR-style, relative error below 3%)
+// Recording is a couple of relaxed atomic increments so it can stay enabled in production.
+class LatencyHistogram final {
+public:
+	LatencyHistogram();
+
+	void record(std::chrono::microseconds value);
+	void reset();
+
+	uint64_t count() const;
+	std::chrono::microseconds max() const;
+	std::chrono::microseconds percentile(double p) const;
+	LatencySummary summary() const;
+
+private:
+	static const int SubBucketBits = 5;
+	static const int SubBucketCount = 1 << SubBucketBits;
+	static const int MaxValueBits = 36; // about 19 hours in microseconds
+	static const int BucketCount = (MaxValueBits - SubBucketBits + 2) * SubBucketCount / 2;
+
+	static int IndexOf(uint64_t value);
+	static uint64_t ValueOf(int index);
+
+	std::array<std::atomic<uint64_t>, BucketCount> mCounts;
+	std::atomic<uint64_t> mCount = 0;
+	std::atomic<uint64_t> mMax = 0;
+};
+
+enum class PipelineStage {
+	Capture, // Device capture or input decoding until the frame is handed to the encoder
+	Convert, // Pixel format conversion or audio resampling in the encoder push
+	Queue,   // Wait in the encoder frame queue
+	Encode,  // From avcodec_send_frame() to the packet being received
+	Send,    // Per-client send in the Endpoint
+	Total,   // From the encoder push to the end of the broadcast
+};
+
+const char *PipelineStageName(PipelineStage stage);
+
+using LatencyStats = std::map<PipelineStage, LatencySummary>;
+
+// One histogram per pipeline stage
+class PipelineLatency final {
+public:
+	void record(PipelineStage stage, std::chrono::microseconds value) {
+		mHistograms[static_cast<size_t>(stage)].record(value);
+	}
+
+	template <typename Duration> void record(PipelineStage stage, Duration value) {
+		record(stage, std::chrono::duration_cast<std::chrono::microseconds>(value));
+	}
+
+	LatencyStats stats() const;
+	void reset();
+
+private:
+	static const size_t StageCount = static_cast<size_t>(PipelineStage::Total) + 1;
+
+	std::array<LatencyHistogram, StageCount> mHistograms;
+};
+
+} // namespace rtcast
+
+#endif
@@ -0,0 +1,128 @@
+/**
+ * Copyright (c) 2025 Paul-Louis Ageneau
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef LOG_H
+#define LOG_H
+
+#include "common.hpp"
+
+#include <atomic>
+#include <ostream>
+#include <streambuf>
+
+// Messages below this level are stripped at compile time (0 = Trace, 1 = Debug, 2 = Info...)
+#ifndef RTCAST_LOG_MIN_LEVEL
+#ifdef NDEBUG
+#define RTCAST_LOG_MIN_LEVEL 1
+#else
+#define RTCAST_LOG_MIN_LEVEL 0
+#endif
+#endif
+
+namespace rtcast {
+
+enum class LogLevel {
+	Trace = 0,
+	Debug = 1,
+	Info = 2,
+	Warning = 3,
+	Error = 4,
+	None = 5,
+};
+
+using log_callback = std::function<void(LogLevel level, string message)>;
+
+// Messages are written to stderr by a background thread, or passed to the callback if set
+void InitLogger(LogLevel level, log_callback callback = nullptr);
+void FlushLogger();
+
+namespace logging {
+
+extern std::atomic<LogLevel> RuntimeLevel;
+
+inline bool Enabled(LogLevel level) {
+	return level >= RuntimeLevel.load(std::memory_order_relaxed);
+}
+
+// Lock-free rate limiter for a call site (generic cell rate algorithm)
+class RateLimiter final {
+public:
+	RateLimiter(double perSecond, unsigned int burst = 1);
+
+	bool allow();
+	uint64_t takeSuppressed();
+
+private:
+	const int64_t mIntervalNs;
+	const int64_t mToleranceNs;
+	std::atomic<int64_t> mTheoreticalArrival = 0;
+	std::atomic<uint64_t> mSuppressed = 0;
+};
+
+// Formats a message into a fixed buffer and submits it to the calling thread's ring on
+// destruction, no allocation or system call happens on the calling thread
+class Line final {
+public:
+	Line(LogLevel level, const char *file, int line, RateLimiter *limiter = nullptr);
+	~Line();
+
+	Line(const Line &) = delete;
+	Line &operator=(const Line &) = delete;
+
+	std::ostream &stream() { return mStream; }
+
+	static const size_t MaxSize = 240;
+
+private:
+	class Buffer final : public std::streambuf {
+	public:
+		Buffer();
+		size_t size() const;
+		const char *data() const { return mData; }
+
+	protected:
+		int_type overflow(int_type ch) override;
+
+	private:
+		char mData[MaxSize];
+	};
+
+	LogLevel mLevel;
+	const char *mFile;
+	int mLine;
+	RateLimiter *mLimiter;
+	Buffer mBuffer;
+	std::ostream mStream;
+};
+
+} // namespace logging
+} // namespace rtcast
+
+#define RTCAST_LOG_LINE(level)                                                                     \
+	if (int(level) < RTCAST_LOG_MIN_LEVEL || !rtcast::logging::Enabled(level))                     \
+		;                                                                                          \
+	else                                                                                           \
+		rtcast::logging::Line(level, __FILE__, __LINE__).stream()
+
+#define RTCAST_LOG_TRACE RTCAST_LOG_LINE(rtcast::LogLevel::Trace)
+#define RTCAST_LOG_DEBUG RTCAST_LOG_LINE(rtcast::LogLevel::Debug)
+#define RTCAST_LOG_INFO RTCAST_LOG_LINE(rtcast::LogLevel::Info)
+#define RTCAST_LOG_WARNING RTCAST_LOG_LINE(rtcast::LogLevel::Warning)
+#define RTCAST_LOG_ERROR RTCAST_LOG_LINE(rtcast::LogLevel::Error)
+
+// Log at most perSecond messages per second from this call site, suppressed messages are counted
+#define RTCAST_LOG_LIMITED(level, perSecond)                                                       \
+	if (int(level) < RTCAST_LOG_MIN_LEVEL || !rtcast::logging::Enabled(level))                     \
+		;                                                                                          \
+	else if (static rtcast::logging::RateLimiter rtcast_log_limiter_(perSecond);                   \
+	         !rtcast_log_limiter_.allow())                                                         \
+		;                                                                                          \
+	else                                                                                           \
+		rtcast::logging::Line(level, __FILE__, __LINE__, &rtcast_log_limiter_).stream()
+
+#endif
@@ -0,0 +1,56 @@
+/**
+ * Copyright (c) 2025 Paul-Louis Ageneau
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef NACK_RESPONDER_H
+#define NACK_RESPONDER_H
+
+#include "common.hpp"
+
+#include "rtc/rtc.hpp"
+
+#include <atomic>
+#include <mutex>
+
+namespace rtcast {
+
+// Media handler keeping the last sent RTP packets and retransmitting them on NACK, in place of
+// rtc::RtcpNackResponder so that sent and retransmitted packets are counted per track.
+// Must be chained after the packetizer and the RtcpSrReporter.
+class NackResponder final : public rtc::MediaHandler {
+public:
+	// Updated with relaxed atomics on the sending and transport threads
+	struct Counters {
+		std::atomic<uint64_t> packets = 0; // retransmissions excluded
+		std::atomic<uint64_t> bytes = 0;
+		std::atomic<uint64_t> nacks = 0; // packets requested, whether available or not
+		std::atomic<uint64_t> retransmissions = 0;
+		std::atomic<uint64_t> retransmittedBytes = 0;
+	};
+
+	static const size_t DefaultMaxPackets = 512;
+
+	NackResponder(uint32_t ssrc, shared_ptr<Counters> counters,
+	              size_t maxPackets = DefaultMaxPackets);
+
+	void incoming(rtc::message_vector &messages, const rtc::message_callback &send) override;
+	void outgoing(rtc::message_vector &messages, const rtc::message_callback &send) override;
+
+private:
+	void parse(const byte *data, size_t size, const rtc::message_callback &send);
+	void retransmit(uint16_t sequence, const rtc::message_callback &send);
+
+	const uint32_t mSsrc;
+	const shared_ptr<Counters> mCounters;
+
+	std::mutex mMutex;
+	std::vector<rtc::message_ptr> mPackets; // indexed by sequence number modulo the size
+};
+
+} // namespace rtcast
+
+#endif
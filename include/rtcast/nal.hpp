@@ -0,0 +1,109 @@
+/**
+ * Copyright (c) 2025 Paul-Louis Ageneau
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef NAL_H
+#define NAL_H
+
+#include "common.hpp"
+
+namespace rtcast {
+
+namespace nal {
+
+// Calls func(unit, size) for each NAL unit of an Annex-B bitstream, start codes excluded
+template <typename F> void ForEachUnit(const byte *data, size_t size, F func) {
+	auto is_start = [data, size](size_t i) {
+		return i + 3 <= size && data[i] == byte(0) && data[i + 1] == byte(0) &&
+		       data[i + 2] == byte(1);
+	};
+
+	size_t i = 0;
+	while (i < size && !is_start(i))
+		++i;
+
+	while (i < size) {
+		size_t begin = i + 3;
+		size_t end = begin;
+		while (end < size && !is_start(end))
+			++end;
+
+		i = end;
+		while (end > begin && data[end - 1] == byte(0)) // trailing zero of a 4-byte start code
+			--end;
+
+		if (end > begin)
+			func(data + begin, end - begin);
+	}
+}
+
+enum class H264Type : uint8_t {
+	Slice = 1,
+	Idr = 5,
+	Sei = 6,
+	Sps = 7,
+	Pps = 8,
+	Aud = 9,
+};
+
+inline uint8_t H264UnitType(const byte *unit) { return uint8_t(unit[0]) & 0x1F; }
+inline uint8_t H265UnitType(const byte *unit) { return (uint8_t(unit[0]) >> 1) & 0x3F; }
+
+// True if the access unit contains an IDR slice (H264) or an IRAP picture (H265)
+bool IsH264Keyframe(const byte *data, size_t size);
+bool IsH265Keyframe(const byte *data, size_t size);
+
+// Whether the first SPS of an Annex-B bitstream conforms to the profile offered by the endpoint,
+// Constrained Baseline for H264 and Main for H265, unset if there is no SPS
+optional<bool> IsH264ConstrainedBaseline(const byte *data, size_t size);
+optional<bool> IsH265Main(const byte *data, size_t size);
+
+// Parameter sets of an Annex-B access unit with 4-byte start codes, empty if there are none
+binary H264ParameterSets(const byte *data, size_t size);
+binary H265ParameterSets(const byte *data, size_t size);
+
+// Converts length-prefixed units, as stored in MP4 or Matroska, to Annex-B
+binary LengthPrefixedToAnnexB(const byte *data, size_t size, size_t lengthSize);
+
+// Decoder configuration record (avcC or hvcC) found in extradata of length-prefixed streams
+struct DecoderConfig {
+	binary parameterSets; // Annex-B
+	size_t lengthSize = 4;
+};
+
+optional<DecoderConfig> ParseH264Config(const byte *data, size_t size);
+optional<DecoderConfig> ParseH265Config(const byte *data, size_t size);
+
+// Normalizes a pre-encoded H264 or H265 stream for sending: access units are converted to
+// Annex-B if they are length-prefixed, and the last parameter sets are injected before keyframes
+// which lack them so that any keyframe is a valid entry point.
+class AnnexBNormalizer final {
+public:
+	// Extradata is either a decoder configuration record or Annex-B parameter sets
+	AnnexBNormalizer(bool h265, const byte *extradata, size_t extradataSize);
+
+	struct Unit {
+		optional<binary> data; // unset if the access unit can be sent unchanged
+		bool keyframe = false;
+	};
+
+	Unit normalize(const byte *data, size_t size);
+
+	// Last known parameter sets, Annex-B
+	const binary &parameterSets() const { return mParameterSets; }
+
+private:
+	const bool mH265;
+	size_t mLengthSize = 0; // zero for Annex-B input
+	binary mParameterSets;
+};
+
+} // namespace nal
+
+} // namespace rtcast
+
+#endif
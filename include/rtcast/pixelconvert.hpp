@@ -0,0 +1,47 @@
+/**
+ * Copyright (c) 2025 Paul-Louis Ageneau
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef PIXEL_CONVERT_H
+#define PIXEL_CONVERT_H
+
+#include "common.hpp"
+
+extern "C" {
+#include <libavutil/frame.h>
+}
+
+namespace rtcast {
+
+namespace pixel {
+
+// Instruction sets of the conversion kernels, selected at runtime
+enum class Isa {
+	Scalar,
+	Sse41,
+	Avx2,
+	Neon,
+};
+
+Isa BestIsa();
+bool IsSupported(Isa isa);
+const char *IsaName(Isa isa);
+
+// True if there is a kernel to convert frames of this format to I420 of the same size
+// Kernels cover YUYV, NV12, I422, I444, and I420 with their full range (YUVJ) variants.
+bool HasI420Kernel(AVPixelFormat format, int width, int height);
+
+// Converts rows [begin, end) to I420 with a dedicated kernel, rows must be even
+// Full range input is compressed to limited range if the output range is MPEG.
+void ConvertToI420(const AVFrame *input, AVFrame *output, int begin, int end,
+                   Isa isa = BestIsa());
+
+} // namespace pixel
+
+} // namespace rtcast
+
+#endif
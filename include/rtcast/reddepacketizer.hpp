@@ -0,0 +1,73 @@
+/**
+ * Copyright (c) 2025 Paul-Louis Ageneau
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef RED_DEPACKETIZER_H
+#define RED_DEPACKETIZER_H
+
+#include "common.hpp"
+
+#include "rtc/rtc.hpp"
+
+#include <array>
+#include <atomic>
+
+namespace rtcast {
+
+// Media handler splitting incoming RED packets (RFC 2198) into an RTP packet per block, so that
+// the depacketizer sees the plain codec. A redundant block is only forwarded if its frame was
+// not received yet, immediately and without buffering. Frames already forwarded are dropped,
+// but a primary frame arriving late is still forwarded if it was not recovered. Other packets
+// are left untouched. Must be chained after the depacketizer.
+// Forwarded blocks get the sequence number of the carrying packet minus their distance in
+// blocks, which matches the original one unless frames were skipped in between. Only the
+// depacketizer follows, and it relies on timestamps, not sequence numbers.
+class RedDepacketizer final : public rtc::MediaHandler {
+public:
+	// Updated with relaxed atomics on the transport thread
+	struct Counters {
+		std::atomic<uint64_t> packets = 0;    // RED packets
+		std::atomic<uint64_t> recovered = 0;  // frames forwarded from redundant blocks
+		std::atomic<uint64_t> duplicates = 0; // primary frames already forwarded
+		std::atomic<uint64_t> malformed = 0;
+	};
+
+	RedDepacketizer(int payloadType, shared_ptr<Counters> counters = nullptr);
+
+	void incoming(rtc::message_vector &messages, const rtc::message_callback &send) override;
+
+private:
+	struct Block {
+		uint8_t payloadType;
+		uint32_t timestamp;
+		uint16_t sequence;
+		size_t offset;
+		size_t size;
+	};
+
+	static const size_t WindowSize = 32; // forwarded frames remembered, many times MaxDistance
+
+	void split(const rtc::message_ptr &message, rtc::message_vector &result);
+	rtc::message_ptr forward(const rtc::message_ptr &message, size_t headerSize,
+	                         const Block &block);
+	bool isForwarded(uint32_t timestamp) const;
+	bool isOlderThanWindow(uint32_t timestamp) const;
+	void markForwarded(uint32_t timestamp);
+
+	const uint8_t mPayloadType;
+	const shared_ptr<Counters> mCounters;
+
+	// Owned by the transport thread
+	std::array<uint32_t, WindowSize> mForwarded = {}; // timestamps of the last forwarded frames
+	size_t mForwardedCount = 0;
+	size_t mForwardedNext = 0;
+	std::vector<Block> mBlocks;
+};
+
+} // namespace rtcast
+
+#endif
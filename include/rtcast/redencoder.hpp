@@ -0,0 +1,49 @@
+/**
+ * Copyright (c) 2025 Paul-Louis Ageneau
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef RED_ENCODER_H
+#define RED_ENCODER_H
+
+#include "common.hpp"
+#include "encodedframe.hpp"
+
+#include <deque>
+
+namespace rtcast {
+
+// Redundant audio payloads as in RFC 2198, each frame preceded by up to distance previous frames
+// Previous frames too old or too large for the block header fields are left out, as are the
+// oldest ones if the payload would not fit in a packet.
+class RedEncoder final {
+public:
+	static const unsigned int MaxDistance = 8;
+
+	RedEncoder(int payloadType, unsigned int distance); // payload type of the blocks
+
+	unsigned int distance() const { return mDistance; }
+
+	// Not thread-safe, frames must be passed in order
+	shared_ptr<EncodedFrame> encode(shared_ptr<const EncodedFrame> frame);
+	void reset();
+
+	// Copy of a RED payload with its blocks tagged with another payload type, for a receiver
+	// which negotiated the codec under a different one
+	static shared_ptr<EncodedFrame> Relabel(const EncodedFrame &red, int payloadType);
+
+	// Format parameters of the RED payload type, listing the payload type of each block
+	static string Profile(int payloadType, unsigned int distance);
+
+private:
+	const uint8_t mPayloadType;
+	const unsigned int mDistance;
+	std::deque<shared_ptr<const EncodedFrame>> mHistory; // oldest first
+};
+
+} // namespace rtcast
+
+#endif
@@ -8,6 +8,8 @@
 
 // Common
 #include "common.hpp"
+#include "log.hpp"
+#include "latency.hpp"
 
 // Endpoint
 #include "endpoint.hpp"
@@ -17,10 +19,16 @@
 #include "drmvideoencoder.hpp"
 #include "videodevice.hpp"
 #include "videoencoder.hpp"
+#include "videoencodergroup.hpp"
 
 // Audio
+#include "audiocontroller.hpp"
 #include "audiodecoder.hpp"
 #include "audiodevice.hpp"
 #include "audioencoder.hpp"
 #include "audioplayer.hpp"
 #include "audiosink.hpp"
+
+// Synthetic sources
+#include "syntheticdevice.hpp"
+#include "viewer.hpp"
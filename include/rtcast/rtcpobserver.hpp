@@ -0,0 +1,57 @@
+/**
+ * Copyright (c) 2025 Paul-Louis Ageneau
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef RTCP_OBSERVER_H
+#define RTCP_OBSERVER_H
+
+#include "common.hpp"
+
+#include "rtc/rtc.hpp"
+
+#include <chrono>
+
+namespace rtcast {
+
+// Media handler parsing incoming RTCP feedback for a sent stream, messages are left untouched
+// Must be chained last on the track so that it sees RTCP before any depacketizer.
+class RtcpObserver final : public rtc::MediaHandler {
+public:
+	struct ReceiverReport {
+		double fractionLost = 0.; // since the previous report
+		int32_t cumulativeLost = 0;
+		uint32_t highestSequence = 0; // extended
+		uint32_t jitter = 0;          // in RTP timestamp units
+		optional<std::chrono::microseconds> rtt;
+	};
+
+	struct Callbacks {
+		std::function<void(const ReceiverReport &report)> receiverReport;
+		std::function<void()> keyframeRequest; // PLI or FIR
+		std::function<void(unsigned int count)> nack;
+		std::function<void(int64_t bitrate)> remb; // receiver estimated maximum bitrate
+	};
+
+	// Callbacks are invoked on the transport thread and must not block
+	RtcpObserver(uint32_t ssrc, Callbacks callbacks);
+
+	void incoming(rtc::message_vector &messages, const rtc::message_callback &send) override;
+
+private:
+	void parse(const byte *data, size_t size);
+	void parseReportBlocks(const byte *data, size_t size, int count);
+	void parseRemb(const byte *data, size_t size);
+
+	const uint32_t mSsrc;
+	const Callbacks mCallbacks;
+	uint8_t mLastFirSequence = 0;
+	bool mHasFirSequence = false;
+};
+
+} // namespace rtcast
+
+#endif
@@ -0,0 +1,30 @@
+/**
+ * Copyright (c) 2025 Paul-Louis Ageneau
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef SDP_H
+#define SDP_H
+
+#include "common.hpp"
+
+#include "rtc/rtc.hpp"
+
+namespace rtcast {
+
+namespace sdp {
+
+// Payload type of the format in the media if listed, the format is compared case-insensitively
+optional<int> FindPayloadType(const rtc::Description::Media &media, const string &format);
+
+// Format of the first payload type of the media, upper case as in the SDP, empty if none
+string FirstFormat(const rtc::Description::Media &media);
+
+} // namespace sdp
+
+} // namespace rtcast
+
+#endif
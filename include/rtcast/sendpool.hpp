@@ -0,0 +1,97 @@
+/**
+ * Copyright (c) 2025 Paul-Louis Ageneau
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef SEND_POOL_H
+#define SEND_POOL_H
+
+#include "common.hpp"
+#include "encodedframe.hpp"
+#include "framequeue.hpp"
+#include "sharedpacketizer.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <thread>
+
+namespace rtcast {
+
+// Worker pool draining bounded per-client send queues, so that a slow client does not delay
+// the encoder or the other clients. A queue is drained by one worker at a time to keep order.
+class SendPool final : public std::enable_shared_from_this<SendPool> {
+public:
+	explicit SendPool(unsigned int threads);
+	~SendPool();
+
+	SendPool(const SendPool &) = delete;
+	SendPool &operator=(const SendPool &) = delete;
+
+	struct Item {
+		shared_ptr<const EncodedFrame> frame;
+		shared_ptr<const SharedPacketizer::Frame> packets; // if packetized once for all clients
+	};
+
+	using clock = std::chrono::steady_clock;
+	using handler = std::function<void(const Item &item, clock::time_point enqueued)>;
+
+	class Queue final : public std::enable_shared_from_this<Queue> {
+	public:
+		Queue(weak_ptr<SendPool> pool, handler func, size_t capacity, DropPolicy policy);
+
+		using Stats = FrameQueue<Item>::Stats;
+
+		// Returns false if the item was dropped according to the policy or the queue is closed
+		bool push(Item item);
+		void close();
+
+		void setPolicy(DropPolicy policy);
+		void setDeadline(std::chrono::microseconds deadline);
+		DropPolicy policy() const;
+
+		size_t size() const;
+		size_t capacity() const;
+		Stats stats() const;
+
+	private:
+		friend class SendPool;
+
+		void drain(SendPool &pool, size_t maxItems); // called by a worker
+
+		const weak_ptr<SendPool> mPool;
+		const handler mHandler;
+		FrameQueue<Item> mQueue;
+		std::atomic<size_t> mPending = 0; // the queue is scheduled while non-zero
+	};
+
+	shared_ptr<Queue> createQueue(handler func, size_t capacity, DropPolicy policy);
+
+	// Run a task on a worker once the time is reached, for instance to pace sends without
+	// blocking a worker in between. Tasks still pending are discarded on destruction.
+	void post(clock::time_point time, std::function<void()> task);
+
+	unsigned int threadsCount() const;
+
+private:
+	void schedule(shared_ptr<Queue> queue);
+	void run();
+
+	std::vector<std::thread> mThreads;
+	std::mutex mMutex;
+	std::condition_variable mCondition;
+	std::deque<shared_ptr<Queue>> mReady;
+	std::multimap<clock::time_point, std::function<void()>> mTasks;
+	bool mStopping = false;
+};
+
+} // namespace rtcast
+
+#endif
@@ -0,0 +1,73 @@
+/**
+ * Copyright (c) 2025 Paul-Louis Ageneau
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef SHARED_PACKETIZER_H
+#define SHARED_PACKETIZER_H
+
+#include "common.hpp"
+
+#include <chrono>
+
+namespace rtc {
+
+struct Message;
+class RtpPacketizer;
+class RtpPacketizationConfig;
+class Track;
+
+} // namespace rtc
+
+namespace rtcast {
+
+// Packetizes each encoded frame once for all clients, clients then only rewrite the sequence
+// number, timestamp and SSRC of the shared RTP packets before sending them on their track.
+class SharedPacketizer final {
+public:
+	// The packetizer must be built on its own config, which is not used by any track
+	SharedPacketizer(shared_ptr<rtc::RtpPacketizer> packetizer);
+	~SharedPacketizer();
+
+	// Immutable once returned, shared by all sessions
+	struct Frame {
+		std::vector<shared_ptr<rtc::Message>> packets;
+		uint32_t timestamp = 0; // RTP timestamp of the shared packets
+	};
+
+	// Not thread-safe, must be called from a single thread
+	shared_ptr<const Frame> packetize(const byte *data, size_t size,
+	                                  std::chrono::microseconds timestamp);
+
+	// Per-client RTP state, the config is shared with the track's RtcpSrReporter
+	class Session final {
+	public:
+		Session(shared_ptr<rtc::RtpPacketizationConfig> config, uint32_t sourceStartTimestamp);
+
+		// Returns the number of packets sent, throws if the track is closed
+		// The shift in RTP timestamp units moves the frame forward, for instance when priming
+		size_t send(const Frame &frame, rtc::Track &track, uint32_t timestampShift = 0);
+
+		// Same as above with the rewritten packets passed to a sink instead of a track
+		using sink = std::function<void(binary packet)>;
+		size_t send(const Frame &frame, const sink &func, uint32_t timestampShift = 0);
+
+	private:
+		const shared_ptr<rtc::RtpPacketizationConfig> mConfig;
+		const uint32_t mTimestampOffset;
+	};
+
+	shared_ptr<Session> createSession(shared_ptr<rtc::RtpPacketizationConfig> config) const;
+
+	uint32_t startTimestamp() const;
+
+private:
+	const shared_ptr<rtc::RtpPacketizer> mPacketizer;
+};
+
+} // namespace rtcast
+
+#endif
@@ -0,0 +1,160 @@
+/**
+ * Copyright (c) 2025 Paul-Louis Ageneau
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef SYNTHETIC_DEVICE_H
+#define SYNTHETIC_DEVICE_H
+
+#include "audioencoder.hpp"
+#include "common.hpp"
+#include "videoencoder.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+namespace rtcast {
+
+// Source generating frames without hardware, for load tests and benchmarks
+// Frames are written to a ring of buffers lent to the encoder through the zero-copy input path
+// and returned by its finished callback. In real time, a frame is skipped if no buffer is free
+// at its due time, otherwise the device waits for the encoder to return a buffer.
+class SyntheticDevice {
+public:
+	virtual ~SyntheticDevice();
+
+	void start();
+	void stop();
+
+	// Blocks until the configured number of frames has been produced or the device is stopped
+	void wait();
+	bool running() const { return mRunning; }
+
+	struct Stats {
+		uint64_t frames = 0; // pushed to the encoder
+		uint64_t stalls = 0; // skipped in real time because all buffers were in use
+	};
+
+	Stats stats() const;
+
+protected:
+	struct Pacing {
+		std::chrono::microseconds period;
+		bool realtime = true;
+		uint64_t maxFrames = 0; // 0 for unlimited
+		size_t buffersCount = 4;
+	};
+
+	SyntheticDevice(Pacing pacing, size_t bufferSize);
+
+	virtual void startEncoder() = 0;
+	virtual void stopEncoder() = 0;
+
+	// Writes frame number index to buffer number slot and pushes it, finished must be called
+	// exactly once when the buffer is not used anymore
+	virtual void produce(uint64_t index, size_t slot, byte *buffer,
+	                     std::function<void()> finished) = 0;
+
+private:
+	struct Buffers {
+		std::mutex mutex;
+		std::condition_variable condition;
+		std::vector<binary> data;
+		std::vector<bool> inUse;
+	};
+
+	optional<size_t> acquire(bool wait);
+	void run();
+
+	const Pacing mPacing;
+	const shared_ptr<Buffers> mBuffers; // shared with pending finished callbacks
+
+	std::thread mThread;
+	std::atomic<bool> mRunning = false;
+	std::atomic<bool> mEncoderStarted = false;
+	std::atomic<uint64_t> mFrames = 0;
+	std::atomic<uint64_t> mStalls = 0;
+};
+
+class SyntheticVideoDevice final : public SyntheticDevice {
+public:
+	enum class Motion {
+		Static,    // Fixed pattern, the cheapest to encode
+		Scrolling, // Pattern moving horizontally, exercises motion estimation
+		Noise,     // Random samples, the worst case for the encoder
+	};
+
+	struct Settings {
+		static Settings Default() { return {}; }
+		int width = 1280;
+		int height = 720;
+		int framerate = 30;
+		AVPixelFormat pixelFormat = AV_PIX_FMT_YUV420P; // or NV12, YUYV422, YUV422P, YUV444P
+		Motion motion = Motion::Scrolling;
+		bool realtime = true; // otherwise as fast as the encoder returns buffers
+		uint64_t maxFrames = 0;
+		size_t buffersCount = 4;
+	};
+
+	SyntheticVideoDevice(shared_ptr<VideoEncoder> encoder, Settings settings = Settings::Default());
+	~SyntheticVideoDevice();
+
+private:
+	void startEncoder() override;
+	void stopEncoder() override;
+	void produce(uint64_t index, size_t slot, byte *buffer,
+	             std::function<void()> finished) override;
+	void draw(uint64_t index, uint8_t *buffer);
+
+	shared_ptr<VideoEncoder> mEncoder;
+	const Settings mSettings;
+	int mLinesize[4] = {};
+	std::vector<bool> mDrawn; // per buffer, static content is only drawn once
+};
+
+class SyntheticAudioDevice final : public SyntheticDevice {
+public:
+	enum class Signal {
+		Tone,
+		Noise,
+		Silence,
+	};
+
+	// Samples are interleaved 16-bit at the encoder sample rate and channel count
+	struct Settings {
+		static Settings Default() { return {}; }
+		Signal signal = Signal::Tone;
+		double frequency = 440.;
+		double amplitude = 0.5; // relative to full scale
+		int frameSize = 960;    // samples per channel for each push
+		bool realtime = true;
+		uint64_t maxFrames = 0;
+		size_t buffersCount = 4;
+	};
+
+	SyntheticAudioDevice(shared_ptr<AudioEncoder> encoder, Settings settings = Settings::Default());
+	~SyntheticAudioDevice();
+
+private:
+	void startEncoder() override;
+	void stopEncoder() override;
+	void produce(uint64_t index, size_t slot, byte *buffer,
+	             std::function<void()> finished) override;
+
+	shared_ptr<AudioEncoder> mEncoder;
+	const Settings mSettings;
+	const int mSampleRate;
+	const int mChannels;
+	double mPhase = 0.;
+	uint32_t mNoiseState = 0x9E3779B9;
+};
+
+} // namespace rtcast
+
+#endif
@@ -10,6 +10,7 @@
 #define VIDEO_DEVICE_H
 
 #include "common.hpp"
+#include "nal.hpp"
 #include "videoencoder.hpp"
 
 extern "C" {
@@ -29,6 +30,11 @@ public:
 		int width = 0;
 		int height = 0;
 		int framerate = 0;
+		string inputFormat; // format requested from the device, like "h264" or "mjpeg"
+
+		// Forward H264 or H265 input without transcoding if it matches the encoder codec and the
+		// offered profile, and has no frame reordering. Otherwise it is transcoded.
+		bool passthrough = true;
 	};
 
 	VideoDevice(string deviceName, shared_ptr<VideoEncoder> encoder,
@@ -38,8 +44,13 @@ public:
 	void start();
 	void stop();
 
+	bool passthrough() const { return mPassthrough; }
+
 private:
 	void run();
+	void startTranscoding();
+	bool forward(const AVPacket *packet); // false if the packet must be transcoded instead
+	optional<bool> isForwardable(const byte *data, size_t size) const;
 
 	shared_ptr<VideoEncoder> mEncoder;
 	Settings mSettings;
@@ -51,6 +62,14 @@ private:
 	AVStream *mInputStream;
 	const AVCodec *mInputCodec;
 	unique_ptr_deleter<AVCodecContext> mInputCodecContext;
+
+	shared_ptr<FramePool> mFramePool = FramePool::Create();
+
+	std::atomic<bool> mPassthrough = false;
+	bool mProfileChecked = false; // owned by the capture thread, like the fields below
+	unique_ptr<nal::AnnexBNormalizer> mNormalizer;
+	std::chrono::microseconds mFrameInterval;
+	optional<std::chrono::microseconds> mLastTimestamp;
 };
 
 } // namespace rtcast
@@ -9,15 +9,17 @@
 #ifndef VIDEO_ENCODER_H
 #define VIDEO_ENCODER_H
 
+#include "dmabufcache.hpp"
 #include "encoder.hpp"
 #include "endpoint.hpp"
+#include "frameconverter.hpp"
 
 extern "C" {
 #include <libavutil/imgutils.h>
-#include <libswscale/swscale.h>
 }
 
 #include <chrono>
+#include <thread>
 
 namespace rtcast {
 
@@ -26,10 +28,10 @@ public:
 	VideoEncoder(string codecName, shared_ptr<Endpoint> endpoint);
 	virtual ~VideoEncoder();
 
-	void setSize(int width, int height);
-	void setFramerate(AVRational framerate);
+	virtual void setSize(int width, int height);
+	virtual void setFramerate(AVRational framerate);
 	void setFramerate(int framerate);
-	void setGopSize(int gopsize);
+	virtual void setGopSize(int gopsize);
 
 	struct ColorSettings {
 		AVColorPrimaries primaries = AVCOL_PRI_BT709;
@@ -38,7 +40,16 @@ public:
 		AVColorRange range = AVCOL_RANGE_JPEG;
 	};
 
-	void setColorSettings(ColorSettings settings);
+	virtual void setColorSettings(ColorSettings settings);
+
+	// Pixel format conversion and scaling run on the capture thread by default. With a positive
+	// number of threads, frames are handed over to a conversion stage which splits the work
+	// across the threads. Must be called before start().
+	virtual void setConversionThreads(unsigned int threads);
+
+	// Renditions other than the encoder's own are ignored
+	using Encoder::requestKeyframe;
+	virtual void requestKeyframe(unsigned int rendition);
 
 	using finished_callback_t = std::function<void()>;
 
@@ -61,16 +72,50 @@ public:
 	virtual void push(shared_ptr<AVFrame> frame) override;
 	virtual void push(InputFrame input);
 
+	// Planes passed by file descriptor are mapped once and the mappings are cached, the mapping
+	// of a buffer must be released when the device frees it
+	void releaseMapping(int fd);
+	DmaBufCache::Stats mappingStats() const;
+
+	// Sends a frame already encoded with the encoder codec, bypassing the encoder entirely
+	// Keyframe requests cannot be honored, joining clients rely on the GOP cache instead. Frames
+	// must be in decoding order without reordering and conform to the offered profile, see
+	// nal::IsH264ConstrainedBaseline() and nal::IsH265Main().
+	void pushEncoded(shared_ptr<EncodedFrame> frame);
+
+	void start() override;
+	void stop() override;
+
 protected:
+	// Encoder for a lower rendition of a group, which does not set up the endpoint
+	VideoEncoder(string codecName, shared_ptr<Endpoint> endpoint, unsigned int rendition);
+
+	// Input is discarded while inactive, by default when the endpoint has no clients
+	virtual bool active() const;
+
+	// Converts and enqueues the frame, on the conversion stage if enabled
+	virtual void process(shared_ptr<AVFrame> frame, clock::time_point origin);
+
+	// Converts the frame to the encoder size and pixel format, may return the frame itself
+	shared_ptr<AVFrame> convert(shared_ptr<AVFrame> frame);
+
 	void output(AVPacket *packet) override;
 
 	shared_ptr<Endpoint> mEndpoint;
+	const unsigned int mRendition;
+
+	bool mConversionStage = true; // false if frames are fed to convert() directly
 
 private:
-	unique_ptr_deleter<SwsContext> mSwsContext;
-	int mSwsInputWidth;
-	int mSwsInputHeight;
-	AVPixelFormat mSwsInputPixelFormat;
+	void runConversion();
+
+	std::atomic<unsigned int> mConversionThreads = 0;
+	unique_ptr<FrameConverter> mConverter; // owned by the converting thread
+
+	FrameQueue<QueuedFrame> mConversionQueue;
+	std::thread mConversionThread;
+
+	DmaBufCache mMappings;
 };
 
 } // namespace rtcast
@@ -0,0 +1,65 @@
+/**
+ * Copyright (c) 2025 Paul-Louis Ageneau
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef VIDEO_ENCODER_GROUP_H
+#define VIDEO_ENCODER_GROUP_H
+
+#include "videoencoder.hpp"
+
+namespace rtcast {
+
+// Rendition ladder encoding a single capture, for instance 1080p, 720p, and 360p. The group is
+// itself the first and largest rendition, so that it replaces a VideoEncoder for a device. Each
+// lower rendition is scaled from the next larger one and encoded on its own thread.
+class VideoEncoderGroup final : public VideoEncoder {
+public:
+	struct Rendition {
+		int width;
+		int height;
+		int64_t bitrate;
+	};
+
+	// Renditions must be ordered by strictly decreasing size
+	VideoEncoderGroup(string codecName, shared_ptr<Endpoint> endpoint,
+	                  std::vector<Rendition> renditions);
+	~VideoEncoderGroup();
+
+	unsigned int renditionsCount() const;
+	const Rendition &rendition(unsigned int index) const;
+
+	// For Endpoint::onRenditionBitrate(), capped to the nominal bitrate of the rendition
+	void setRenditionBitrate(unsigned int rendition, int64_t bitrate);
+
+	Stats renditionStats(unsigned int rendition) const;
+
+	// The size is set by the renditions, the capture size is only used as input
+	void setSize(int width, int height) override;
+	using VideoEncoder::setFramerate;
+	void setFramerate(AVRational framerate) override;
+	void setGopSize(int gopsize) override;
+	void setColorSettings(ColorSettings settings) override;
+	void setConversionThreads(unsigned int threads) override;
+	using VideoEncoder::requestKeyframe;
+	void requestKeyframe(unsigned int rendition) override;
+
+	void start() override;
+	void stop() override;
+
+protected:
+	void process(shared_ptr<AVFrame> frame, clock::time_point origin) override;
+
+private:
+	class Lower;
+
+	const std::vector<Rendition> mRenditions;
+	std::vector<unique_ptr<Lower>> mLowers; // renditions after the first one
+};
+
+} // namespace rtcast
+
+#endif
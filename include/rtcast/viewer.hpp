@@ -0,0 +1,112 @@
+/**
+ * Copyright (c) 2025 Paul-Louis Ageneau
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef VIEWER_H
+#define VIEWER_H
+
+#include "common.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+
+namespace rtc {
+
+class WebSocket;
+class PeerConnection;
+class DataChannel;
+class Track;
+
+} // namespace rtc
+
+namespace rtcast {
+
+// Headless client following the signaling flow of client.js against an Endpoint, for load
+// tests. Received tracks are depacketized and measured but not decoded. Must be owned by a
+// shared_ptr since callbacks only keep a weak reference.
+class Viewer final : public std::enable_shared_from_this<Viewer> {
+public:
+	struct Settings {
+		static Settings Default() { return {}; }
+		string url = "ws://127.0.0.1:8888/";
+		std::vector<string> iceServers; // host candidates only if empty
+		optional<string> bindAddress;
+	};
+
+	Viewer(Settings settings = Settings::Default());
+	~Viewer();
+
+	Viewer(const Viewer &) = delete;
+	Viewer &operator=(const Viewer &) = delete;
+
+	void open();
+	void close();
+
+	bool isConnected() const;
+	bool hasFailed() const;
+
+	using clock = std::chrono::steady_clock;
+
+	struct TrackStats {
+		uint64_t frames = 0; // depacketized
+		uint64_t packets = 0;
+		uint64_t bytes = 0;
+		uint64_t lost = 0; // from sequence number gaps, retransmissions fill them
+		double framerate = 0.; // between the first and the last frame
+		std::chrono::microseconds jitter = {}; // interarrival jitter as in RFC 3550
+		optional<std::chrono::microseconds> timeToFirstFrame; // since open()
+	};
+
+	struct Stats {
+		optional<std::chrono::microseconds> timeToConnected; // since open()
+		TrackStats video;
+		TrackStats audio;
+	};
+
+	Stats stats() const;
+
+private:
+	// Counters updated on the transport thread with relaxed atomics
+	struct Counters {
+		std::atomic<uint64_t> frames = 0;
+		std::atomic<uint64_t> packets = 0;
+		std::atomic<uint64_t> bytes = 0;
+		std::atomic<uint64_t> expected = 0; // from the extended sequence number range
+		std::atomic<int64_t> firstFrameUs = -1;
+		std::atomic<int64_t> lastFrameUs = -1;
+		std::atomic<double> jitterUs = 0.;
+	};
+
+	class StatsObserver; // media handler filling the counters from incoming RTP
+
+	static TrackStats Collect(const Counters &counters, clock::time_point openedAt);
+
+	void handleMessage(const string &message);
+	void setupTrack(shared_ptr<rtc::Track> track);
+
+	const Settings mSettings;
+
+	shared_ptr<rtc::WebSocket> mWebSocket;
+	shared_ptr<rtc::PeerConnection> mPeerConnection;
+
+	std::mutex mMutex; // protects the channel and the tracks
+	shared_ptr<rtc::DataChannel> mDataChannel;
+	std::vector<shared_ptr<rtc::Track>> mTracks;
+
+	clock::time_point mOpenedAt;
+	std::atomic<int64_t> mConnectedUs = -1; // since open()
+	std::atomic<bool> mConnected = false;
+	std::atomic<bool> mFailed = false;
+
+	const shared_ptr<Counters> mVideoCounters;
+	const shared_ptr<Counters> mAudioCounters;
+};
+
+} // namespace rtcast
+
+#endif
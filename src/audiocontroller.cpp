@@ -0,0 +1,110 @@
+/**
+ * Copyright (c) 2025 Paul-Louis Ageneau
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+#include "audiocontroller.hpp"
+#include "log.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace rtcast {
+
+namespace {
+
+const double LossTimeConstant = 2.8;   // seconds, a weight of 0.3 for reports 1s apart
+const double FirstReportInterval = 1.; // seconds, assumed for the first report
+const int PacketLossStep = 5;          // expected loss percentage granularity
+const double BitrateLossFactor = 2.;   // relative bitrate decrease per fraction lost
+const double BitrateHysteresis = 0.1;
+
+} // namespace
+
+AudioController::AudioController(shared_ptr<AudioEncoder> encoder, Settings settings)
+    : mEncoder(std::move(encoder)), mSettings(std::move(settings)) {
+	if (mSettings.minBitrate <= 0 || mSettings.maxBitrate < mSettings.minBitrate)
+		throw std::invalid_argument("Invalid bitrate range");
+
+	mOptions.bitrate = mSettings.maxBitrate;
+	mOptions.dtx = mSettings.dtx;
+	mEncoder->setOpusOptions(mOptions);
+}
+
+void AudioController::onLoss(double fractionLost, clock::time_point now) {
+	std::lock_guard lock(mMutex);
+	++mReports;
+
+	// Weighted by the time since the previous report, so that the reports of many clients,
+	// each carrying the worst loss, do not shorten the smoothing
+	double elapsed = mLastReport ? std::chrono::duration<double>(now - *mLastReport).count()
+	                             : FirstReportInterval;
+	double weight = 1. - std::exp(-std::max(elapsed, 0.) / LossTimeConstant);
+	mLastReport = now;
+	mFractionLost += weight * (std::clamp(fractionLost, 0., 1.) - mFractionLost);
+
+	auto options = target(mFractionLost);
+	if (!differs(options))
+		return;
+
+	// A loss burst enables FEC immediately, other changes wait for the interval
+	bool urgent = options.fec && !mOptions.fec;
+	if (!urgent && mLastChange && now - *mLastChange < mSettings.minInterval)
+		return;
+
+	RTCAST_LOG_DEBUG << "Audio adaptation: loss=" << mFractionLost << ", fec=" << options.fec
+	                 << ", packet_loss=" << options.packetLoss
+	                 << ", bitrate=" << options.bitrate.value_or(0);
+
+	mOptions = options;
+	mLastChange = now;
+	++mChanges;
+	mEncoder->setOpusOptions(std::move(options));
+}
+
+AudioController::Stats AudioController::stats() const {
+	std::lock_guard lock(mMutex);
+	Stats stats;
+	stats.fractionLost = mFractionLost;
+	stats.options = mOptions;
+	stats.reports = mReports;
+	stats.changes = mChanges;
+	return stats;
+}
+
+AudioEncoder::OpusOptions AudioController::target(double fractionLost) const {
+	AudioEncoder::OpusOptions options;
+	options.dtx = mSettings.dtx;
+
+	// Hysteresis so that FEC does not flap around the threshold
+	double threshold = mOptions.fec ? mSettings.fecThreshold / 2. : mSettings.fecThreshold;
+	options.fec = fractionLost >= threshold;
+
+	// libopus sizes the FEC from the expected loss, rounded up to steps
+	if (options.fec) {
+		int steps = int(std::ceil(fractionLost * 100. / double(PacketLossStep)));
+		options.packetLoss = std::clamp(steps * PacketLossStep, PacketLossStep, 100);
+	}
+
+	// Audio loss mostly signals congestion on the path
+	double scale = 1. - std::min(BitrateLossFactor * fractionLost, 1.);
+	options.bitrate = std::clamp(int64_t(double(mSettings.maxBitrate) * scale),
+	                             mSettings.minBitrate, mSettings.maxBitrate);
+	return options;
+}
+
+bool AudioController::differs(const AudioEncoder::OpusOptions &options) const {
+	if (options.fec != mOptions.fec || options.packetLoss != mOptions.packetLoss ||
+	    options.dtx != mOptions.dtx)
+		return true;
+
+	int64_t current = mOptions.bitrate.value_or(0);
+	int64_t bitrate = options.bitrate.value_or(0);
+	return std::abs(bitrate - current) >= int64_t(double(current) * BitrateHysteresis);
+}
+
+} // namespace rtcast
@@ -7,8 +7,9 @@
  */
 
 #include "audiodevice.hpp"
+#include "log.hpp"
 
-#include <iostream>
+#include <chrono>
 #include <stdexcept>
 
 namespace rtcast {
@@ -88,11 +89,9 @@ void AudioDevice::stop() {
 }
 
 void AudioDevice::run() {
-	std::cout << "Starting loop" << std::endl;
+	RTCAST_LOG_DEBUG << "Starting audio capture loop";
 
-	auto frame = shared_ptr<AVFrame>(av_frame_alloc(), [](AVFrame *p) { av_frame_free(&p); });
-	if (!frame)
-		throw std::runtime_error("Failed to allocate frame");
+	auto frame = mFramePool->getEmpty();
 
 	auto packet = shared_ptr<AVPacket>(av_packet_alloc(), [](AVPacket *p) { av_packet_free(&p); });
 	if (!packet)
@@ -103,15 +102,17 @@ void AudioDevice::run() {
 		if (ret < 0)
 			throw std::runtime_error("Failed to read frame");
 
+		// Measures input decoding only
+		auto received = std::chrono::steady_clock::now();
 		avcodec_send_packet(mInputCodecContext.get(), packet.get());
 		av_packet_unref(packet.get());
 
 		while ((ret = avcodec_receive_frame(mInputCodecContext.get(), frame.get())) == 0) {
+			mEncoder->recordLatency(PipelineStage::Capture,
+			                        std::chrono::duration_cast<std::chrono::microseconds>(
+			                            std::chrono::steady_clock::now() - received));
 			mEncoder->push(std::move(frame));
-
-			frame = shared_ptr<AVFrame>(av_frame_alloc(), [](AVFrame *p) { av_frame_free(&p); });
-			if (!frame)
-				throw std::runtime_error("Failed to allocate frame");
+			frame = mFramePool->getEmpty();
 		}
 	}
 }
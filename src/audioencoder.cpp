@@ -7,24 +7,62 @@
  */
 
 #include "audioencoder.hpp"
+#include "log.hpp"
 
-#include <iostream>
+#include <algorithm>
 #include <stdexcept>
+#include <utility>
 
 namespace rtcast {
 
-const int DefaultFrameSizeMs = 20;
-
-extern "C" {
-
-static void free_buffer_shared_ptr(void *opaque, [[maybe_unused]] uint8_t *data) {
-	auto ptr = reinterpret_cast<shared_ptr<void> *>(opaque);
-	delete ptr;
-}
+const auto DefaultFrameDuration = std::chrono::microseconds(20000);
+const auto LowDelayFrameDuration = std::chrono::microseconds(10000); // minimum for Opus SILK
+const int64_t OpusFrameDurationsUs[] = {2500, 5000, 10000, 20000, 40000, 60000};
+const int RingDurationMs = 1000;
+const int UnderrunFrames = 2; // read timeout in frame durations before signalling an underrun
+const int MaxDtxPacketSize = 2;  // libopus frames which do not need to be transmitted
+const int OpusClockRate = 48000;
+
+namespace {
+
+// Samples at 48 kHz an Opus packet decodes to, from its TOC byte (RFC 6716 3.1), 0 if invalid
+int opus_packet_samples(const uint8_t *data, int size) {
+	if (size < 1)
+		return 0;
+
+	// Frame duration in units of 2.5 ms per configuration: SILK, hybrid, then CELT
+	static const int SilkUnits[] = {4, 8, 16, 24}; // 10, 20, 40 and 60 ms
+	const int config = data[0] >> 3;
+	int units;
+	if (config < 12)
+		units = SilkUnits[config & 0x03];
+	else if (config < 16)
+		units = config & 0x01 ? 8 : 4;
+	else
+		units = 1 << (config & 0x03);
+
+	int frames;
+	switch (data[0] & 0x03) {
+	case 0:
+		frames = 1;
+		break;
+	case 3:
+		if (size < 2)
+			return 0;
+		frames = data[1] & 0x3F;
+		break;
+	default:
+		frames = 2;
+		break;
+	}
+	return frames * units * OpusClockRate / 400;
 }
 
+} // namespace
+
 AudioEncoder::AudioEncoder(string codecName, shared_ptr<Endpoint> endpoint)
-    : Encoder(std::move(codecName)), mEndpoint(std::move(endpoint)) {
+    : Encoder(std::move(codecName)), mEndpoint(std::move(endpoint)),
+      mFrameDuration(DefaultFrameDuration) {
 
 	av_opt_set(mCodecContext->priv_data, "preset", "ultrafast", 0);
 	av_opt_set(mCodecContext->priv_data, "tune", "zerolatency", 0);
@@ -63,10 +101,14 @@ AudioEncoder::AudioEncoder(string codecName, shared_ptr<Endpoint> endpoint)
 
 	mEndpoint->setAudio(endpointCodec);
 
-	mAudioFifo = unique_ptr_deleter<AVAudioFifo>(
-	    av_audio_fifo_alloc(mCodecContext->sample_fmt, mCodecContext->ch_layout.nb_channels,
-	                        mCodecContext->sample_rate),
-	    av_audio_fifo_free);
+	// The ring holds interleaved samples so that codec frames are sliced with a single copy
+	if (av_sample_fmt_is_planar(mCodecContext->sample_fmt))
+		throw std::logic_error("Planar audio codec sample formats are not supported");
+
+	const size_t sampleSize = size_t(av_get_bytes_per_sample(mCodecContext->sample_fmt)) *
+	                          size_t(mCodecContext->ch_layout.nb_channels);
+	mRing = std::make_unique<AudioRing>(
+	    size_t(mCodecContext->sample_rate) * RingDurationMs / 1000, sampleSize);
 }
 
 AudioEncoder::~AudioEncoder() { stop(); }
@@ -75,87 +117,76 @@ int AudioEncoder::sampleRate() const { return mCodecContext->sample_rate; }
 
 int AudioEncoder::channelsCount() const { return mCodecContext->ch_layout.nb_channels; }
 
-void AudioEncoder::push(shared_ptr<AVFrame> frame) {
-	if (mEndpoint->clientsCount() == 0)
-		return; // no clients, no need to encode
+void AudioEncoder::setFrameDuration(std::chrono::microseconds duration) {
+	if (isRunning())
+		throw std::logic_error("Audio frame duration must be set before starting the encoder");
+
+	const int64_t samples = int64_t(mCodecContext->sample_rate) * duration.count();
+	if (duration.count() <= 0 || samples % 1000000 != 0)
+		throw std::invalid_argument("Audio frame duration must be a whole number of samples");
+
+	switch (mCodec->id) {
+	case AV_CODEC_ID_OPUS: {
+		// Applied to the codec on start
+		auto end = std::end(OpusFrameDurationsUs);
+		if (std::find(std::begin(OpusFrameDurationsUs), end, duration.count()) == end)
+			throw std::invalid_argument("Unsupported Opus frame duration");
 
-	auto frameSampleFormat = static_cast<AVSampleFormat>(frame->format);
-	if (!mSwrContext || mSwrInputSampleFormat != frameSampleFormat ||
-	    mSwrInputNbChannels != frame->ch_layout.nb_channels ||
-	    mSwrInputSampleRate != frame->sample_rate) {
-		SwrContext *swrContext = nullptr;
-		if (swr_alloc_set_opts2(&swrContext, &mCodecContext->ch_layout, mCodecContext->sample_fmt,
-		                        mCodecContext->sample_rate, &frame->ch_layout, frameSampleFormat,
-		                        frame->sample_rate, 0, nullptr) < 0)
-			throw std::runtime_error("Failed to set up SWR context");
-
-		mSwrContext =
-		    unique_ptr_deleter<SwrContext>(swrContext, [](SwrContext *p) { swr_free(&p); });
-
-		if (swr_init(mSwrContext.get()) < 0)
-			throw std::runtime_error("Failed to initialize SWR context");
-
-		mSwrInputSampleFormat = frameSampleFormat;
-		mSwrInputNbChannels = frame->ch_layout.nb_channels;
-		mSwrInputSampleRate = frame->sample_rate;
+		break;
+	}
+	case AV_CODEC_ID_AAC:
+		throw std::logic_error("AAC frame duration is fixed");
+	default:
+		break; // PCM is sliced to any size
 	}
 
-	int out_samples = swr_get_out_samples(mSwrContext.get(), frame->nb_samples);
-	uint8_t **samples = nullptr;
-	int ret =
-	    av_samples_alloc_array_and_samples(&samples, NULL, mCodecContext->ch_layout.nb_channels,
-	                                       out_samples, mCodecContext->sample_fmt, 0);
-	if (ret < 0)
-		throw std::runtime_error("Failed to allocate samples array");
-
-	try {
-		auto in = const_cast<const uint8_t **>(static_cast<uint8_t **>(frame->extended_data));
-		int nb_samples = swr_convert(mSwrContext.get(), samples, out_samples, in, frame->nb_samples);
-		if (nb_samples < 0)
-			throw std::runtime_error("Audio samples conversion failed");
+	mFrameDuration = duration;
+	mEndpoint->setAudioFrameDuration(duration);
+}
 
-		if (av_audio_fifo_space(mAudioFifo.get()) < nb_samples)
-			throw std::runtime_error("Audio FIFO buffer is too small");
+std::chrono::microseconds AudioEncoder::frameDuration() const { return mFrameDuration; }
 
-		ret = av_audio_fifo_write(mAudioFifo.get(), reinterpret_cast<void **>(samples), nb_samples);
-		if (ret < 0)
-			throw std::runtime_error("Failed to write samples to audio FIFO buffer");
+void AudioEncoder::setOpusOptions(OpusOptions options) {
+	if (mCodec->id != AV_CODEC_ID_OPUS)
+		throw std::logic_error("Opus options set on a " + codecName() + " encoder");
 
-	} catch (...) {
-		av_freep(samples);
-		throw;
-	}
+	if (options.packetLoss < 0 || options.packetLoss > 100)
+		throw std::invalid_argument("Invalid expected packet loss percentage");
 
-	// If the codec is variable frame size, use the default one
-	int frame_size = mCodecContext->frame_size > 0
-	                     ? mCodecContext->frame_size
-	                     : mCodecContext->sample_rate * DefaultFrameSizeMs / 1000;
-
-	while (av_audio_fifo_size(mAudioFifo.get()) >= frame_size) {
-		auto frame = shared_ptr<AVFrame>(av_frame_alloc(), [](AVFrame *p) { av_frame_free(&p); });
-		frame->format = mCodecContext->sample_fmt;
-		frame->ch_layout = mCodecContext->ch_layout;
-		frame->sample_rate = mCodecContext->sample_rate;
-		frame->nb_samples = frame_size;
-		frame->time_base = AVRational{1, mCodecContext->sample_rate};
-		frame->pts = mSamplesCount;
-		mSamplesCount += frame_size;
-
-		ret = av_frame_get_buffer(frame.get(), 0);
-		if (ret < 0)
-			throw std::runtime_error("Failed to allocate buffer for frame");
-
-		ret = av_audio_fifo_read(mAudioFifo.get(), reinterpret_cast<void **>(frame->data),
-		                         frame_size);
-		if (ret < 0)
-			throw std::runtime_error("Failed to read samples from audio FIFO buffer");
-
-		Encoder::push(std::move(frame));
-	}
+	std::lock_guard lock(mOpusOptionsMutex);
+	mOpusOptions = std::move(options);
+	mOpusOptionsChanged = true;
+}
+
+AudioEncoder::OpusOptions AudioEncoder::opusOptions() const {
+	std::lock_guard lock(mOpusOptionsMutex);
+	return mOpusOptions;
+}
+
+AudioEncoder::OutputStats AudioEncoder::outputStats() const {
+	OutputStats stats;
+	stats.frames = mOutputCounters.frames.load(std::memory_order_relaxed);
+	stats.bytes = mOutputCounters.bytes.load(std::memory_order_relaxed);
+	stats.fecFrames = mOutputCounters.fecFrames.load(std::memory_order_relaxed);
+	stats.fecBytes = mOutputCounters.fecBytes.load(std::memory_order_relaxed);
+	stats.dtxFrames = mOutputCounters.dtxFrames.load(std::memory_order_relaxed);
+	stats.reopens = mOutputCounters.reopens.load(std::memory_order_relaxed);
+	stats.paddingSamples = mOutputCounters.paddingSamples.load(std::memory_order_relaxed);
+	return stats;
+}
+
+bool AudioEncoder::active() const { return mEndpoint->clientsCount() > 0; }
+
+void AudioEncoder::push(shared_ptr<AVFrame> frame) {
+	if (!active())
+		return; // no clients, no need to encode
+
+	write(frame->extended_data, frame->ch_layout, static_cast<AVSampleFormat>(frame->format),
+	      frame->sample_rate, frame->nb_samples, clock::now());
 }
 
 void AudioEncoder::push(InputFrame input) {
-	if (mEndpoint->clientsCount() == 0) {
+	if (!active()) {
 		// no clients, no need to encode
 		if (input.finished)
 			input.finished();
@@ -163,40 +194,286 @@ void AudioEncoder::push(InputFrame input) {
 		return;
 	}
 
-	auto frame = shared_ptr<AVFrame>(av_frame_alloc(), [](AVFrame *p) { av_frame_free(&p); });
-	if (!frame)
-		throw std::runtime_error("Failed to allocate AVFrame");
+	auto origin = clock::now();
 
-	frame->pts = 0; // ignored
-	frame->format = input.format;
-	frame->sample_rate = input.sampleRate;
-	frame->nb_samples = input.nbSamples;
-	av_channel_layout_default(&frame->ch_layout, input.nbChannels);
-
-	struct FinishedWrapper {
-		std::function<void()> finished;
-		~FinishedWrapper() {
+	struct FinishedGuard {
+		finished_callback_t &finished;
+		~FinishedGuard() {
 			if (finished)
 				finished();
 		}
 	};
-	auto finishedWrapper = std::make_shared<FinishedWrapper>();
+	FinishedGuard guard{input.finished}; // samples are consumed before returning
+
+	int size = av_samples_get_buffer_size(nullptr, input.nbChannels, input.nbSamples,
+	                                      input.format, 1);
+	if (size < 0 || size_t(size) > input.size)
+		throw std::invalid_argument("Invalid audio input frame");
+
+	// Plane pointers into the caller's buffer, only reallocated if the channel count grows
+	if (mInputPlanes.size() < size_t(input.nbChannels))
+		mInputPlanes.resize(size_t(input.nbChannels));
 
-	frame->buf[0] =
-	    av_buffer_create(reinterpret_cast<uint8_t *>(input.data), input.size,
-	                     free_buffer_shared_ptr, new shared_ptr<void>(finishedWrapper), 0);
-	if (!frame->buf[0])
-		throw std::runtime_error("Failed to create AVBuffer");
+	if (av_samples_fill_arrays(mInputPlanes.data(), nullptr,
+	                           reinterpret_cast<const uint8_t *>(input.data), input.nbChannels,
+	                           input.nbSamples, input.format, 1) < 0)
+		throw std::runtime_error("Failed to set up audio input planes");
 
-	frame->data[0] = frame->buf[0]->data;
+	AVChannelLayout layout;
+	av_channel_layout_default(&layout, input.nbChannels);
+	write(mInputPlanes.data(), layout, input.format, input.sampleRate, input.nbSamples, origin);
+}
+
+void AudioEncoder::write(const uint8_t *const *data, const AVChannelLayout &layout,
+                         AVSampleFormat sampleFormat, int sampleRate, int nbSamples,
+                         clock::time_point origin) {
+	if (sampleFormat == mCodecContext->sample_fmt && sampleRate == mCodecContext->sample_rate &&
+	    layout.nb_channels == mCodecContext->ch_layout.nb_channels) {
+		// Already in the codec format, bypass the resampler
+		mSwrContext.reset();
+		mRing->write(reinterpret_cast<const byte *>(data[0]), size_t(nbSamples));
+
+	} else {
+		if (!mSwrContext || mSwrInputSampleFormat != sampleFormat ||
+		    mSwrInputNbChannels != layout.nb_channels || mSwrInputSampleRate != sampleRate) {
+			SwrContext *swrContext = nullptr;
+			if (swr_alloc_set_opts2(&swrContext, &mCodecContext->ch_layout,
+			                        mCodecContext->sample_fmt, mCodecContext->sample_rate, &layout,
+			                        sampleFormat, sampleRate, 0, nullptr) < 0)
+				throw std::runtime_error("Failed to set up SWR context");
+
+			mSwrContext =
+			    unique_ptr_deleter<SwrContext>(swrContext, [](SwrContext *p) { swr_free(&p); });
+
+			if (swr_init(mSwrContext.get()) < 0)
+				throw std::runtime_error("Failed to initialize SWR context");
+
+			mSwrInputSampleFormat = sampleFormat;
+			mSwrInputNbChannels = layout.nb_channels;
+			mSwrInputSampleRate = sampleRate;
+		}
+
+		int outSamples = swr_get_out_samples(mSwrContext.get(), nbSamples);
+		if (outSamples < 0)
+			throw std::runtime_error("Failed to compute resampled samples count");
+
+		// Convert directly into the ring, the input is dropped if there is no room at all
+		auto region = mRing->beginWrite(size_t(outSamples));
+		if (region.size() == 0)
+			return;
+
+		auto in = const_cast<const uint8_t **>(data);
+		auto out = reinterpret_cast<uint8_t *>(region.first);
+		int converted = swr_convert(mSwrContext.get(), &out, int(region.firstSize), in, nbSamples);
+		if (converted >= 0 && region.secondSize > 0) {
+			// Drain what did not fit before the wrap, a null input would flush the resampler
+			out = reinterpret_cast<uint8_t *>(region.second);
+			int ret = swr_convert(mSwrContext.get(), &out, int(region.secondSize), in, 0);
+			converted = ret >= 0 ? converted + ret : ret;
+		}
+		if (converted < 0)
+			throw std::runtime_error("Audio samples conversion failed");
+
+		mRing->commitWrite(size_t(converted));
+	}
 
-	finishedWrapper->finished = std::move(input.finished);
-	push(std::move(frame));
+	auto now = clock::now();
+	mLastWriteUs.store(
+	    std::chrono::duration_cast<std::chrono::microseconds>(origin.time_since_epoch()).count(),
+	    std::memory_order_release);
+	mLatency.record(PipelineStage::Convert, now - origin);
+}
+
+AudioRing::Region AudioEncoder::beginWrite(int nbSamples) {
+	if (nbSamples <= 0 || !active())
+		return {};
+
+	return mRing->beginWrite(size_t(nbSamples));
+}
+
+void AudioEncoder::commitWrite(int nbSamples) {
+	if (nbSamples <= 0)
+		return;
+
+	mRing->commitWrite(size_t(nbSamples));
+	mLastWriteUs.store(std::chrono::duration_cast<std::chrono::microseconds>(
+	                       clock::now().time_since_epoch())
+	                       .count(),
+	                   std::memory_order_release);
+}
+
+AVSampleFormat AudioEncoder::sampleFormat() const { return mCodecContext->sample_fmt; }
+
+void AudioEncoder::setDropPolicy(DropPolicy policy) { mRing->setPolicy(policy); }
+
+AudioRing::Stats AudioEncoder::ringStats() const { return mRing->stats(); }
+
+void AudioEncoder::start() {
+	if (mCodec->id == AV_CODEC_ID_OPUS) {
+		std::scoped_lock lock(mCodecContextMutex, mOpusOptionsMutex);
+		mAppliedOpusOptions = mOpusOptions;
+		mOpusOptionsChanged = false;
+		applyBitrate(); // before the options, which take precedence
+		configure(mCodecContext.get(), mAppliedOpusOptions);
+	}
+
+	mRing->reopen();
+	Encoder::start();
+}
+
+void AudioEncoder::stop() {
+	// Wake up the encoder thread waiting on the ring before joining it
+	mRing->close();
+	Encoder::stop();
+}
+
+int AudioEncoder::frameSize() const {
+	// If the codec is variable frame size, slice frames of the configured duration
+	return mCodecContext->frame_size > 0
+	           ? mCodecContext->frame_size
+	           : int(int64_t(mCodecContext->sample_rate) * mFrameDuration.count() / 1000000);
+}
+
+void AudioEncoder::configure(AVCodecContext *context, const OpusOptions &options) {
+	// SILK and hybrid modes need 10 ms frames, CELT alone also has a shorter lookahead
+	av_opt_set_double(context->priv_data, "frame_duration",
+	                  double(mFrameDuration.count()) / 1000., 0);
+	av_opt_set(context->priv_data, "application",
+	           mFrameDuration < LowDelayFrameDuration ? "lowdelay" : "audio", 0);
+
+	av_opt_set_int(context->priv_data, "fec", options.fec ? 1 : 0, 0);
+	av_opt_set_int(context->priv_data, "packet_loss", options.packetLoss, 0);
+	av_opt_set_int(context->priv_data, "dtx", options.dtx ? 1 : 0, 0);
+	if (options.bitrate)
+		context->bit_rate = *options.bitrate;
+}
+
+void AudioEncoder::reopen() {
+	OpusOptions options = opusOptions();
+
+	auto context = unique_ptr_deleter<AVCodecContext>(
+	    avcodec_alloc_context3(mCodec), [](AVCodecContext *p) { avcodec_free_context(&p); });
+	if (!context)
+		throw std::runtime_error("Failed to allocate encoder context");
+
+	std::unique_lock<std::mutex> lock(mCodecContextMutex);
+	if (av_channel_layout_copy(&context->ch_layout, &mCodecContext->ch_layout) < 0)
+		throw std::runtime_error("Failed to copy audio channel layout");
+
+	context->sample_fmt = mCodecContext->sample_fmt;
+	context->sample_rate = mCodecContext->sample_rate;
+	context->bit_rate = mCodecContext->bit_rate;
+	configure(context.get(), options);
+
+	int ret = avcodec_open2(context.get(), mCodec, nullptr);
+	if (ret < 0) {
+		RTCAST_LOG_ERROR << "Failed to reopen audio encoder, ret=" << ret;
+		return; // keep the previous options
+	}
+
+	// Drain the previous encoder so that no input is lost
+	auto packet = shared_ptr<AVPacket>(av_packet_alloc(), [](AVPacket *p) { av_packet_free(&p); });
+	if (!packet)
+		throw std::runtime_error("Failed to allocate AVPacket");
+
+	if (avcodec_send_frame(mCodecContext.get(), nullptr) >= 0) {
+		while (avcodec_receive_packet(mCodecContext.get(), packet.get()) >= 0) {
+			lock.unlock();
+			output(packet.get());
+			av_packet_unref(packet.get());
+			lock.lock();
+		}
+	}
+
+	// The new encoder starts with its lookahead, which also plays as silence
+	if (context->initial_padding > 0)
+		mOutputCounters.paddingSamples.fetch_add(uint64_t(context->initial_padding),
+		                                         std::memory_order_relaxed);
+
+	mCodecContext = std::move(context);
+	mAppliedOpusOptions = std::move(options);
+	mOutputCounters.reopens.fetch_add(1, std::memory_order_relaxed);
+	RTCAST_LOG_DEBUG << "Reopened audio encoder, fec=" << mAppliedOpusOptions.fec
+	                 << ", packet_loss=" << mAppliedOpusOptions.packetLoss
+	                 << ", dtx=" << mAppliedOpusOptions.dtx
+	                 << ", bitrate=" << mCodecContext->bit_rate;
+}
+
+std::optional<FrameQueue<Encoder::QueuedFrame>::Item> AudioEncoder::pop() {
+	// Between two frames, the codec is not in use
+	if (mOpusOptionsChanged.exchange(false))
+		reopen();
+
+	const int frame_size = frameSize();
+
+	// For audio, frames are produced on the encoder thread, which therefore owns the pool
+	FramePool::AudioFormat poolFormat{mCodecContext->sample_fmt, mCodecContext->sample_rate,
+	                                  mCodecContext->ch_layout.nb_channels, frame_size};
+	if (!mFramePool || mFramePool->audioFormat() != poolFormat)
+		mFramePool = FramePool::Create(poolFormat, mHugePages, mFramePoolCounters);
+
+	// Frames are reused once encoded, nothing is allocated in steady state
+	auto frame = mFramePool->getReusable();
+	const auto timeout = std::chrono::microseconds(int64_t(frame_size) * UnderrunFrames *
+	                                               1000000 / mCodecContext->sample_rate);
+	bool underrun = false;
+	while (true) {
+		auto result = mRing->read(reinterpret_cast<byte *>(frame->data[0]), size_t(frame_size),
+		                          timeout);
+		if (result == AudioRing::ReadResult::Ok)
+			break;
+
+		if (result == AudioRing::ReadResult::Closed)
+			return nullopt;
+
+		// Underrun, the capture is late or stopped, it is accounted for in ringStats()
+		if (!std::exchange(underrun, true))
+			RTCAST_LOG_DEBUG << "Audio ring underrun";
+	}
+
+	frame->time_base = AVRational{1, mCodecContext->sample_rate};
+	frame->pts = mSamplesCount;
+	mSamplesCount += frame_size;
+
+	auto written =
+	    clock::time_point(std::chrono::microseconds(mLastWriteUs.load(std::memory_order_acquire)));
+	return FrameQueue<QueuedFrame>::Item{QueuedFrame{std::move(frame), written}, written};
 }
 
 void AudioEncoder::output(AVPacket *packet) {
-	mEndpoint->broadcastAudio(reinterpret_cast<const byte *>(packet->data), packet->size,
-	                          uint32_t(packet->pts));
+	// The timestamp counts samples so that it stays continuous across reopens and suppressed
+	// frames. It advances by the decoded length: the last packet drained on reopen has a trimmed
+	// duration but still decodes to a full frame, whose end is padding.
+	const uint32_t timestamp = mRtpTimestamp;
+	int samples = frameSize();
+	if (mCodec->id == AV_CODEC_ID_OPUS)
+		if (int decoded = opus_packet_samples(packet->data, packet->size); decoded > 0)
+			samples = int(int64_t(decoded) * mCodecContext->sample_rate / OpusClockRate);
+
+	mRtpTimestamp += uint32_t(samples);
+	if (packet->duration > 0 && packet->duration < samples)
+		mOutputCounters.paddingSamples.fetch_add(uint64_t(samples - packet->duration),
+		                                         std::memory_order_relaxed);
+
+	if (mAppliedOpusOptions.dtx && packet->size <= MaxDtxPacketSize) {
+		mOutputCounters.dtxFrames.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+
+	mOutputCounters.frames.fetch_add(1, std::memory_order_relaxed);
+	mOutputCounters.bytes.fetch_add(uint64_t(packet->size), std::memory_order_relaxed);
+	if (mAppliedOpusOptions.fec) {
+		mOutputCounters.fecFrames.fetch_add(1, std::memory_order_relaxed);
+		mOutputCounters.fecBytes.fetch_add(uint64_t(packet->size), std::memory_order_relaxed);
+	}
+
+	auto frame = EncodedFrame::Create(packet);
+	frame->rtpTimestamp = timestamp;
+	send(std::move(frame));
+}
+
+void AudioEncoder::send(shared_ptr<EncodedFrame> frame) {
+	mEndpoint->broadcastAudio(std::move(frame));
 }
 
 } // namespace rtcast
@@ -7,6 +7,7 @@
  */
 
 #include "audioplayer.hpp"
+#include "log.hpp"
 
 #if RTCAST_HAS_LIBAO
 
@@ -14,7 +15,6 @@ extern "C" {
 #include <ao/ao.h>
 }
 
-#include <iostream>
 #include <mutex>
 #include <stdexcept>
 
@@ -53,7 +53,7 @@ void AudioPlayer::init(const Config &config) {
 	if (!mDevice)
 		throw std::runtime_error("Failed to open audio output");
 
-	std::cout << "Audio player output device opened" << std::endl;
+	RTCAST_LOG_INFO << "Audio player output device opened";
 }
 
 void AudioPlayer::play(void *data, size_t size) {
@@ -0,0 +1,210 @@
+/**
+ * Copyright (c) 2025 Paul-Louis Ageneau
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+#include "audioring.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace rtcast {
+
+AudioRing::AudioRing(size_t capacity, size_t sampleSize, DropPolicy policy)
+    : mMask(RoundUpPowerOfTwo(capacity) - 1), mSampleSize(sampleSize), mPolicy(policy) {
+	if (capacity == 0 || sampleSize == 0)
+		throw std::invalid_argument("Audio ring capacity and sample size must be positive");
+
+	mData.resize((mMask + 1) * mSampleSize);
+}
+
+AudioRing::~AudioRing() { close(); }
+
+size_t AudioRing::RoundUpPowerOfTwo(size_t n) {
+	size_t p = 2;
+	while (p < n)
+		p <<= 1;
+	return p;
+}
+
+size_t AudioRing::size() const {
+	// The read position never passes the write position, so load it first
+	uint64_t readPos = mReadPos.load(std::memory_order_acquire);
+	uint64_t writePos = mWritePos.load(std::memory_order_acquire);
+	return size_t(writePos - readPos);
+}
+
+void AudioRing::notify(std::atomic<int> &waiting) {
+	// Same protocol as FrameQueue, the mutex stays off the fast path
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	if (waiting.load(std::memory_order_relaxed) > 0) {
+		std::lock_guard lock(mMutex);
+		mCondition.notify_all();
+	}
+}
+
+AudioRing::Region AudioRing::beginWrite(size_t count) {
+	if (mClosed.load(std::memory_order_acquire))
+		return {};
+
+	if (count > capacity()) {
+		mCounters.droppedNewest.fetch_add(count - capacity(), std::memory_order_relaxed);
+		count = capacity();
+	}
+
+	const uint64_t writePos = mWritePos.load(std::memory_order_relaxed); // owned by the producer
+	while (true) {
+		uint64_t readPos = mReadPos.load(std::memory_order_acquire);
+		size_t space = capacity() - size_t(writePos - readPos);
+		if (space >= count)
+			break;
+
+		bool full = false;
+		switch (mPolicy.load(std::memory_order_relaxed)) {
+		case DropPolicy::DropNewest:
+			mCounters.droppedNewest.fetch_add(count - space, std::memory_order_relaxed);
+			count = space;
+			full = true;
+			break;
+
+		case DropPolicy::DropOldest:
+		case DropPolicy::Deadline: {
+			// Act as a second consumer, a concurrent read notices the moved position and retries
+			uint64_t target = writePos + count - capacity();
+			if (mReadPos.compare_exchange_weak(readPos, target, std::memory_order_acq_rel))
+				mCounters.droppedOldest.fetch_add(target - readPos, std::memory_order_relaxed);
+
+			break;
+		}
+
+		case DropPolicy::Block: {
+			mCounters.blocked.fetch_add(1, std::memory_order_relaxed);
+			std::unique_lock lock(mMutex);
+			mWaitingProducers.fetch_add(1, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			mCondition.wait(lock, [this, count]() {
+				return capacity() - size() >= count || mClosed.load(std::memory_order_acquire);
+			});
+			mWaitingProducers.fetch_sub(1, std::memory_order_relaxed);
+			if (mClosed.load(std::memory_order_acquire))
+				return {};
+
+			break;
+		}
+		}
+
+		if (full)
+			break;
+	}
+
+	Region region;
+	const size_t offset = size_t(writePos & mMask);
+	region.first = at(writePos);
+	region.firstSize = std::min(count, capacity() - offset);
+	if (region.firstSize < count) {
+		region.second = mData.data();
+		region.secondSize = count - region.firstSize;
+	}
+	return region;
+}
+
+void AudioRing::commitWrite(size_t count) {
+	if (count == 0)
+		return;
+
+	mWritePos.fetch_add(count, std::memory_order_release);
+	mCounters.written.fetch_add(count, std::memory_order_relaxed);
+	notify(mWaitingConsumers);
+}
+
+size_t AudioRing::write(const byte *data, size_t count) {
+	auto region = beginWrite(count);
+	if (region.firstSize > 0)
+		std::memcpy(region.first, data, region.firstSize * mSampleSize);
+
+	if (region.secondSize > 0)
+		std::memcpy(region.second, data + region.firstSize * mSampleSize,
+		            region.secondSize * mSampleSize);
+
+	commitWrite(region.size());
+	return region.size();
+}
+
+AudioRing::ReadResult AudioRing::read(byte *data, size_t count, std::chrono::microseconds timeout) {
+	if (count > capacity())
+		throw std::invalid_argument("Audio ring read is larger than its capacity");
+
+	optional<clock::time_point> deadline;
+	while (true) {
+		uint64_t readPos = mReadPos.load(std::memory_order_acquire);
+		uint64_t writePos = mWritePos.load(std::memory_order_acquire);
+		if (writePos - readPos >= count) {
+			const size_t offset = size_t(readPos & mMask);
+			const size_t first = std::min(count, capacity() - offset);
+			std::memcpy(data, at(readPos), first * mSampleSize);
+			if (first < count)
+				std::memcpy(data + first * mSampleSize, mData.data(),
+				            (count - first) * mSampleSize);
+
+			// The producer may have evicted the samples while they were copied
+			if (!mReadPos.compare_exchange_strong(readPos, readPos + count,
+			                                      std::memory_order_acq_rel))
+				continue;
+
+			mStarved = false;
+			mCounters.read.fetch_add(count, std::memory_order_relaxed);
+			notify(mWaitingProducers);
+			return ReadResult::Ok;
+		}
+
+		if (mClosed.load(std::memory_order_acquire))
+			return ReadResult::Closed;
+
+		if (!deadline)
+			deadline = clock::now() + timeout;
+
+		std::unique_lock lock(mMutex);
+		mWaitingConsumers.fetch_add(1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		bool ready = mCondition.wait_until(lock, *deadline, [this, count]() {
+			return size() >= count || mClosed.load(std::memory_order_acquire);
+		});
+		mWaitingConsumers.fetch_sub(1, std::memory_order_relaxed);
+		if (!ready) {
+			if (!mStarved) {
+				mStarved = true;
+				mCounters.underruns.fetch_add(1, std::memory_order_relaxed);
+			}
+			return ReadResult::Underrun;
+		}
+	}
+}
+
+void AudioRing::close() {
+	std::lock_guard lock(mMutex);
+	mClosed.store(true, std::memory_order_release);
+	mCondition.notify_all();
+}
+
+void AudioRing::reopen() {
+	mReadPos.store(mWritePos.load(std::memory_order_acquire), std::memory_order_release);
+	mStarved = false;
+	mClosed.store(false, std::memory_order_release);
+}
+
+AudioRing::Stats AudioRing::stats() const {
+	Stats stats;
+	stats.written = mCounters.written.load(std::memory_order_relaxed);
+	stats.read = mCounters.read.load(std::memory_order_relaxed);
+	stats.droppedNewest = mCounters.droppedNewest.load(std::memory_order_relaxed);
+	stats.droppedOldest = mCounters.droppedOldest.load(std::memory_order_relaxed);
+	stats.underruns = mCounters.underruns.load(std::memory_order_relaxed);
+	stats.blocked = mCounters.blocked.load(std::memory_order_relaxed);
+	return stats;
+}
+
+} // namespace rtcast
@@ -0,0 +1,130 @@
+/**
+ * Copyright (c) 2025 Paul-Louis Ageneau
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+#include "bandwidthestimator.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace rtcast {
+
+namespace {
+
+using namespace std::chrono_literals;
+
+const double HighLoss = 0.10;
+const double LowLoss = 0.02;
+const double IncreaseRatePerSecond = 0.08;
+const double DelayBackoffFactor = 0.85;
+
+const auto RttWindow = 30s;
+const auto RttOveruseMargin = 50ms;
+const auto MaxRttOveruseMargin = 100ms; // queuing delay is overuse whatever the path length
+const double RttOveruseRatio = 1.5;
+
+const auto HoldDuration = 2s; // after a decrease
+const auto MaxUpdateInterval = 5s;
+const auto RembTimeout = 5s;
+
+} // namespace
+
+BandwidthEstimator::BandwidthEstimator(int64_t minBitrate, int64_t maxBitrate,
+                                       int64_t startBitrate)
+    : mMinBitrate(minBitrate), mMaxBitrate(maxBitrate), mEstimate(0) {
+	if (minBitrate <= 0 || maxBitrate < minBitrate)
+		throw std::invalid_argument("Invalid bitrate range");
+
+	mEstimate = clamp(startBitrate);
+}
+
+void BandwidthEstimator::onReceiverReport(double fractionLost,
+                                          optional<std::chrono::microseconds> rtt,
+                                          clock::time_point now) {
+	std::lock_guard lock(mMutex);
+
+	// Increases are proportional to the time since the previous report, reports are ~1s apart
+	double elapsed =
+	    mLastUpdate ? std::chrono::duration<double>(std::min(now - *mLastUpdate,
+	                                                         clock::duration(MaxUpdateInterval)))
+	                      .count()
+	                : 0.;
+	mLastUpdate = now;
+
+	double estimate = double(mEstimate);
+	if (fractionLost > HighLoss) {
+		estimate *= 1. - 0.5 * fractionLost;
+		mHoldUntil = now + HoldDuration;
+
+	} else if (rtt && isDelayOveruse(*rtt, now)) {
+		estimate *= DelayBackoffFactor;
+		mHoldUntil = now + HoldDuration;
+
+	} else if (fractionLost < LowLoss && now >= mHoldUntil) {
+		estimate *= std::pow(1. + IncreaseRatePerSecond, elapsed);
+	}
+
+	mEstimate = clamp(int64_t(estimate));
+}
+
+void BandwidthEstimator::onRemb(int64_t bitrate, clock::time_point now) {
+	std::lock_guard lock(mMutex);
+	mRemb = bitrate;
+	mRembTime = now;
+}
+
+void BandwidthEstimator::setRange(int64_t minBitrate, int64_t maxBitrate) {
+	if (minBitrate <= 0 || maxBitrate < minBitrate)
+		throw std::invalid_argument("Invalid bitrate range");
+
+	std::lock_guard lock(mMutex);
+	mMinBitrate = minBitrate;
+	mMaxBitrate = maxBitrate;
+	mEstimate = clamp(mEstimate);
+}
+
+int64_t BandwidthEstimator::estimate(clock::time_point now) const {
+	std::lock_guard lock(mMutex);
+	int64_t estimate = mEstimate;
+	if (mRemb && now - mRembTime < RembTimeout)
+		estimate = std::min(estimate, *mRemb);
+
+	return clamp(estimate);
+}
+
+optional<int64_t> BandwidthEstimator::remb(clock::time_point now) const {
+	std::lock_guard lock(mMutex);
+	if (mRemb && now - mRembTime < RembTimeout)
+		return mRemb;
+
+	return nullopt;
+}
+
+int64_t BandwidthEstimator::clamp(int64_t bitrate) const {
+	return std::clamp(bitrate, mMinBitrate, mMaxBitrate);
+}
+
+bool BandwidthEstimator::isDelayOveruse(std::chrono::microseconds rtt, clock::time_point now) {
+	while (!mRttHistory.empty() && now - mRttHistory.front().first > RttWindow)
+		mRttHistory.pop_front();
+
+	mRttHistory.emplace_back(now, rtt);
+
+	auto baseline = mRttHistory.front().second;
+	for (const auto &[time, value] : mRttHistory)
+		baseline = std::min(baseline, value);
+
+	// Queues are building up along the path when the RTT grows well above its minimum
+	auto margin = std::clamp(std::chrono::duration_cast<std::chrono::microseconds>(
+	                             baseline * (RttOveruseRatio - 1.)),
+	                         std::chrono::microseconds(RttOveruseMargin),
+	                         std::chrono::microseconds(MaxRttOveruseMargin));
+	return rtt > baseline + margin;
+}
+
+} // namespace rtcast
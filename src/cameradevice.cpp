@@ -7,6 +7,7 @@
  */
 
 #include "cameradevice.hpp"
+#include "log.hpp"
 
 #if RTCAST_HAS_LIBCAMERA
 
@@ -16,35 +17,45 @@
 #include <linux/dma-buf.h>
 #include <linux/dma-heap.h>
 #include <sys/ioctl.h>
-#include <sys/mman.h>
 #include <sys/stat.h>
+#include <time.h>
 #include <unistd.h>
 
-#include <iostream>
+#include <algorithm>
+#include <cstring>
 #include <stdexcept>
+#include <thread>
 
 namespace rtcast {
 
 namespace {
 
-shared_ptr<AVPacket> make_packet(int fd, size_t len) {
-	AVPacket *packet = av_packet_alloc();
-	if (!packet)
-		return nullptr;
+const unsigned int MaxDecodeThreads = 4;
 
-	void *mem = ::mmap(NULL, len, PROT_READ, MAP_SHARED, fd, 0);
-	if (mem == MAP_FAILED) {
-		av_packet_free(&packet);
-		return nullptr;
-	}
+// Reference-counted packet holding a copy of the first bytes of a mapped buffer
+shared_ptr<AVPacket> copy_packet(const DmaBufCache::Mapping &mapping, size_t size) {
+	auto packet = shared_ptr<AVPacket>(av_packet_alloc(), [](AVPacket *p) { av_packet_free(&p); });
+	if (!packet || av_new_packet(packet.get(), int(size)) < 0)
+		throw std::runtime_error("Failed to allocate packet");
 
-	packet->data = static_cast<uint8_t *>(mem);
-	packet->size = static_cast<int>(len);
+	mapping.beginAccess();
+	std::memcpy(packet->data, mapping.data(), size);
+	mapping.endAccess();
+	return packet;
+}
 
-	return shared_ptr<AVPacket>(packet, [mem, len](AVPacket *packet) {
-		::munmap(mem, len);
-		av_packet_free(&packet);
-	});
+// libcamera timestamps come from V4L2 buffers and are on CLOCK_MONOTONIC
+std::optional<std::chrono::microseconds> time_since_capture(uint64_t timestamp) {
+	struct timespec ts = {};
+	if (::clock_gettime(CLOCK_MONOTONIC, &ts) < 0)
+		return std::nullopt;
+
+	int64_t now = int64_t(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+	int64_t elapsed = now - int64_t(timestamp);
+	if (timestamp == 0 || elapsed < 0 || elapsed > 10000000000) // ignore bogus timestamps
+		return std::nullopt;
+
+	return std::chrono::microseconds(elapsed / 1000);
 }
 
 } // namespace
@@ -58,9 +69,9 @@ CameraDevice::CameraDevice(string deviceName, shared_ptr<VideoEncoder> encoder,
 		CameraManager = std::make_unique<libcamera::CameraManager>();
 		CameraManager->start();
 
-		std::cout << "Available cameras:" << std::endl;
+		RTCAST_LOG_INFO << "Available cameras:";
 		for (const auto &camera : CameraManager->cameras())
-			std::cout << camera->id() << std::endl;
+			RTCAST_LOG_INFO << camera->id();
 	});
 
 	std::string cameraId;
@@ -74,7 +85,7 @@ CameraDevice::CameraDevice(string deviceName, shared_ptr<VideoEncoder> encoder,
 		cameraId = deviceName;
 	}
 
-	std::cout << "Using camera: " << cameraId << std::endl;
+	RTCAST_LOG_INFO << "Using camera: " << cameraId;
 	mCamera = CameraManager->get(cameraId);
 	if (!mCamera)
 		throw std::runtime_error("Failed to get camera");
@@ -85,7 +96,7 @@ CameraDevice::CameraDevice(string deviceName, shared_ptr<VideoEncoder> encoder,
 	mConfig = mCamera->generateConfiguration({libcamera::StreamRole::VideoRecording});
 
 	auto &streamConfig = mConfig->at(0);
-	std::cout << "Default configuration is: " << streamConfig.toString() << std::endl;
+	RTCAST_LOG_INFO << "Default configuration is: " << streamConfig.toString();
 
 	if (mSettings.width > 0)
 		streamConfig.size.width = mSettings.width;
@@ -96,7 +107,7 @@ CameraDevice::CameraDevice(string deviceName, shared_ptr<VideoEncoder> encoder,
 	if (mConfig->validate() == libcamera::CameraConfiguration::Invalid)
 		throw std::runtime_error("Failed to validate configuration");
 
-	std::cout << "Validated configuration is: " << streamConfig.toString() << std::endl;
+	RTCAST_LOG_INFO << "Validated configuration is: " << streamConfig.toString();
 
 	if (mCamera->configure(mConfig.get()) < 0)
 		throw std::runtime_error("Failed to apply camera configuration");
@@ -182,8 +193,8 @@ CameraDevice::CameraDevice(string deviceName, shared_ptr<VideoEncoder> encoder,
 		mDmaAllocator->allocate(stream);
 		buffers = &mDmaAllocator->buffers(stream);
 	} catch (const std::exception &e) {
-		std::cout << "DMA allocation is not possible: " << e.what() << std::endl;
-		std::cout << "Falling back to default allocator" << std::endl;
+		RTCAST_LOG_WARNING << "DMA allocation is not possible: " << e.what();
+		RTCAST_LOG_WARNING << "Falling back to default allocator";
 		mAllocator = std::make_unique<libcamera::FrameBufferAllocator>(mCamera);
 		if (mAllocator->allocate(stream) < 0)
 			throw std::runtime_error("Failed to allocate frame buffers");
@@ -203,23 +214,35 @@ CameraDevice::CameraDevice(string deviceName, shared_ptr<VideoEncoder> encoder,
 
 	mCamera->requestCompleted.connect(this, &CameraDevice::requestComplete);
 
-	std::cout << "CameraDevice created" << std::endl;
+	RTCAST_LOG_DEBUG << "CameraDevice created";
 }
 
 CameraDevice::~CameraDevice() {}
 
 void CameraDevice::initInputCodec(AVCodecID codecId) {
-	const AVCodec *inputCodec = avcodec_find_decoder(codecId);
-	if (!inputCodec)
-		throw std::runtime_error("Failed to find codec for input video stream");
+	unsigned int threads = mSettings.decodeThreads;
+	if (threads == 0)
+		threads = std::clamp(std::thread::hardware_concurrency() / 2, 1u, MaxDecodeThreads);
+
+	auto callback = [this](shared_ptr<AVFrame> frame) {
+		// Frame timestamps are capture timestamps in microseconds
+		if (auto elapsed = time_since_capture(uint64_t(frame->pts) * 1000))
+			mEncoder->recordLatency(PipelineStage::Capture, *elapsed);
+
+		mEncoder->push(std::move(frame));
+	};
+
+	mDecodeStage = std::make_unique<DecodeStage>(codecId, threads, std::move(callback));
+
+	RTCAST_LOG_INFO << "Decoding " << avcodec_get_name(codecId) << " input on "
+	                << mDecodeStage->threadsCount() << " threads";
+}
 
-	mInputCodecContext = unique_ptr_deleter<AVCodecContext>(
-	    avcodec_alloc_context3(inputCodec), [](AVCodecContext *p) { avcodec_free_context(&p); });
-	if (!mInputCodecContext)
-		throw std::runtime_error("Failed to allocate codec context for input video stream");
+optional<DecodeStage::Stats> CameraDevice::decodeStats() const {
+	if (!mDecodeStage)
+		return nullopt;
 
-	if (avcodec_open2(mInputCodecContext.get(), inputCodec, nullptr) < 0)
-		throw std::runtime_error("Failed to open codec for input video stream");
+	return mDecodeStage->stats();
 }
 
 void CameraDevice::start() {
@@ -240,13 +263,31 @@ void CameraDevice::start() {
 
 void CameraDevice::stop() {
 	mCamera->stop();
-
-	for (libcamera::StreamConfiguration &cfg : *mConfig)
-		mAllocator->free(cfg.stream());
+	mDecodeStage.reset();
+
+	for (libcamera::StreamConfiguration &cfg : *mConfig) {
+		if (mAllocator) {
+			releaseMappings(mAllocator->buffers(cfg.stream()));
+			mAllocator->free(cfg.stream());
+		} else if (mDmaAllocator && mDmaAllocator->allocated()) {
+			releaseMappings(mDmaAllocator->buffers(cfg.stream()));
+			mDmaAllocator->free(cfg.stream());
+		}
+	}
 
 	mCamera->release();
 }
 
+void CameraDevice::releaseMappings(
+    const std::vector<std::unique_ptr<libcamera::FrameBuffer>> &buffers) {
+	// Cached mappings would keep the freed buffers alive
+	for (const auto &buffer : buffers)
+		for (const auto &plane : buffer->planes()) {
+			mMappings.evict(plane.fd.get());
+			mEncoder->releaseMapping(plane.fd.get());
+		}
+}
+
 void CameraDevice::requestComplete(libcamera::Request *request) {
 	if (request->status() == libcamera::Request::RequestCancelled)
 		return;
@@ -261,14 +302,9 @@ void CameraDevice::requestComplete(libcamera::Request *request) {
 	libcamera::FrameBuffer *buffer = it->second;
 	const libcamera::FrameMetadata &metadata = buffer->metadata();
 
-	std::cout << "Got camera frame, seq=" << metadata.sequence << ", size=";
-	unsigned int nplane = 0;
-	for (const auto &plane : metadata.planes()) {
-		std::cout << plane.bytesused;
-		if (++nplane < metadata.planes().size())
-			std::cout << "/";
-	}
-	std::cout << std::endl;
+	RTCAST_LOG_TRACE << "Got camera frame, seq=" << metadata.sequence
+	                 << ", planes=" << metadata.planes().size()
+	                 << ", size=" << metadata.planes().front().bytesused;
 
 	auto finished = [this, request]() {
 		request->reuse(libcamera::Request::ReuseBuffers);
@@ -276,22 +312,20 @@ void CameraDevice::requestComplete(libcamera::Request *request) {
 	};
 
 	try {
-		if (mInputCodecContext) {
+		if (mDecodeStage) {
+			// Copy the compressed payload out so that the buffer goes back to the camera now
 			const auto &plane = buffer->planes().front();
-			auto packet = make_packet(plane.fd.get(), plane.length);
+			size_t size =
+			    std::min(size_t(metadata.planes().front().bytesused), size_t(plane.length));
+			auto packet = copy_packet(*mMappings.map(plane.fd.get(), plane.length), size);
 			packet->time_base = {1, 1000000}; // usec
 			packet->pts = metadata.timestamp / 1000;
-			if (avcodec_send_packet(mInputCodecContext.get(), packet.get()) < 0)
-				throw std::runtime_error("Error sending frame for decoding");
-
-			auto frame =
-			    shared_ptr<AVFrame>(av_frame_alloc(), [](AVFrame *p) { av_frame_free(&p); });
+			finished();
 
-			if (avcodec_receive_frame(mInputCodecContext.get(), frame.get()) < 0)
-				throw std::runtime_error("Error getting decoded frame");
+			if (!mDecodeStage->push(std::move(packet))) {
+				RTCAST_LOG_LIMITED(LogLevel::Warning, 1) << "Decoders are busy, dropping frame";
+			}
 
-			mEncoder->push(std::move(frame));
-			finished();
 			return;
 		}
 
@@ -338,10 +372,13 @@ void CameraDevice::requestComplete(libcamera::Request *request) {
 			                         streamConfig.pixelFormat.toString());
 		}
 
+		if (auto elapsed = time_since_capture(metadata.timestamp))
+			mEncoder->recordLatency(PipelineStage::Capture, *elapsed);
+
 		mEncoder->push(std::move(frame));
 
 	} catch (const std::exception &e) {
-		std::cerr << "Failed to push video frame: " << e.what() << std::endl;
+		RTCAST_LOG_LIMITED(LogLevel::Error, 1) << "Failed to push video frame: " << e.what();
 		finished();
 	}
 }
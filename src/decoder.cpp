@@ -7,9 +7,9 @@
  */
 
 #include "decoder.hpp"
+#include "log.hpp"
 
 #include <cstring>
-#include <iostream>
 #include <stdexcept>
 
 namespace rtcast {
@@ -91,8 +91,7 @@ void Decoder::run() {
 
 	while (auto packet = pop()) {
 		std::unique_lock<std::mutex> lock(mCodecContextMutex);
-		std::cout << "Decoding frame, pts=" << packet->pts << ", size=" << packet->size
-		          << std::endl;
+		RTCAST_LOG_TRACE << "Decoding frame, pts=" << packet->pts << ", size=" << packet->size;
 		int ret = avcodec_send_packet(mCodecContext.get(), packet.get());
 		if (ret < 0)
 			throw std::runtime_error("Error sending frame for decoding");
@@ -104,7 +103,7 @@ void Decoder::run() {
 			else if (ret < 0)
 				throw std::runtime_error("Error during decoding");
 
-			std::cout << "Decoded frame, pts=" << frame->pts << std::endl;
+			RTCAST_LOG_TRACE << "Decoded frame, pts=" << frame->pts;
 
 			lock.unlock();
 			output(frame.get());
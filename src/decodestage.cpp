@@ -0,0 +1,126 @@
+/**
+ * Copyright (c) 2025 Paul-Louis Ageneau
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+#include "decodestage.hpp"
+#include "log.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace rtcast {
+
+namespace {
+
+const size_t JobsPerThread = 2; // a decoder never waits for the producer
+
+} // namespace
+
+DecodeStage::DecodeStage(AVCodecID codecId, unsigned int threads, frame_callback callback)
+    : mCallback(std::move(callback)),
+      mQueue(std::max(threads, 1u) * JobsPerThread, DropPolicy::DropNewest) {
+	const AVCodec *codec = avcodec_find_decoder(codecId);
+	if (!codec)
+		throw std::runtime_error("Failed to find decoder for " + string(avcodec_get_name(codecId)));
+
+	for (unsigned int i = 0; i < std::max(threads, 1u); ++i) {
+		auto context = unique_ptr_deleter<AVCodecContext>(
+		    avcodec_alloc_context3(codec), [](AVCodecContext *p) { avcodec_free_context(&p); });
+		if (!context)
+			throw std::runtime_error("Failed to allocate decoder context");
+
+		context->thread_count = 1; // parallelism comes from the pool
+		if (avcodec_open2(context.get(), codec, nullptr) < 0)
+			throw std::runtime_error("Failed to open decoder");
+
+		mContexts.push_back(std::move(context));
+	}
+
+	for (auto &context : mContexts)
+		mThreads.emplace_back(std::bind(&DecodeStage::run, this, context.get()));
+}
+
+DecodeStage::~DecodeStage() {
+	mQueue.close();
+	for (auto &thread : mThreads)
+		thread.join();
+}
+
+bool DecodeStage::push(shared_ptr<AVPacket> packet) {
+	// Sequence numbers are only consumed by queued packets so that output never waits for a gap
+	if (!mQueue.push({mNextSequence, std::move(packet)}))
+		return false;
+
+	++mNextSequence;
+	return true;
+}
+
+DecodeStage::Stats DecodeStage::stats() const {
+	Stats stats;
+	stats.decoded = mDecoded.load(std::memory_order_relaxed);
+	stats.failed = mFailed.load(std::memory_order_relaxed);
+	stats.dropped = mQueue.stats().droppedNewest;
+	return stats;
+}
+
+void DecodeStage::run(AVCodecContext *context) {
+	while (auto item = mQueue.pop()) {
+		auto &job = item->value;
+		shared_ptr<AVFrame> frame;
+		try {
+			frame = decode(context, job.packet.get());
+			mDecoded.fetch_add(1, std::memory_order_relaxed);
+
+		} catch (const std::exception &e) {
+			RTCAST_LOG_LIMITED(LogLevel::Error, 1) << "Failed to decode video: " << e.what();
+			mFailed.fetch_add(1, std::memory_order_relaxed);
+		}
+
+		job.packet.reset(); // release the payload before waiting for the output
+		deliver(job.sequence, std::move(frame));
+	}
+}
+
+shared_ptr<AVFrame> DecodeStage::decode(AVCodecContext *context, const AVPacket *packet) {
+	if (avcodec_send_packet(context, packet) < 0)
+		throw std::runtime_error("Error sending frame for decoding");
+
+	auto frame = mFramePool->getEmpty();
+	if (avcodec_receive_frame(context, frame.get()) < 0)
+		throw std::runtime_error("Error getting decoded frame");
+
+	return frame;
+}
+
+void DecodeStage::deliver(uint64_t sequence, shared_ptr<AVFrame> frame) {
+	std::unique_lock lock(mOutputMutex);
+	mCompleted.emplace(sequence, std::move(frame));
+
+	// A single thread delivers at a time, it picks up frames completed meanwhile by the others
+	if (mDelivering)
+		return;
+
+	mDelivering = true;
+	while (!mCompleted.empty() && mCompleted.begin()->first == mNextOutput) {
+		auto next = std::move(mCompleted.begin()->second);
+		mCompleted.erase(mCompleted.begin());
+		++mNextOutput;
+		if (!next)
+			continue;
+
+		lock.unlock();
+		try {
+			mCallback(std::move(next));
+		} catch (const std::exception &e) {
+			RTCAST_LOG_LIMITED(LogLevel::Error, 1) << "Failed to push decoded video: " << e.what();
+		}
+		lock.lock();
+	}
+	mDelivering = false;
+}
+
+} // namespace rtcast
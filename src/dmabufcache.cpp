@@ -0,0 +1,158 @@
+/**
+ * Copyright (c) 2025 Paul-Louis Ageneau
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+#include "dmabufcache.hpp"
+#include "log.hpp"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef __linux__
+#include <linux/dma-buf.h>
+#endif
+
+#include <cerrno>
+#include <algorithm>
+#include <stdexcept>
+
+namespace rtcast {
+
+DmaBufCache::Mapping::Mapping([[maybe_unused]] int fd, size_t size) : mSize(size) {
+#ifdef _WIN32
+	throw std::logic_error("Memory mapping is not implemented on Windows");
+#else
+	mFd = ::fcntl(fd, F_DUPFD_CLOEXEC, 0);
+	if (mFd < 0)
+		throw std::runtime_error("Failed to duplicate buffer file descriptor");
+
+	mData = ::mmap(NULL, size, PROT_READ, MAP_SHARED, mFd, 0);
+	if (mData == MAP_FAILED) {
+		::close(mFd);
+		throw std::runtime_error("Memory mapping failed");
+	}
+#endif
+}
+
+DmaBufCache::Mapping::~Mapping() {
+#ifndef _WIN32
+	::munmap(mData, mSize);
+	::close(mFd);
+#endif
+}
+
+void DmaBufCache::Mapping::beginAccess() const {
+#ifdef __linux__
+	sync(DMA_BUF_SYNC_START | DMA_BUF_SYNC_READ);
+#endif
+}
+
+void DmaBufCache::Mapping::endAccess() const {
+#ifdef __linux__
+	sync(DMA_BUF_SYNC_END | DMA_BUF_SYNC_READ);
+#endif
+}
+
+void DmaBufCache::Mapping::sync([[maybe_unused]] uint64_t flags) const {
+#ifdef __linux__
+	if (!mSyncSupported.load(std::memory_order_relaxed))
+		return;
+
+	struct dma_buf_sync sync = {};
+	sync.flags = flags;
+	int ret;
+	do {
+		ret = ::ioctl(mFd, DMA_BUF_IOCTL_SYNC, &sync);
+	} while (ret < 0 && (errno == EINTR || errno == EAGAIN));
+
+	if (ret < 0) {
+		// Not a DMA-BUF (memfd, shared memory), nothing to synchronize
+		if (errno == ENOTTY || errno == EINVAL)
+			mSyncSupported.store(false, std::memory_order_relaxed);
+		else
+			RTCAST_LOG_LIMITED(LogLevel::Warning, 1) << "DMA-BUF synchronization failed";
+	}
+#endif
+}
+
+DmaBufCache::DmaBufCache(size_t maxEntries) : mMaxEntries(std::max(maxEntries, size_t(1))) {}
+
+shared_ptr<const DmaBufCache::Mapping> DmaBufCache::map([[maybe_unused]] int fd,
+                                                        [[maybe_unused]] size_t size) {
+#ifdef _WIN32
+	throw std::logic_error("Memory mapping is not implemented on Windows");
+#else
+	struct stat st = {};
+	if (::fstat(fd, &st) < 0)
+		throw std::runtime_error("Failed to stat buffer file descriptor");
+
+	std::lock_guard lock(mMutex);
+	for (auto it = mEntries.begin(); it != mEntries.end(); ++it) {
+		if (it->device != uint64_t(st.st_dev) || it->inode != uint64_t(st.st_ino))
+			continue;
+
+		if (it->mapping->size() < size) {
+			// The buffer grew, map it again
+			mEntries.erase(it);
+			++mEvictions;
+			break;
+		}
+
+		mEntries.splice(mEntries.begin(), mEntries, it);
+		++mHits;
+		return it->mapping;
+	}
+
+	++mMisses;
+	auto mapping = shared_ptr<const Mapping>(new Mapping(fd, size));
+	mEntries.push_front({uint64_t(st.st_dev), uint64_t(st.st_ino), mapping});
+	while (mEntries.size() > mMaxEntries) {
+		mEntries.pop_back();
+		++mEvictions;
+	}
+	return mapping;
+#endif
+}
+
+void DmaBufCache::evict([[maybe_unused]] int fd) {
+#ifndef _WIN32
+	struct stat st = {};
+	if (::fstat(fd, &st) < 0)
+		return;
+
+	std::lock_guard lock(mMutex);
+	mEntries.remove_if([&](const Entry &entry) {
+		bool match = entry.device == uint64_t(st.st_dev) && entry.inode == uint64_t(st.st_ino);
+		if (match)
+			++mEvictions;
+		return match;
+	});
+#endif
+}
+
+void DmaBufCache::clear() {
+	std::lock_guard lock(mMutex);
+	mEvictions += mEntries.size();
+	mEntries.clear();
+}
+
+DmaBufCache::Stats DmaBufCache::stats() const {
+	std::lock_guard lock(mMutex);
+	Stats stats;
+	stats.hits = mHits;
+	stats.misses = mMisses;
+	stats.evictions = mEvictions;
+	stats.entries = mEntries.size();
+	return stats;
+}
+
+} // namespace rtcast
@@ -38,7 +38,7 @@ DrmVideoEncoder::~DrmVideoEncoder() {}
 void DrmVideoEncoder::push(shared_ptr<AVFrame> frame) { VideoEncoder::push(std::move(frame)); }
 
 void DrmVideoEncoder::push(InputFrame input) {
-	if(mEndpoint->clientsCount() == 0) {
+	if(!active()) {
 		// no clients, no need to encode
 		if (input.finished)
 			input.finished();
@@ -52,9 +52,7 @@ void DrmVideoEncoder::push(InputFrame input) {
 	if (input.pixelFormat != AV_PIX_FMT_YUV420P)
 		throw std::logic_error("Unexpected pixel format for DRM video encoder");
 
-	auto frame = shared_ptr<AVFrame>(av_frame_alloc(), [](AVFrame *p) { av_frame_free(&p); });
-	if (!frame)
-		throw std::runtime_error("Failed to allocate AVFrame");
+	auto frame = mEmptyFramePool->getEmpty();
 
 	struct FinishedWrapper {
 		std::function<void()> finished;
@@ -0,0 +1,47 @@
+/**
+ * Copyright (c) 2025 Paul-Louis Ageneau
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+#include "encodedframe.hpp"
+
+#include <stdexcept>
+
+namespace rtcast {
+
+shared_ptr<EncodedFrame> EncodedFrame::Create(const AVPacket *packet) {
+	auto frame = shared_ptr<EncodedFrame>(new EncodedFrame());
+	frame->mPacket = unique_ptr_deleter<AVPacket>(av_packet_alloc(),
+	                                              [](AVPacket *p) { av_packet_free(&p); });
+	if (!frame->mPacket)
+		throw std::runtime_error("Failed to allocate AVPacket");
+
+	if (av_packet_ref(frame->mPacket.get(), packet) < 0)
+		throw std::runtime_error("Failed to reference AVPacket");
+
+	frame->mData = reinterpret_cast<const byte *>(frame->mPacket->data);
+	frame->mSize = size_t(frame->mPacket->size);
+	frame->keyframe = (packet->flags & AV_PKT_FLAG_KEY) != 0;
+	return frame;
+}
+
+shared_ptr<EncodedFrame> EncodedFrame::Create(const byte *data, size_t size) {
+	auto frame = shared_ptr<EncodedFrame>(new EncodedFrame());
+	frame->mBuffer.assign(data, data + size);
+	frame->mData = frame->mBuffer.data();
+	frame->mSize = frame->mBuffer.size();
+	return frame;
+}
+
+shared_ptr<EncodedFrame> EncodedFrame::Create(binary data) {
+	auto frame = shared_ptr<EncodedFrame>(new EncodedFrame());
+	frame->mBuffer = std::move(data);
+	frame->mData = frame->mBuffer.data();
+	frame->mSize = frame->mBuffer.size();
+	return frame;
+}
+
+} // namespace rtcast
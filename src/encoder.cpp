@@ -7,15 +7,18 @@
  */
 
 #include "encoder.hpp"
+#include "log.hpp"
 
-#include <iostream>
 #include <stdexcept>
 
 namespace rtcast {
 
 const int MaxFrameQueueSize = 10;
+const auto DefaultKeyframeCoalescing = std::chrono::milliseconds(500);
 
-Encoder::Encoder(string codecName) : mCodecName(std::move(codecName)) {
+Encoder::Encoder(string codecName)
+    : mCodecName(std::move(codecName)), mFrameQueue(MaxFrameQueueSize, DropPolicy::DropOldest),
+      mKeyframeCoalescingUs(std::chrono::microseconds(DefaultKeyframeCoalescing).count()) {
 
 	// av_log_set_level(AV_LOG_VERBOSE);
 
@@ -27,6 +30,9 @@ Encoder::Encoder(string codecName) : mCodecName(std::move(codecName)) {
 	    avcodec_alloc_context3(mCodec), [](AVCodecContext *p) { avcodec_free_context(&p); });
 	if (!mCodecContext)
 		throw std::runtime_error("Failed to allocate encoder context");
+
+	mFramePoolCounters = std::make_shared<FramePool::Counters>();
+	mEmptyFramePool = FramePool::Create(mFramePoolCounters);
 }
 
 Encoder::~Encoder() { stop(); }
@@ -36,55 +42,113 @@ string Encoder::codecName() const { return mCodecName; }
 AVCodecID Encoder::codecID() const { return mCodecContext->codec_id; }
 
 void Encoder::setBitrate(int64_t bitrate) {
-	std::unique_lock<std::mutex> lock(mCodecContextMutex);
-	mCodecContext->bit_rate = bitrate;
+	// The encoder thread holds the context lock while encoding, so waiting for it here would
+	// stall the caller, typically the RTCP thread
+	mPendingBitrate.store(bitrate, std::memory_order_release);
+}
+
+void Encoder::applyBitrate() {
+	if (int64_t bitrate = mPendingBitrate.exchange(-1, std::memory_order_acq_rel); bitrate >= 0)
+		mCodecContext->bit_rate = bitrate;
+}
+
+void Encoder::requestKeyframe() {
+	mKeyframeRequests.fetch_add(1, std::memory_order_relaxed);
+	mKeyframeRequested.store(true, std::memory_order_release);
+}
+
+void Encoder::setKeyframeCoalescing(std::chrono::milliseconds window) {
+	mKeyframeCoalescingUs = std::chrono::microseconds(window).count();
+}
+
+void Encoder::setDropPolicy(DropPolicy policy) { mFrameQueue.setPolicy(policy); }
+
+void Encoder::setQueueDeadline(std::chrono::milliseconds deadline) {
+	mFrameQueue.setDeadline(deadline);
+}
+
+Encoder::QueueStats Encoder::queueStats() const { return mFrameQueue.stats(); }
+
+void Encoder::setHugePages(bool enabled) { mHugePages = enabled; }
+
+FramePool::Stats Encoder::framePoolStats() const { return mFramePoolCounters->stats(); }
+
+void Encoder::recordLatency(PipelineStage stage, std::chrono::microseconds value) {
+	mLatency.record(stage, value);
+}
+
+LatencyStats Encoder::latencyStats() const { return mLatency.stats(); }
+
+void Encoder::resetLatencyStats() { mLatency.reset(); }
+
+Encoder::Stats Encoder::stats() const {
+	Stats stats;
+	stats.latency = latencyStats();
+	stats.queue = queueStats();
+	stats.framePool = framePoolStats();
+	stats.keyframeRequests = mKeyframeRequests.load(std::memory_order_relaxed);
+	stats.forcedKeyframes = mForcedKeyframes.load(std::memory_order_relaxed);
+	return stats;
 }
 
 void Encoder::start() {
+	std::unique_lock<std::mutex> lock(mCodecContextMutex);
+	applyBitrate();
 	int ret = avcodec_open2(mCodecContext.get(), mCodec, nullptr);
 	if (ret < 0)
 		throw std::runtime_error("Failed to initialize encoder context, ret=" + std::to_string(ret));
 
+	lock.unlock();
+	mFrameQueue.reopen();
 	mRunning = true;
 	mThread = std::thread(std::bind(&Encoder::run, this));
 }
 
 void Encoder::stop() {
 	if (mRunning.exchange(false)) {
-		mCondition.notify_all();
+		mFrameQueue.close();
 		mThread.join();
 	}
 }
 
-void Encoder::push(shared_ptr<AVFrame> frame) {
-	std::unique_lock<std::mutex> lock(mMutex);
-	if (mFrameQueue.size() >= MaxFrameQueueSize) {
-        std::cout << "Dropping frame (queue is full), pts=" << frame->pts << std::endl;
-        return;
-    }
-	mFrameQueue.emplace(std::move(frame));
-	mCondition.notify_all();
-}
+bool Encoder::isRunning() const { return mRunning; }
 
-shared_ptr<AVFrame> Encoder::pop() {
-	std::unique_lock<std::mutex> lock(mMutex);
-	mCondition.wait(lock, [this]() { return !mFrameQueue.empty() || !mRunning; });
-	if (mFrameQueue.empty())
-		return nullptr;
+void Encoder::push(shared_ptr<AVFrame> frame) { enqueue(std::move(frame), clock::now()); }
 
-	auto frame = std::move(mFrameQueue.front());
-	mFrameQueue.pop();
-	return frame;
+void Encoder::enqueue(shared_ptr<AVFrame> frame, clock::time_point origin) {
+	// Overflow is handled according to the drop policy and accounted for in queueStats()
+	mFrameQueue.push(QueuedFrame{std::move(frame), origin});
 }
 
+std::optional<FrameQueue<Encoder::QueuedFrame>::Item> Encoder::pop() { return mFrameQueue.pop(); }
+
 void Encoder::run() {
 	auto packet = shared_ptr<AVPacket>(av_packet_alloc(), [](AVPacket *p) { av_packet_free(&p); });
 	if (!packet)
 		throw std::runtime_error("Failed to allocate AVPacket");
 
-	while (auto frame = pop()) {
+	while (auto item = pop()) {
+		auto dequeued = clock::now();
+		mLatency.record(PipelineStage::Queue, dequeued - item->enqueued);
+
+		const auto &frame = item->value.frame;
+
+		// Decoded input frames may carry a picture type, which would force keyframes
+		frame->pict_type = AV_PICTURE_TYPE_NONE;
+		if (mKeyframeRequested.load(std::memory_order_acquire)) {
+			auto window = std::chrono::microseconds(mKeyframeCoalescingUs.load());
+			if (!mLastForcedKeyframe || dequeued - *mLastForcedKeyframe >= window) {
+				mKeyframeRequested.store(false, std::memory_order_relaxed);
+				mLastForcedKeyframe = dequeued;
+				mForcedKeyframes.fetch_add(1, std::memory_order_relaxed);
+				frame->pict_type = AV_PICTURE_TYPE_I;
+				RTCAST_LOG_DEBUG << "Forcing keyframe, pts=" << frame->pts;
+			}
+		}
+
 		std::unique_lock<std::mutex> lock(mCodecContextMutex);
-		std::cout << "Encoding frame, pts=" << frame->pts << std::endl;
+		applyBitrate();
+		RTCAST_LOG_TRACE << "Encoding frame, pts=" << frame->pts;
 		int ret = avcodec_send_frame(mCodecContext.get(), frame.get());
 		if (ret < 0)
 			throw std::runtime_error("Error sending frame for encoding");
@@ -96,11 +160,12 @@ void Encoder::run() {
 			else if (ret < 0)
 				throw std::runtime_error("Error during encoding");
 
-			std::cout << "Encoded frame, pts=" << packet->pts << ", size=" << packet->size
-			          << std::endl;
+			RTCAST_LOG_TRACE << "Encoded frame, pts=" << packet->pts << ", size=" << packet->size;
+			mLatency.record(PipelineStage::Encode, clock::now() - dequeued);
 
 			lock.unlock();
 			output(packet.get());
+			mLatency.record(PipelineStage::Total, clock::now() - item->value.origin);
 			lock.lock();
 		}
 	}
@@ -7,13 +7,21 @@
  */
 
 #include "endpoint.hpp"
+#include "log.hpp"
+#include "nackresponder.hpp"
+#include "nal.hpp"
+#include "reddepacketizer.hpp"
+#include "rtcpobserver.hpp"
+#include "sdp.hpp"
 
 #include "nlohmann/json.hpp"
 #include "rtc/rtc.hpp"
 
-#include <iostream>
+#include <algorithm>
+#include <cstdlib>
 #include <random>
 #include <stdexcept>
+#include <thread>
 
 namespace {
 
@@ -27,9 +35,123 @@ using namespace std::placeholders;
 using std::chrono::duration_cast;
 using json = nlohmann::json;
 
-Endpoint::Endpoint(uint16_t port) {
+namespace {
+
+const int VideoPayloadType = 96;
+const int AudioPayloadType = 97;
+const int RedPayloadType = 63; // as browsers
+const size_t DefaultSendQueueCapacity = 16; // frames
+const unsigned int MaxSendThreads = 4;
+
+const int64_t DefaultMinBitrate = 150000;
+const int64_t DefaultMaxBitrate = 4000000;
+const double TargetBitrateHysteresis = 0.05;
+const auto TargetIncreaseInterval = std::chrono::seconds(1);
+
+const size_t DefaultGopCacheSize = 4 * 1024 * 1024; // bytes
+const int64_t DefaultPrimingBitrate = 20000000;
+const auto PrimingFrameInterval = std::chrono::milliseconds(1);
+
+const double RenditionUpgradeMargin = 0.2; // over the nominal bitrate to switch up
+
+// Milliseconds as in SDP packet times, fractional for 2.5 ms
+string format_milliseconds(std::chrono::microseconds duration) {
+	auto us = duration.count();
+	string result = std::to_string(us / 1000);
+	if (us % 1000 != 0) {
+		string fraction = std::to_string(1000 + us % 1000).substr(1);
+		fraction.erase(fraction.find_last_not_of('0') + 1);
+		result += "." + fraction;
+	}
+	return result;
+}
+
+
+// libdatachannel's default Opus profile, with minptime lowered for frames under 10 ms
+// minptime is an integer lower bound, so it is rounded down: 2.5 ms frames give 2, not 3.
+string opus_profile(std::chrono::microseconds frameDuration) {
+	auto minptime = std::clamp<int64_t>(frameDuration.count() / 1000, 1, 10);
+	return "minptime=" + std::to_string(minptime) +
+	       ";maxaveragebitrate=96000;stereo=1;sprop-stereo=1;useinbandfec=1";
+}
+
+int64_t aggregate_bitrate(std::vector<int64_t> estimates, Endpoint::BitratePolicy policy,
+                          double percentile) {
+	std::sort(estimates.begin(), estimates.end());
+	switch (policy) {
+	case Endpoint::BitratePolicy::Percentile: {
+		auto index = size_t(std::clamp(percentile, 0., 1.) * double(estimates.size() - 1) + 0.5);
+		return estimates[index];
+	}
+	default:
+		return estimates.front();
+	}
+}
+
+// The shared config is never sent on the wire, only clients' SSRCs are
+shared_ptr<rtc::RtpPacketizer> create_shared_packetizer(Endpoint::VideoCodec codec) {
+	auto config = std::make_shared<rtc::RtpPacketizationConfig>(
+	    0, "video-shared", VideoPayloadType, rtc::H264RtpPacketizer::ClockRate);
+
+	switch (codec) {
+	case Endpoint::VideoCodec::H264:
+		return std::make_shared<rtc::H264RtpPacketizer>(
+		    rtc::H264RtpPacketizer::Separator::ShortStartSequence, config);
+	case Endpoint::VideoCodec::H265:
+		return std::make_shared<rtc::H265RtpPacketizer>(
+		    rtc::H265RtpPacketizer::Separator::ShortStartSequence, config);
+	default:
+		return nullptr;
+	}
+}
+
+// Parameter sets of an access unit in Annex-B format, empty if there are none
+binary parameter_sets(Endpoint::VideoCodec codec, const byte *data, size_t size) {
+	switch (codec) {
+	case Endpoint::VideoCodec::H264:
+		return nal::H264ParameterSets(data, size);
+	case Endpoint::VideoCodec::H265:
+		return nal::H265ParameterSets(data, size);
+	default:
+		return {};
+	}
+}
+
+int64_t steady_microseconds(std::chrono::steady_clock::time_point time) {
+	return std::chrono::duration_cast<std::chrono::microseconds>(time.time_since_epoch()).count();
+}
+
+unsigned int default_send_threads() {
+	unsigned int n = std::thread::hardware_concurrency() / 2;
+	return std::clamp(n, 1u, MaxSendThreads);
+}
+
+} // namespace
+
+struct Endpoint::Transport {
+	const shared_ptr<NackResponder::Counters> counters =
+	    std::make_shared<NackResponder::Counters>();
+	std::atomic<double> fractionLost = 0.;
+	std::atomic<int32_t> cumulativeLost = 0;
+	std::atomic<int64_t> rttUs = -1; // unknown
+
+	void onReceiverReport(const RtcpObserver::ReceiverReport &report) {
+		fractionLost.store(report.fractionLost, std::memory_order_relaxed);
+		cumulativeLost.store(report.cumulativeLost, std::memory_order_relaxed);
+		if (report.rtt)
+			rttUs.store(report.rtt->count(), std::memory_order_relaxed);
+	}
+};
+
+Endpoint::Endpoint(uint16_t port)
+    : mGopCacheSize(DefaultGopCacheSize), mPrimingBitrate(DefaultPrimingBitrate),
+      mMinBitrate(DefaultMinBitrate), mMaxBitrate(DefaultMaxBitrate),
+      mSendQueueCapacity(DefaultSendQueueCapacity), mSendQueuePolicy(DropPolicy::DropOldest),
+      mSendPool(std::make_shared<SendPool>(default_send_threads())) {
 	rtc::InitLogger(rtc::LogLevel::Warning);
 
+	setHealthThresholds({});
+
 	rtc::WebSocketServer::Configuration config;
 	config.port = port;
 
@@ -45,9 +167,65 @@ void Endpoint::setVideo(VideoCodec codec) {
 	if (mVideoCodec != VideoCodec::None)
 		throw std::logic_error("Video is already set for the endpoint");
 
+	auto stream = std::make_unique<VideoStream>(mGopCacheSize);
+	if (auto packetizer = create_shared_packetizer(codec))
+		stream->packetizer = std::make_unique<SharedPacketizer>(std::move(packetizer));
+
+	mVideoStreams.clear();
+	mVideoStreams.push_back(std::move(stream));
 	mVideoCodec = codec;
 }
 
+void Endpoint::setRenditions(std::vector<int64_t> bitrates) {
+	if (mVideoCodec == VideoCodec::None)
+		throw std::logic_error("Video must be set before renditions");
+
+	if (bitrates.empty())
+		throw std::invalid_argument("At least one rendition is required");
+
+	if (clientsCount() > 0)
+		throw std::logic_error("Renditions must be set before clients connect");
+
+	// Renditions share the RTP timestamp origin so that clients can switch between them
+	mVideoStreams.resize(1);
+	for (size_t i = 1; i < bitrates.size(); ++i) {
+		auto stream = std::make_unique<VideoStream>(mGopCacheSize);
+		if (auto packetizer = create_shared_packetizer(mVideoCodec)) {
+			const auto &first = mVideoStreams.front();
+			packetizer->rtpConfig->startTimestamp = first->packetizer->startTimestamp();
+			packetizer->rtpConfig->timestamp = packetizer->rtpConfig->startTimestamp;
+			stream->packetizer = std::make_unique<SharedPacketizer>(std::move(packetizer));
+		}
+		mVideoStreams.push_back(std::move(stream));
+	}
+
+	for (size_t i = 0; i < bitrates.size(); ++i)
+		mVideoStreams[i]->bitrate = bitrates[i];
+
+	std::lock_guard lock(mTargetBitrateMutex);
+	mRenditionTargets.assign(bitrates.size(), 0);
+	mLastRenditionIncreases.assign(bitrates.size(), {});
+}
+
+unsigned int Endpoint::renditionsCount() const {
+	return static_cast<unsigned int>(mVideoStreams.size());
+}
+
+void Endpoint::setClientRendition(int id, optional<unsigned int> rendition) {
+	shared_ptr<Client> client;
+	{
+		std::shared_lock lock(mMutex);
+		if (auto it = mClients.find(id); it != mClients.end())
+			client = it->second;
+	}
+
+	if (!client)
+		return;
+
+	client->requestedRendition = rendition ? int(*rendition) : -1;
+	selectRendition(*client);
+}
+
 void Endpoint::setAudio(AudioCodec codec) {
 	if (mAudioCodec != AudioCodec::None)
 		throw std::logic_error("Audio is already set for the endpoint");
@@ -55,37 +233,362 @@ void Endpoint::setAudio(AudioCodec codec) {
 	mAudioCodec = codec;
 }
 
+void Endpoint::setAudioFrameDuration(std::chrono::microseconds duration) {
+	if (duration.count() <= 0)
+		throw std::invalid_argument("Audio frame duration must be positive");
+
+	mAudioFrameDurationUs = duration.count();
+}
+
+void Endpoint::setAudioRedundancy(unsigned int distance) {
+	if (distance > RedEncoder::MaxDistance)
+		throw std::invalid_argument("Audio redundancy distance is too large");
+
+	mAudioRedundancy = distance;
+}
+
+void Endpoint::setSharedPacketization(bool enabled) { mSharedPacketization = enabled; }
+
+void Endpoint::setSendQueue(size_t capacity, DropPolicy policy) {
+	mSendQueueCapacity = capacity;
+	mSendQueuePolicy = policy;
+}
+
+void Endpoint::setIceSettings(IceSettings settings) {
+	std::lock_guard lock(mIceSettingsMutex);
+	mIceSettings = std::move(settings);
+}
+
+uint16_t Endpoint::port() const { return mWebSocketServer->port(); }
+
 void Endpoint::broadcastVideo(const byte *data, size_t size, std::chrono::microseconds timestamp) {
-	if (mVideoCodec == VideoCodec::None)
+	auto frame = EncodedFrame::Create(data, size);
+	frame->timestamp = timestamp;
+	switch (mVideoCodec) {
+	case VideoCodec::H264:
+		frame->keyframe = nal::IsH264Keyframe(data, size);
+		break;
+	case VideoCodec::H265:
+		frame->keyframe = nal::IsH265Keyframe(data, size);
+		break;
+	default:
+		frame->keyframe = true; // unknown, never withhold
+		break;
+	}
+	broadcastVideo(std::move(frame));
+}
+
+void Endpoint::broadcastAudio(const byte *data, size_t size, uint32_t timestamp) {
+	auto frame = EncodedFrame::Create(data, size);
+	frame->rtpTimestamp = timestamp;
+	broadcastAudio(std::move(frame));
+}
+
+void Endpoint::broadcastVideo(shared_ptr<const EncodedFrame> frame) {
+	if (mVideoCodec == VideoCodec::None || frame->rendition >= mVideoStreams.size())
 		return;
 
+	const unsigned int rendition = frame->rendition;
+	auto &stream = *mVideoStreams[rendition];
+	auto &packetizer = stream.packetizer;
+
+	shared_ptr<const SharedPacketizer::Frame> packets; // packetized on first use
+	if (stream.gopCache.enabled()) {
+		if (packetizer && mSharedPacketization)
+			packets = packetizer->packetize(frame->data(), frame->size(), frame->timestamp);
+
+		cacheVideo(stream, frame, packets);
+	}
+
 	std::shared_lock lock(mMutex);
 	for (const auto &[id, client] : mClients) {
-		try {
-			if (client->video && client->video->isOpen())
-				client->video->sendFrame(data, size, std::chrono::duration<double>(timestamp));
+		if (!client->videoQueue || !client->video || !client->video->isOpen())
+			continue;
 
-		} catch (const std::exception &e) {
-			std::cerr << "Failed to send video: " << e.what() << std::endl;
-			client->pc->close();
+		std::lock_guard renditionLock(client->renditionMutex);
+		if (rendition != client->rendition) {
+			// Switch on a keyframe of the target rendition
+			if (rendition != client->targetRendition || !frame->keyframe)
+				continue;
+
+			RTCAST_LOG_DEBUG << "Client " << id << " switched to rendition " << rendition;
+			client->rendition = rendition;
+		}
+
+		// Evicting a queued frame would leave a gap in the middle of the GOP, skip until the next
+		// keyframe instead so that the decoder never sees it
+		auto &health = client->videoHealth;
+		auto &queue = *client->videoQueue;
+		if (queue.size() >= queue.capacity() && queue.policy() != DropPolicy::Block &&
+		    !health.skipping.exchange(true)) {
+			RTCAST_LOG_INFO << "Client " << id << " send queue is full, skipping until keyframe";
+			health.skips.fetch_add(1, std::memory_order_relaxed);
+			requestKeyframe(*client);
+		}
+		if (health.skipping.load(std::memory_order_relaxed) && !frame->keyframe) {
+			health.withheldFrames.fetch_add(1, std::memory_order_relaxed);
+			continue;
 		}
+
+		if (client->videoSession && !packets)
+			packets = packetizer->packetize(frame->data(), frame->size(), frame->timestamp);
+
+		queue.push({frame, packets});
 	}
 }
 
-void Endpoint::broadcastAudio(const byte *data, size_t size, uint32_t timestamp) {
+void Endpoint::cacheVideo(VideoStream &stream, shared_ptr<const EncodedFrame> frame,
+                          shared_ptr<const SharedPacketizer::Frame> packets) {
+	if (frame->keyframe) {
+		// Primed clients need parameter sets, prepend the last ones if the keyframe has none
+		if (auto sets = parameter_sets(mVideoCodec, frame->data(), frame->size()); !sets.empty()) {
+			stream.parameterSets = std::move(sets);
+
+		} else if (!stream.parameterSets.empty()) {
+			binary data(stream.parameterSets);
+			data.insert(data.end(), frame->data(), frame->data() + frame->size());
+			auto keyframe = EncodedFrame::Create(data.data(), data.size());
+			keyframe->keyframe = true;
+			keyframe->timestamp = frame->timestamp;
+			keyframe->rendition = frame->rendition;
+			if (packets)
+				packets = stream.packetizer->packetize(data.data(), data.size(), frame->timestamp);
+
+			frame = std::move(keyframe);
+		}
+	}
+
+	stream.gopCache.push({std::move(frame), std::move(packets)});
+}
+
+void Endpoint::broadcastAudio(shared_ptr<const EncodedFrame> frame) {
 	if (mAudioCodec == AudioCodec::None)
 		return;
 
+	// RED payloads are built once for all clients which accepted it
+	shared_ptr<const EncodedFrame> red;
+	if (mAudioCodec == AudioCodec::OPUS) {
+		unsigned int distance = mAudioRedundancy;
+		if (distance > 0 && (!mRedEncoder || mRedEncoder->distance() != distance))
+			mRedEncoder = std::make_unique<RedEncoder>(AudioPayloadType, distance);
+
+		if (mRedEncoder)
+			red = mRedEncoder->encode(frame);
+	}
+
+	// Clients which remapped Opus need the blocks tagged with their payload type, which is rare
+	shared_ptr<const EncodedFrame> relabeled;
+	int relabeledType = AudioPayloadType;
+
 	std::shared_lock lock(mMutex);
 	for (const auto &[id, client] : mClients) {
-		try {
-			if (client->audio && client->audio->isOpen())
-				client->audio->sendFrame(data, size, timestamp);
+		if (!client->audioQueue || !client->audio || !client->audio->isOpen())
+			continue;
+
+		auto payload = frame;
+		if (client->audioRed && red) {
+			payload = red;
+			if (int type = client->opusPayloadType; type >= 0 && type != AudioPayloadType) {
+				if (type != relabeledType) {
+					relabeled = RedEncoder::Relabel(*red, type);
+					relabeledType = type;
+				}
+				payload = relabeled;
+			}
+		}
+		client->audioQueue->push({std::move(payload), nullptr});
+	}
+}
 
-		} catch (const std::exception &e) {
-			std::cerr << "Failed to send audio: " << e.what() << std::endl;
-			client->pc->close();
+void Endpoint::sendVideo(Client &client, const SendPool::Item &item,
+                         SendPool::clock::time_point queued) {
+	auto start = SendPool::clock::now();
+	mVideoLatency.record(PipelineStage::Queue, start - queued);
+	try {
+		if (!client.video || !client.video->isOpen())
+			return;
+
+		std::lock_guard lock(client.videoSendMutex);
+		auto &health = client.videoHealth;
+		if (health.priming.exchange(false)) {
+			if (startPriming(client, item))
+				return; // the live frame follows the cached GOP
+
+			// The frame is not in the cached GOP, fall back to waiting for a keyframe
+			health.skipping = true;
+			if (mKeyframeOnJoin)
+				requestKeyframe(client);
+		}
+
+		// Live frames wait for the cached GOP to be sent
+		if (client.priming) {
+			if (client.priming->held.size() >= mSendQueueCapacity) {
+				// Priming cannot keep up, resume on the next keyframe after the cached GOP
+				client.priming->held.clear();
+				health.skipping = true;
+				health.skips.fetch_add(1, std::memory_order_relaxed);
+				requestKeyframe(client);
+			}
+			client.priming->held.push_back(item);
+			return;
 		}
+
+		deliverVideo(client, item);
+		mVideoLatency.record(PipelineStage::Send, SendPool::clock::now() - start);
+
+	} catch (const std::exception &e) {
+		RTCAST_LOG_LIMITED(LogLevel::Error, 1) << "Failed to send video: " << e.what();
+		client.pc->close();
+	}
+}
+
+void Endpoint::deliverVideo(Client &client, const SendPool::Item &item) {
+	// Inter frames are useless to the decoder after a gap, resume on a keyframe
+	auto &health = client.videoHealth;
+	if (health.skipping) {
+		if (!item.frame->keyframe || isCongested(client, false)) {
+			health.withheldFrames.fetch_add(1, std::memory_order_relaxed);
+			return;
+		}
+
+		if (health.openedAtUs == 0) { // not the first keyframe after joining
+			RTCAST_LOG_INFO << "Client " << client.id << " resumed on keyframe";
+		}
+
+		health.skipping = false;
+
+	} else if (isCongested(client, true)) {
+		RTCAST_LOG_INFO << "Client " << client.id << " is congested, skipping until keyframe";
+		health.skipping = true;
+		health.skips.fetch_add(1, std::memory_order_relaxed);
+		health.withheldFrames.fetch_add(1, std::memory_order_relaxed);
+		// Both are stale once frames are withheld, and without sender reports the RTT would not
+		// be measured again, so keyframes would be rejected forever
+		health.fractionLost = 0.;
+		health.rttUs = -1;
+		requestKeyframe(client);
+		return;
+	}
+
+	if (client.videoSession && item.packets)
+		client.videoSession->send(*item.packets, *client.video);
+	else
+		client.video->sendFrame(item.frame->data(), item.frame->size(),
+		                        std::chrono::duration<double>(item.frame->timestamp));
+
+	recordFirstFrame(client);
+}
+
+bool Endpoint::startPriming(Client &client, const SendPool::Item &item) {
+	auto items = mVideoStreams[item.frame->rendition]->gopCache.get(item.frame->timestamp);
+	if (items.empty())
+		return false;
+
+	items.pop_back(); // the live frame is sent as usual
+	for (const auto &cached : items)
+		if (client.videoSession && !cached.packets)
+			return false; // cached while shared packetization was disabled
+
+	// Compress timestamps so the decoder catches up at once, they stay monotonic and end before
+	// the live frame, which keeps its own timestamp
+	auto priming = std::make_unique<Priming>();
+	const auto live = item.frame->timestamp;
+	for (size_t i = 0; i < items.size(); ++i)
+		priming->timestamps.push_back(
+		    std::max(items[i].frame->timestamp,
+		             live - PrimingFrameInterval * int64_t(items.size() - i)));
+
+	priming->items = std::move(items);
+	priming->start = std::chrono::steady_clock::now();
+	priming->held.push_back(item);
+	client.priming = std::move(priming);
+	continuePriming(client);
+	return true;
+}
+
+void Endpoint::continuePriming(Client &client) {
+	if (!client.video || !client.video->isOpen()) {
+		client.priming.reset();
+		return;
+	}
+
+	// Send what the pacing budget allows, then release the worker until the next frame is due
+	auto &priming = *client.priming;
+	const int64_t bitrate = mPrimingBitrate;
+	const auto now = std::chrono::steady_clock::now();
+	while (priming.next < priming.items.size()) {
+		auto due = priming.start +
+		           std::chrono::microseconds(int64_t(priming.bytes) * 8 * 1000000 / bitrate);
+		if (due > now) {
+			mSendPool->post(due, [this, weak = client.weak_from_this()]() {
+				auto client = weak.lock();
+				if (!client)
+					return;
+
+				std::lock_guard lock(client->videoSendMutex);
+				try {
+					if (client->priming)
+						continuePriming(*client);
+
+				} catch (const std::exception &e) {
+					RTCAST_LOG_LIMITED(LogLevel::Error, 1) << "Failed to send video: " << e.what();
+					client->priming.reset();
+					client->pc->close();
+				}
+			});
+			return;
+		}
+
+		const auto &cached = priming.items[priming.next];
+		const auto timestamp = priming.timestamps[priming.next];
+		if (client.videoSession) {
+			auto shift = (timestamp - cached.frame->timestamp).count() *
+			             rtc::H264RtpPacketizer::ClockRate / 1000000;
+			client.videoSession->send(*cached.packets, *client.video, uint32_t(shift));
+		} else {
+			client.video->sendFrame(cached.frame->data(), cached.frame->size(),
+			                        std::chrono::duration<double>(timestamp));
+		}
+
+		priming.bytes += cached.frame->size();
+		++priming.next;
+		recordFirstFrame(client);
+	}
+
+	mPrimedClients.fetch_add(1, std::memory_order_relaxed);
+	RTCAST_LOG_DEBUG << "Client " << client.id << " primed with " << priming.items.size()
+	                 << " cached frames";
+
+	auto held = std::move(priming.held);
+	client.priming.reset();
+	for (const auto &item : held)
+		deliverVideo(client, item);
+}
+
+void Endpoint::recordFirstFrame(Client &client) {
+	if (int64_t opened = client.videoHealth.openedAtUs.exchange(0); opened != 0) {
+		auto now = std::chrono::steady_clock::now();
+		auto elapsed = std::chrono::microseconds(steady_microseconds(now) - opened);
+		mTimeToFirstFrame.record(elapsed);
+		RTCAST_LOG_DEBUG << "Client " << client.id
+		                 << " time to first frame: " << elapsed.count() / 1000 << "ms";
+	}
+}
+
+void Endpoint::sendAudio(Client &client, const SendPool::Item &item,
+                         SendPool::clock::time_point queued) {
+	auto start = SendPool::clock::now();
+	mAudioLatency.record(PipelineStage::Queue, start - queued);
+	try {
+		if (!client.audio || !client.audio->isOpen())
+			return;
+
+		client.audio->sendFrame(item.frame->data(), item.frame->size(), item.frame->rtpTimestamp);
+		mAudioLatency.record(PipelineStage::Send, SendPool::clock::now() - start);
+
+	} catch (const std::exception &e) {
+		RTCAST_LOG_LIMITED(LogLevel::Error, 1) << "Failed to send audio: " << e.what();
+		client.pc->close();
 	}
 }
 
@@ -97,7 +600,7 @@ void Endpoint::broadcastMessage(string message) {
 				client->dc->send(message);
 
 		} catch (const std::exception &e) {
-			std::cerr << "Failed to send message: " << e.what() << std::endl;
+			RTCAST_LOG_ERROR << "Failed to send message: " << e.what();
 			client->pc->close();
 		}
 	}
@@ -112,7 +615,7 @@ void Endpoint::sendMessage(int id, string message) {
 				client->dc->send(message);
 
 		} catch (const std::exception &e) {
-			std::cerr << "Failed to send message: " << e.what() << std::endl;
+			RTCAST_LOG_ERROR << "Failed to send message: " << e.what();
 			client->pc->close();
 		}
 	}
@@ -133,18 +636,423 @@ unsigned int Endpoint::clientsCount() const {
 	return static_cast<unsigned int>(mClients.size());
 }
 
+void Endpoint::setHealthThresholds(HealthThresholds thresholds) {
+	mMaxQueuedFrames = thresholds.maxQueuedFrames;
+	mMaxFractionLost = thresholds.maxFractionLost;
+	mMaxRttUs = std::chrono::duration_cast<std::chrono::microseconds>(thresholds.maxRtt).count();
+}
+
+optional<Endpoint::ClientHealth> Endpoint::clientHealth(int id) {
+	std::shared_lock lock(mMutex);
+	auto it = mClients.find(id);
+	if (it == mClients.end())
+		return nullopt;
+
+	const auto &client = it->second;
+	const auto &health = client->videoHealth;
+	ClientHealth result;
+	result.queuedFrames = client->videoQueue ? client->videoQueue->size() : 0;
+	result.fractionLost = health.fractionLost.load(std::memory_order_relaxed);
+	if (int64_t rtt = health.rttUs.load(std::memory_order_relaxed); rtt >= 0)
+		result.rtt = std::chrono::microseconds(rtt);
+	result.skipping = health.skipping.load(std::memory_order_relaxed);
+	result.skips = health.skips.load(std::memory_order_relaxed);
+	result.withheldFrames = health.withheldFrames.load(std::memory_order_relaxed);
+	if (client->estimator) {
+		result.estimatedBitrate = client->estimator->estimate();
+		result.remb = client->estimator->remb();
+	}
+	result.rendition = client->rendition.load(std::memory_order_relaxed);
+	return result;
+}
+
+optional<Endpoint::ClientStats> Endpoint::clientStats(int id) {
+	shared_ptr<Client> client;
+	{
+		std::shared_lock lock(mMutex);
+		if (auto it = mClients.find(id); it != mClients.end())
+			client = it->second;
+	}
+
+	if (!client)
+		return nullopt;
+
+	return collectStats(*client);
+}
+
+std::vector<Endpoint::ClientStats> Endpoint::allStats() {
+	// Collect outside of the lock, querying the peer connection may block
+	std::vector<shared_ptr<Client>> clients;
+	{
+		std::shared_lock lock(mMutex);
+		clients.reserve(mClients.size());
+		for (const auto &[id, client] : mClients)
+			clients.push_back(client);
+	}
+
+	std::vector<ClientStats> result;
+	result.reserve(clients.size());
+	for (const auto &client : clients)
+		result.push_back(collectStats(*client));
+
+	return result;
+}
+
+Endpoint::ClientStats Endpoint::collectStats(Client &client) {
+	auto collect = [](const Transport &transport, rtc::Track &track) {
+		const auto &counters = *transport.counters;
+		TrackStats stats;
+		stats.packetsSent = counters.packets.load(std::memory_order_relaxed);
+		stats.bytesSent = counters.bytes.load(std::memory_order_relaxed);
+		stats.nacksReceived = counters.nacks.load(std::memory_order_relaxed);
+		stats.retransmissions = counters.retransmissions.load(std::memory_order_relaxed);
+		stats.retransmittedBytes = counters.retransmittedBytes.load(std::memory_order_relaxed);
+		stats.fractionLost = transport.fractionLost.load(std::memory_order_relaxed);
+		stats.cumulativeLost = transport.cumulativeLost.load(std::memory_order_relaxed);
+		if (int64_t rtt = transport.rttUs.load(std::memory_order_relaxed); rtt >= 0)
+			stats.rtt = std::chrono::microseconds(rtt);
+		stats.bufferedAmount = track.bufferedAmount();
+		return stats;
+	};
+
+	ClientStats stats;
+	stats.id = client.id;
+	stats.age = std::chrono::duration_cast<std::chrono::milliseconds>(
+	    std::chrono::steady_clock::now() - client.createdAt);
+	stats.connected = client.pc->state() == rtc::PeerConnection::State::Connected;
+
+	rtc::Candidate local, remote;
+	if (client.pc->getSelectedCandidatePair(&local, &remote)) {
+		stats.localCandidate = string(local);
+		stats.remoteCandidate = string(remote);
+	}
+
+	stats.transportBytesSent = client.pc->bytesSent();
+	stats.transportBytesReceived = client.pc->bytesReceived();
+
+	if (client.video && client.videoTransport)
+		stats.video = collect(*client.videoTransport, *client.video);
+	if (client.audio && client.audioTransport)
+		stats.audio = collect(*client.audioTransport, *client.audio);
+
+	return stats;
+}
+
+void Endpoint::onKeyframeRequest(keyframe_request_callback callback) {
+	std::lock_guard lock(mKeyframeRequestCallbackMutex);
+	mKeyframeRequestCallback = std::move(callback);
+}
+
+void Endpoint::setKeyframeOnJoin(bool enabled) { mKeyframeOnJoin = enabled; }
+
+void Endpoint::setGopCache(size_t maxBytes) {
+	mGopCacheSize = maxBytes;
+	for (auto &stream : mVideoStreams)
+		stream->gopCache.setMaxBytes(maxBytes);
+}
+
+void Endpoint::setPrimingBitrate(int64_t bitrate) {
+	if (bitrate <= 0)
+		throw std::invalid_argument("Invalid priming bitrate");
+
+	mPrimingBitrate = bitrate;
+}
+
+void Endpoint::setBitratePolicy(BitratePolicy policy, double percentile) {
+	mBitratePolicy = policy;
+	mBitratePercentile = percentile;
+}
+
+void Endpoint::setBitrateRange(int64_t minBitrate, int64_t maxBitrate) {
+	if (minBitrate <= 0 || maxBitrate < minBitrate)
+		throw std::invalid_argument("Invalid bitrate range");
+
+	mMinBitrate = minBitrate;
+	mMaxBitrate = maxBitrate;
+
+	std::shared_lock lock(mMutex);
+	for (const auto &[id, client] : mClients)
+		if (client->estimator)
+			client->estimator->setRange(minBitrate, maxBitrate);
+}
+
+void Endpoint::onTargetBitrate(target_bitrate_callback callback) {
+	std::lock_guard lock(mTargetBitrateMutex);
+	mTargetBitrateCallback = std::move(callback);
+}
+
+void Endpoint::onRenditionBitrate(rendition_bitrate_callback callback) {
+	std::lock_guard lock(mTargetBitrateMutex);
+	mRenditionBitrateCallback = std::move(callback);
+}
+
+void Endpoint::onAudioLoss(audio_loss_callback callback) {
+	std::lock_guard lock(mAudioLossMutex);
+	mAudioLossCallback = std::move(callback);
+}
+
+optional<int64_t> Endpoint::targetBitrate() const {
+	int64_t target = mTargetBitrate;
+	return target > 0 ? std::make_optional(target) : nullopt;
+}
+
+void Endpoint::updateTargetBitrate() {
+	auto now = std::chrono::steady_clock::now();
+	if (mBitratePolicy == BitratePolicy::PerRendition && mVideoStreams.size() > 1) {
+		updateRenditionBitrates(now);
+		return;
+	}
+
+	std::vector<int64_t> estimates;
+	{
+		std::shared_lock lock(mMutex);
+		for (const auto &[id, client] : mClients)
+			if (client->estimator && client->video && client->video->isOpen())
+				estimates.push_back(client->estimator->estimate(now));
+	}
+
+	if (estimates.empty())
+		return;
+
+	int64_t target = aggregate_bitrate(std::move(estimates), mBitratePolicy, mBitratePercentile);
+
+	std::lock_guard lock(mTargetBitrateMutex);
+	int64_t current = mTargetBitrate;
+	if (current > 0) {
+		// Do not reconfigure the encoder for small changes, and ramp up progressively
+		if (std::abs(target - current) < int64_t(double(current) * TargetBitrateHysteresis))
+			return;
+
+		if (target > current) {
+			if (now - mLastTargetIncrease < TargetIncreaseInterval)
+				return;
+
+			mLastTargetIncrease = now;
+		}
+	}
+
+	RTCAST_LOG_DEBUG << "Target video bitrate: " << target;
+	mTargetBitrate = target;
+	if (mTargetBitrateCallback)
+		mTargetBitrateCallback(target);
+}
+
+void Endpoint::updateRenditionBitrates(std::chrono::steady_clock::time_point now) {
+	std::vector<std::vector<int64_t>> estimates(mVideoStreams.size());
+	{
+		std::shared_lock lock(mMutex);
+		for (const auto &[id, client] : mClients)
+			if (client->estimator && client->video && client->video->isOpen())
+				estimates[client->rendition].push_back(client->estimator->estimate(now));
+	}
+
+	std::lock_guard lock(mTargetBitrateMutex);
+	for (size_t i = 0; i < estimates.size(); ++i) {
+		if (estimates[i].empty())
+			continue;
+
+		int64_t target = *std::min_element(estimates[i].begin(), estimates[i].end());
+		target = std::min(target, mVideoStreams[i]->bitrate);
+
+		// Same hysteresis as the single target
+		int64_t current = mRenditionTargets[i];
+		if (current > 0) {
+			if (std::abs(target - current) < int64_t(double(current) * TargetBitrateHysteresis))
+				continue;
+
+			if (target > current) {
+				if (now - mLastRenditionIncreases[i] < TargetIncreaseInterval)
+					continue;
+
+				mLastRenditionIncreases[i] = now;
+			}
+		}
+
+		RTCAST_LOG_DEBUG << "Target bitrate for rendition " << i << ": " << target;
+		mRenditionTargets[i] = target;
+		if (mRenditionBitrateCallback)
+			mRenditionBitrateCallback(static_cast<unsigned int>(i), target);
+	}
+}
+
+void Endpoint::updateAudioLoss() {
+	// The worst client sets the protection, as with the Min bitrate policy
+	double fractionLost = 0.;
+	{
+		std::shared_lock lock(mMutex);
+		for (const auto &[id, client] : mClients)
+			if (client->audioTransport && client->audio && client->audio->isOpen()) {
+				double lost = client->audioTransport->fractionLost.load(std::memory_order_relaxed);
+				fractionLost = std::max(fractionLost, lost);
+			}
+	}
+
+	std::lock_guard lock(mAudioLossMutex);
+	if (mAudioLossCallback)
+		mAudioLossCallback(fractionLost);
+}
+
+void Endpoint::negotiateAudio(Client &client) {
+	// Called with the remote description, before the track opens, so nothing is being sent yet
+	if (!client.audio || !client.audioConfig || mAudioCodec != AudioCodec::OPUS)
+		return;
+
+	auto description = client.pc->remoteDescription();
+	if (!description)
+		return;
+
+	for (int i = 0; i < description->mediaCount(); ++i) {
+		auto entry = description->media(i);
+		auto media = std::get_if<rtc::Description::Media *>(&entry);
+		if (!media || (*media)->mid() != client.audio->mid())
+			continue;
+
+		// Payload types as negotiated, in case the client remapped them
+		auto opus = sdp::FindPayloadType(**media, "opus");
+		if (!opus)
+			return;
+
+		client.opusPayloadType = *opus;
+		client.audioConfig->payloadType = uint8_t(*opus);
+
+		if (mAudioRedundancy == 0)
+			return;
+
+		if (auto red = sdp::FindPayloadType(**media, "red")) {
+			RTCAST_LOG_DEBUG << "Client " << client.id << " accepted redundant audio";
+			client.audioConfig->payloadType = uint8_t(*red);
+			client.audioRed = true;
+		}
+		return;
+	}
+}
+
+void Endpoint::selectRendition(Client &client) {
+	const auto count = static_cast<unsigned int>(mVideoStreams.size());
+	if (count <= 1)
+		return;
+
+	unsigned int target;
+	if (int requested = client.requestedRendition; requested >= 0) {
+		target = std::min(static_cast<unsigned int>(requested), count - 1);
+
+	} else if (client.estimator) {
+		// Highest rendition fitting in the estimate, switching up only with a margin
+		int64_t estimate = client.estimator->estimate();
+		unsigned int current = client.targetRendition;
+		target = count - 1;
+		for (unsigned int i = 0; i < count; ++i) {
+			double margin = i < current ? 1. + RenditionUpgradeMargin : 1.;
+			if (double(estimate) >= double(mVideoStreams[i]->bitrate) * margin) {
+				target = i;
+				break;
+			}
+		}
+
+	} else {
+		return;
+	}
+
+	if (client.targetRendition.exchange(target) != target && client.video &&
+	    client.video->isOpen()) {
+		RTCAST_LOG_INFO << "Client " << client.id << " rendition: " << target;
+		requestKeyframe(client);
+	}
+}
+
+bool Endpoint::handleControlMessage(Client &client, const string &message) {
+	if (message.empty() || message.front() != '{')
+		return false;
+
+	json parsed = json::parse(message, nullptr, false);
+	if (!parsed.is_object() || parsed.value("type", "") != "rendition")
+		return false;
+
+	const auto &rendition = parsed["rendition"];
+	if (rendition.is_number_unsigned() && rendition.get<uint64_t>() < mVideoStreams.size())
+		client.requestedRendition = int(rendition.get<uint64_t>());
+	else if (rendition.is_string() && rendition.get<string>() == "auto")
+		client.requestedRendition = -1;
+	else
+		return true; // invalid request, not forwarded either
+
+	selectRendition(client);
+	return true;
+}
+
+bool Endpoint::isCongested(Client &client, bool countDrops) {
+	auto &health = client.videoHealth;
+	bool congested = false;
+
+	if (client.videoQueue) {
+		auto stats = client.videoQueue->stats();
+		uint64_t dropped = stats.droppedNewest + stats.droppedOldest + stats.droppedDeadline;
+		if (countDrops && dropped != health.lastDropped)
+			congested = true; // a frame is missing
+
+		health.lastDropped = dropped;
+
+		if (client.videoQueue->size() > mMaxQueuedFrames)
+			congested = true;
+	}
+
+	if (health.fractionLost > mMaxFractionLost)
+		congested = true;
+
+	if (int64_t rtt = health.rttUs; rtt >= 0 && rtt > mMaxRttUs)
+		congested = true;
+
+	return congested;
+}
+
+void Endpoint::requestKeyframe(Client &client) {
+	std::lock_guard lock(mKeyframeRequestCallbackMutex);
+	if (mKeyframeRequestCallback)
+		mKeyframeRequestCallback(client.id, client.targetRendition);
+}
+
+Endpoint::Stats Endpoint::stats() const {
+	Stats stats;
+	stats.video = mVideoLatency.stats();
+	stats.audio = mAudioLatency.stats();
+	stats.timeToFirstFrame = mTimeToFirstFrame.summary();
+	for (const auto &stream : mVideoStreams) {
+		auto cache = stream->gopCache.stats();
+		stats.gopCache.frames += cache.frames;
+		stats.gopCache.bytes += cache.bytes;
+		stats.gopCache.overflows += cache.overflows;
+	}
+	stats.primedClients = mPrimedClients.load(std::memory_order_relaxed);
+	return stats;
+}
+
+void Endpoint::resetStats() {
+	mVideoLatency.reset();
+	mAudioLatency.reset();
+	mTimeToFirstFrame.reset();
+	mPrimedClients = 0;
+}
+
 int Endpoint::connect(shared_ptr<rtc::WebSocket> ws) {
 	int id = mNextClientId++;
 	auto client = std::make_shared<Client>();
+	client->id = id;
+	client->createdAt = std::chrono::steady_clock::now();
 	auto wclient = weak_ptr<Client>(client);
 
 	rtc::Configuration config;
-	config.iceServers.emplace_back("stun:stun.l.google.com:19302");
+	{
+		std::lock_guard lock(mIceSettingsMutex);
+		for (const auto &server : mIceSettings.servers)
+			config.iceServers.emplace_back(server);
+
+		config.bindAddress = mIceSettings.bindAddress;
+	}
 	config.disableAutoNegotiation = true;
 	client->pc = std::make_shared<rtc::PeerConnection>(std::move(config));
 
 	client->pc->onStateChange([this, id, wclient](rtc::PeerConnection::State state) {
-		std::cout << "State: " << state << std::endl;
+		RTCAST_LOG_INFO << "Client " << id << " state: " << state;
 		using State = rtc::PeerConnection::State;
 		switch (state) {
 		case State::Disconnected:
@@ -160,8 +1068,8 @@ int Endpoint::connect(shared_ptr<rtc::WebSocket> ws) {
 		}
 	});
 
-	client->pc->onGatheringStateChange([](rtc::PeerConnection::GatheringState state) {
-		std::cout << "Gathering State: " << state << std::endl;
+	client->pc->onGatheringStateChange([id](rtc::PeerConnection::GatheringState state) {
+		RTCAST_LOG_DEBUG << "Client " << id << " gathering state: " << state;
 	});
 
 	client->pc->onLocalDescription([ws](rtc::Description description) {
@@ -177,9 +1085,12 @@ int Endpoint::connect(shared_ptr<rtc::WebSocket> ws) {
 
 	client->dc = client->pc->createDataChannel("default");
 
-	client->dc->onMessage([this, id](auto data) {
+	client->dc->onMessage([this, id, wclient](auto data) {
 		if (std::holds_alternative<string>(data)) {
 			auto str = std::get<string>(data);
+			if (auto client = wclient.lock(); client && handleControlMessage(*client, str))
+				return;
+
 			std::lock_guard lock(mMessageCallbackMutex);
 			if (mMessageCallback)
 				mMessageCallback(id, std::move(str));
@@ -187,7 +1098,7 @@ int Endpoint::connect(shared_ptr<rtc::WebSocket> ws) {
 	});
 
 	ws->onOpen([this, id, wclient]() {
-		std::cout << "WebSocket connected" << std::endl;
+		RTCAST_LOG_INFO << "WebSocket connected, client " << id;
 		auto client = wclient.lock();
 		if (!client)
 			return;
@@ -199,7 +1110,7 @@ int Endpoint::connect(shared_ptr<rtc::WebSocket> ws) {
 		if (mVideoCodec != VideoCodec::None) {
 			const string videoMid = "video";
 			const string videoName = "video-stream";
-			const int videoPayloadType = 96;
+			const int videoPayloadType = VideoPayloadType;
 			const uint32_t videoSsrc = dist32(gen);
 
 			const auto direction = mReceiveVideo ? rtc::Description::Direction::SendRecv
@@ -240,9 +1151,16 @@ int Endpoint::connect(shared_ptr<rtc::WebSocket> ws) {
 			}
 
 			auto track = client->pc->addTrack(std::move(description));
-			track->chainMediaHandler(packetizer);
+			const auto &sharedPacketizer = mVideoStreams.front()->packetizer;
+			if (mSharedPacketization && sharedPacketizer)
+				client->videoSession = sharedPacketizer->createSession(packetizerConfig);
+			else
+				track->chainMediaHandler(packetizer);
+
+			client->videoTransport = std::make_shared<Transport>();
 			track->chainMediaHandler(std::make_shared<rtc::RtcpSrReporter>(packetizerConfig));
-			track->chainMediaHandler(std::make_shared<rtc::RtcpNackResponder>());
+			track->chainMediaHandler(
+			    std::make_shared<NackResponder>(videoSsrc, client->videoTransport->counters));
 			if (mReceiveVideo) {
 				switch (mVideoCodec) {
 				case VideoCodec::H264:
@@ -271,24 +1189,93 @@ int Endpoint::connect(shared_ptr<rtc::WebSocket> ws) {
 				});
 			}
 
+			int64_t startBitrate = mTargetBitrate > 0 ? mTargetBitrate.load() : mMaxBitrate.load();
+			client->estimator =
+			    std::make_shared<BandwidthEstimator>(mMinBitrate, mMaxBitrate, startBitrate);
+
+			RtcpObserver::Callbacks callbacks;
+			callbacks.receiverReport = [this, wclient](const RtcpObserver::ReceiverReport &report) {
+				if (auto client = wclient.lock()) {
+					client->videoTransport->onReceiverReport(report);
+					client->videoHealth.fractionLost = report.fractionLost;
+					if (report.rtt)
+						client->videoHealth.rttUs = report.rtt->count();
+
+					client->estimator->onReceiverReport(report.fractionLost, report.rtt,
+					                                    std::chrono::steady_clock::now());
+					selectRendition(*client);
+					updateTargetBitrate();
+				}
+			};
+			callbacks.remb = [this, wclient](int64_t bitrate) {
+				if (auto client = wclient.lock()) {
+					client->estimator->onRemb(bitrate, std::chrono::steady_clock::now());
+					selectRendition(*client);
+					updateTargetBitrate();
+				}
+			};
+			callbacks.keyframeRequest = [this, wclient]() {
+				if (auto client = wclient.lock())
+					requestKeyframe(*client);
+			};
+			track->chainMediaHandler(
+			    std::make_shared<RtcpObserver>(videoSsrc, std::move(callbacks)));
+
+			// Start on the rendition fitting the initial estimate
+			selectRendition(*client);
+			client->rendition = client->targetRendition.load();
+
+			// Inter frames are withheld until the first keyframe, unless primed from the cache
+			client->videoHealth.skipping = true;
+			track->onOpen([this, wclient]() {
+				auto client = wclient.lock();
+				if (!client)
+					return;
+
+				auto &health = client->videoHealth;
+				health.openedAtUs = steady_microseconds(std::chrono::steady_clock::now());
+				if (mVideoStreams[client->rendition]->gopCache.stats().frames > 0) {
+					health.priming = true;
+					health.skipping = false;
+
+				} else if (mKeyframeOnJoin) {
+					requestKeyframe(*client);
+				}
+			});
+
 			client->video = std::move(track);
+			client->videoQueue = mSendPool->createQueue(
+			    [this, wclient](const SendPool::Item &item, SendPool::clock::time_point queued) {
+				    if (auto client = wclient.lock())
+					    sendVideo(*client, item, queued);
+			    },
+			    mSendQueueCapacity, mSendQueuePolicy);
 		}
 
 		if (mAudioCodec != AudioCodec::None) {
 			const string audioMid = "audio";
 			const string audioName = "audio-stream";
-			const int audioPayloadType = 97;
+			const int audioPayloadType = AudioPayloadType;
 			const uint32_t audioSsrc = dist32(gen);
 
 			const auto direction = mReceiveAudio ? rtc::Description::Direction::SendRecv
 			                                     : rtc::Description::Direction::SendOnly;
 
+			const auto audioFrameDuration = std::chrono::microseconds(mAudioFrameDurationUs.load());
+			const unsigned int redundancy =
+			    mAudioCodec == AudioCodec::OPUS ? mAudioRedundancy.load() : 0;
+
 			rtc::Description::Audio description(audioMid, direction);
 			description.addSSRC(audioSsrc, audioName);
 
+			// Listed first so that clients also send RED if they support it
+			if (redundancy > 0)
+				description.addAudioCodec(RedPayloadType, "red/48000/2",
+				                          RedEncoder::Profile(audioPayloadType, redundancy));
+
 			switch (mAudioCodec) {
 			case AudioCodec::OPUS:
-				description.addOpusCodec(audioPayloadType);
+				description.addOpusCodec(audioPayloadType, opus_profile(audioFrameDuration));
 				break;
 			case AudioCodec::PCMU:
 				description.addPCMUCodec(audioPayloadType);
@@ -303,6 +1290,10 @@ int Endpoint::connect(shared_ptr<rtc::WebSocket> ws) {
 				throw std::logic_error("Unknown audio codec");
 			}
 
+			// One frame per packet, also asks the client to send packets no longer than ours
+			description.addAttribute("ptime:" + format_milliseconds(audioFrameDuration));
+			description.addAttribute("maxptime:" + format_milliseconds(audioFrameDuration));
+
 			auto track = client->pc->addTrack(std::move(description));
 
 			auto packetizerConfig = std::make_shared<rtc::RtpPacketizationConfig>(
@@ -315,14 +1306,19 @@ int Endpoint::connect(shared_ptr<rtc::WebSocket> ws) {
 				track->chainMediaHandler(
 				    std::make_shared<rtc::AudioRtpPacketizer<48000>>(packetizerConfig));
 
+			client->audioTransport = std::make_shared<Transport>();
 			track->chainMediaHandler(std::make_shared<rtc::RtcpSrReporter>(packetizerConfig));
-			track->chainMediaHandler(std::make_shared<rtc::RtcpNackResponder>());
+			track->chainMediaHandler(
+			    std::make_shared<NackResponder>(audioSsrc, client->audioTransport->counters));
 			if (mReceiveAudio) {
 				if (mAudioCodec == AudioCodec::PCMU || mAudioCodec == AudioCodec::PCMA)
 					track->chainMediaHandler(std::make_shared<rtc::RtpDepacketizer>(8000));
 				else
 					track->chainMediaHandler(std::make_shared<rtc::RtpDepacketizer>(48000));
 
+				if (redundancy > 0)
+					track->chainMediaHandler(std::make_shared<RedDepacketizer>(RedPayloadType));
+
 				std::lock_guard lock(mDecoderCallbackMutex);
 				auto decoder = mAudioDecoderCallback ? mAudioDecoderCallback(id) : nullptr;
 
@@ -332,17 +1328,35 @@ int Endpoint::connect(shared_ptr<rtc::WebSocket> ws) {
 				});
 			}
 
+			RtcpObserver::Callbacks callbacks;
+			callbacks.receiverReport = [this, transport = client->audioTransport](
+			                               const RtcpObserver::ReceiverReport &report) {
+				transport->onReceiverReport(report);
+				updateAudioLoss();
+			};
+			track->chainMediaHandler(
+			    std::make_shared<RtcpObserver>(audioSsrc, std::move(callbacks)));
+
 			client->audio = std::move(track);
+			client->audioConfig = std::move(packetizerConfig);
+			client->audioQueue = mSendPool->createQueue(
+			    [this, wclient](const SendPool::Item &item, SendPool::clock::time_point queued) {
+				    if (auto client = wclient.lock())
+					    sendAudio(*client, item, queued);
+			    },
+			    mSendQueueCapacity, mSendQueuePolicy);
 		}
 
 		client->pc->setLocalDescription();
 	});
 
-	ws->onClosed([]() { std::cout << "WebSocket closed" << std::endl; });
+	ws->onClosed([id]() { RTCAST_LOG_INFO << "WebSocket closed, client " << id; });
 
-	ws->onError([](string error) { std::cout << "WebSocket failed: " << error << std::endl; });
+	ws->onError([id](string error) {
+		RTCAST_LOG_WARNING << "WebSocket failed, client " << id << ": " << error;
+	});
 
-	ws->onMessage([wclient](auto data) {
+	ws->onMessage([this, wclient](auto data) {
 		auto client = wclient.lock();
 		if (!client)
 			return;
@@ -353,6 +1367,7 @@ int Endpoint::connect(shared_ptr<rtc::WebSocket> ws) {
 			if (type == "offer" || type == "answer") {
 				auto sdp = message["description"].get<string>();
 				client->pc->setRemoteDescription(rtc::Description(sdp, type));
+				negotiateAudio(*client);
 			} else if (type == "candidate") {
 				auto sdp = message["candidate"].get<string>();
 				auto mid = message["mid"].get<string>();
@@ -368,7 +1383,15 @@ int Endpoint::connect(shared_ptr<rtc::WebSocket> ws) {
 
 void Endpoint::remove(int id) {
 	std::unique_lock lock(mMutex);
-	mClients.erase(id);
+	if (auto it = mClients.find(id); it != mClients.end()) {
+		const auto &client = it->second;
+		if (client->videoQueue)
+			client->videoQueue->close();
+		if (client->audioQueue)
+			client->audioQueue->close();
+
+		mClients.erase(it);
+	}
 }
 
 } // namespace rtcast
@@ -0,0 +1,271 @@
+/**
+ * Copyright (c) 2025 Paul-Louis Ageneau
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+#include "frameconverter.hpp"
+#include "pixelconvert.hpp"
+
+extern "C" {
+#include <libavutil/opt.h>
+#include <libavutil/pixdesc.h>
+}
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace rtcast {
+
+namespace {
+
+const int SwsFlags = SWS_FAST_BILINEAR | SWS_FULL_CHR_H_INT | SWS_ACCURATE_RND;
+
+// Threaded scaling was introduced with sws_scale_frame() in FFmpeg 5.0
+#if LIBSWSCALE_VERSION_INT >= AV_VERSION_INT(6, 1, 100)
+#define RTCAST_HAS_THREADED_SWS 1
+#else
+#define RTCAST_HAS_THREADED_SWS 0
+#endif
+
+SwsContext *create_context(int srcWidth, int srcHeight, AVPixelFormat srcFormat, int dstWidth,
+                           int dstHeight, AVPixelFormat dstFormat,
+                           [[maybe_unused]] unsigned int threads) {
+#if RTCAST_HAS_THREADED_SWS
+	if (threads > 1) {
+		SwsContext *context = sws_alloc_context();
+		if (!context)
+			return nullptr;
+
+		av_opt_set_int(context, "srcw", srcWidth, 0);
+		av_opt_set_int(context, "srch", srcHeight, 0);
+		av_opt_set_int(context, "src_format", srcFormat, 0);
+		av_opt_set_int(context, "dstw", dstWidth, 0);
+		av_opt_set_int(context, "dsth", dstHeight, 0);
+		av_opt_set_int(context, "dst_format", dstFormat, 0);
+		av_opt_set_int(context, "sws_flags", SwsFlags, 0);
+		av_opt_set_int(context, "threads", threads, 0);
+		if (sws_init_context(context, nullptr, nullptr) < 0) {
+			sws_freeContext(context);
+			return nullptr;
+		}
+		return context;
+	}
+#endif
+	return sws_getContext(srcWidth, srcHeight, srcFormat, dstWidth, dstHeight, dstFormat,
+	                      SwsFlags, nullptr, nullptr, nullptr);
+}
+
+// Full range (JPEG) input must be compressed for limited range (MPEG) output
+bool compresses_range(AVColorRange input, AVColorRange output) {
+	return input == AVCOL_RANGE_JPEG && output == AVCOL_RANGE_MPEG;
+}
+
+void set_range(SwsContext *context, bool compress) {
+	if (!compress)
+		return;
+
+	const int *coefficients = sws_getCoefficients(SWS_CS_DEFAULT);
+	sws_setColorspaceDetails(context, coefficients, 1, coefficients, 0, 0, 1 << 16, 1 << 16);
+}
+
+// Rows of a slice must start on a chroma row for both formats
+int slice_alignment(AVPixelFormat a, AVPixelFormat b) {
+	const AVPixFmtDescriptor *descA = av_pix_fmt_desc_get(a);
+	const AVPixFmtDescriptor *descB = av_pix_fmt_desc_get(b);
+	if (!descA || !descB)
+		return 0;
+
+	return 1 << std::max(descA->log2_chroma_h, descB->log2_chroma_h);
+}
+
+// Offsets of the first row of a slice in each plane, chroma planes are subsampled vertically
+void slice_offsets(const AVFrame *frame, int row, ptrdiff_t offsets[AV_NUM_DATA_POINTERS]) {
+	const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(AVPixelFormat(frame->format));
+	for (int i = 0; i < AV_NUM_DATA_POINTERS; ++i) {
+		bool chroma = i == 1 || i == 2;
+		int planeRow = chroma ? row >> desc->log2_chroma_h : row;
+		offsets[i] = frame->data[i] ? ptrdiff_t(planeRow) * frame->linesize[i] : 0;
+	}
+}
+
+} // namespace
+
+bool FrameConverter::Geometry::operator==(const Geometry &other) const {
+	return width == other.width && height == other.height && pixelFormat == other.pixelFormat &&
+	       range == other.range;
+}
+
+FrameConverter::FrameConverter(unsigned int threads) : mThreadsCount(std::max(threads, 1u)) {
+	// The calling thread converts a slice too
+	for (unsigned int i = 1; i < mThreadsCount; ++i)
+		mThreads.emplace_back(std::bind(&FrameConverter::run, this));
+}
+
+FrameConverter::~FrameConverter() {
+	{
+		std::lock_guard lock(mMutex);
+		mStopping = true;
+	}
+	mCondition.notify_all();
+	for (auto &thread : mThreads)
+		thread.join();
+}
+
+void FrameConverter::convert(const AVFrame *input, AVFrame *output) {
+	Geometry inputGeometry{input->width, input->height, AVPixelFormat(input->format),
+	                       input->color_range};
+	Geometry outputGeometry{output->width, output->height, AVPixelFormat(output->format),
+	                        output->color_range};
+	if ((!mContext && mSlices.empty()) || inputGeometry != mInputGeometry ||
+	    outputGeometry != mOutputGeometry)
+		configure(inputGeometry, outputGeometry);
+
+	if (mContext) {
+#if RTCAST_HAS_THREADED_SWS
+		int ret = mThreadsCount > 1 ? sws_scale_frame(mContext.get(), output, input)
+		                            : sws_scale(mContext.get(), input->data, input->linesize, 0,
+		                                        input->height, output->data, output->linesize);
+#else
+		int ret = sws_scale(mContext.get(), input->data, input->linesize, 0, input->height,
+		                    output->data, output->linesize);
+#endif
+		if (ret < 0)
+			throw std::runtime_error("Video frame conversion failed");
+
+		return;
+	}
+
+	{
+		std::lock_guard lock(mMutex);
+		mInput = input;
+		mOutput = output;
+		mNextSlice = 1;
+		mPendingSlices = mSlices.size() - 1;
+		mError = nullptr;
+	}
+	mCondition.notify_all();
+
+	std::exception_ptr error;
+	try {
+		convertSlice(mSlices.front());
+	} catch (...) {
+		error = std::current_exception();
+	}
+
+	std::unique_lock lock(mMutex);
+	mDoneCondition.wait(lock, [this]() { return mPendingSlices == 0; });
+	mInput = nullptr;
+	mOutput = nullptr;
+	if (!error)
+		error = mError;
+
+	if (error)
+		std::rethrow_exception(error);
+}
+
+void FrameConverter::configure(Geometry input, Geometry output) {
+	// Workers are idle between conversions
+	std::lock_guard lock(mMutex);
+	mContext.reset();
+	mSlices.clear();
+	mInputGeometry = input;
+	mOutputGeometry = output;
+
+	bool compress = compresses_range(input.range, output.range);
+	bool sameSize = input.width == output.width && input.height == output.height;
+	bool kernel = sameSize && output.pixelFormat == AV_PIX_FMT_YUV420P &&
+	              pixel::HasI420Kernel(input.pixelFormat, input.width, input.height);
+	int alignment = kernel ? 2 : slice_alignment(input.pixelFormat, output.pixelFormat);
+	bool sliced = kernel || (mThreadsCount > 1 && alignment > 0 && sameSize);
+	if (!sliced) {
+		mContext = unique_ptr_deleter<SwsContext>(
+		    create_context(input.width, input.height, input.pixelFormat, output.width,
+		                   output.height, output.pixelFormat, mThreadsCount),
+		    sws_freeContext);
+		if (!mContext)
+			throw std::runtime_error("Failed to get SWS context");
+
+		set_range(mContext.get(), compress);
+		return;
+	}
+
+	// Without scaling, rows are converted independently
+	int rows = (input.height + alignment - 1) / alignment;
+	int count = std::min(int(mThreadsCount), rows);
+	int begin = 0;
+	for (int i = 0; i < count; ++i) {
+		int end = i + 1 == count ? input.height : (rows * (i + 1) / count) * alignment;
+		Slice slice;
+		slice.begin = begin;
+		slice.height = end - begin;
+		if (!kernel) {
+			slice.context = unique_ptr_deleter<SwsContext>(
+			    sws_getContext(input.width, slice.height, input.pixelFormat, output.width,
+			                   slice.height, output.pixelFormat, SwsFlags, nullptr, nullptr,
+			                   nullptr),
+			    sws_freeContext);
+			if (!slice.context)
+				throw std::runtime_error("Failed to get SWS context");
+
+			set_range(slice.context.get(), compress);
+		}
+
+		mSlices.push_back(std::move(slice));
+		begin = end;
+	}
+}
+
+void FrameConverter::convertSlice(const Slice &slice) {
+	if (!slice.context) {
+		pixel::ConvertToI420(mInput, mOutput, slice.begin, slice.begin + slice.height);
+		return;
+	}
+
+	ptrdiff_t srcOffsets[AV_NUM_DATA_POINTERS];
+	ptrdiff_t dstOffsets[AV_NUM_DATA_POINTERS];
+	slice_offsets(mInput, slice.begin, srcOffsets);
+	slice_offsets(mOutput, slice.begin, dstOffsets);
+
+	const uint8_t *src[AV_NUM_DATA_POINTERS];
+	uint8_t *dst[AV_NUM_DATA_POINTERS];
+	for (int i = 0; i < AV_NUM_DATA_POINTERS; ++i) {
+		src[i] = mInput->data[i] ? mInput->data[i] + srcOffsets[i] : nullptr;
+		dst[i] = mOutput->data[i] ? mOutput->data[i] + dstOffsets[i] : nullptr;
+	}
+
+	int ret = sws_scale(slice.context.get(), src, mInput->linesize, 0, slice.height, dst,
+	                    mOutput->linesize);
+	if (ret < 0)
+		throw std::runtime_error("Video frame conversion failed");
+}
+
+void FrameConverter::run() {
+	std::unique_lock lock(mMutex);
+	while (true) {
+		mCondition.wait(lock,
+		                [this]() { return mStopping || (mInput && mNextSlice < mSlices.size()); });
+		if (mStopping)
+			return;
+
+		const Slice &slice = mSlices[mNextSlice++];
+		lock.unlock();
+		std::exception_ptr error;
+		try {
+			convertSlice(slice);
+		} catch (...) {
+			error = std::current_exception();
+		}
+		lock.lock();
+
+		if (error && !mError)
+			mError = error;
+
+		if (--mPendingSlices == 0)
+			mDoneCondition.notify_all();
+	}
+}
+
+} // namespace rtcast
@@ -0,0 +1,283 @@
+/**
+ * Copyright (c) 2025 Paul-Louis Ageneau
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+#include "framepool.hpp"
+
+extern "C" {
+#include <libavutil/imgutils.h>
+#include <libavutil/mem.h>
+}
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#endif
+
+#include <stdexcept>
+
+namespace rtcast {
+
+namespace {
+
+const size_t MaxRecycledFrames = 32;
+const int LinesizeAlign = 64;
+const size_t BufferPadding = 64;  // allow SIMD code to over-read the end of planes
+const size_t HugePageSize = 2 << 20; // 2 MiB
+
+size_t align_size(size_t size, size_t align) { return (size + align - 1) / align * align; }
+
+} // namespace
+
+extern "C" {
+
+#ifndef _WIN32
+static void free_buffer_munmap(void *opaque, uint8_t *data) {
+	::munmap(data, reinterpret_cast<size_t>(opaque));
+}
+#endif
+}
+
+FramePool::Stats FramePool::Counters::stats() const {
+	Stats stats;
+	uint64_t req = requests.load(std::memory_order_relaxed);
+	stats.misses = misses.load(std::memory_order_relaxed);
+	stats.hits = req > stats.misses ? req - stats.misses : 0;
+	stats.allocatedBytes = allocatedBytes.load(std::memory_order_relaxed);
+	stats.hugePageBytes = hugePageBytes.load(std::memory_order_relaxed);
+	return stats;
+}
+
+bool FramePool::VideoFormat::operator==(const VideoFormat &other) const {
+	return width == other.width && height == other.height && pixelFormat == other.pixelFormat;
+}
+
+bool FramePool::AudioFormat::operator==(const AudioFormat &other) const {
+	return sampleFormat == other.sampleFormat && sampleRate == other.sampleRate &&
+	       nbChannels == other.nbChannels && nbSamples == other.nbSamples;
+}
+
+shared_ptr<FramePool> FramePool::Create(shared_ptr<Counters> counters) {
+	return shared_ptr<FramePool>(new FramePool(std::move(counters), false));
+}
+
+shared_ptr<FramePool> FramePool::Create(VideoFormat format, bool hugePages,
+                                        shared_ptr<Counters> counters) {
+	if (format.width <= 0 || format.height <= 0)
+		throw std::invalid_argument("Invalid frame pool video size");
+
+	auto pool = shared_ptr<FramePool>(new FramePool(std::move(counters), hugePages));
+
+	if (av_image_fill_linesizes(pool->mLinesize, format.pixelFormat, format.width) < 0)
+		throw std::runtime_error("Failed to compute linesizes for frame pool");
+
+	ptrdiff_t linesizes[4] = {};
+	for (int i = 0; i < 4; ++i) {
+		pool->mLinesize[i] = int(align_size(pool->mLinesize[i], LinesizeAlign));
+		linesizes[i] = pool->mLinesize[i];
+	}
+
+	size_t sizes[4] = {};
+	if (av_image_fill_plane_sizes(sizes, format.pixelFormat, format.height, linesizes) < 0)
+		throw std::runtime_error("Failed to compute plane sizes for frame pool");
+
+	int count = 0;
+	while (count < 4 && sizes[count] > 0)
+		++count;
+
+	pool->initPools(sizes, count);
+	pool->mVideoFormat.emplace(std::move(format));
+	return pool;
+}
+
+shared_ptr<FramePool> FramePool::Create(AudioFormat format, bool hugePages,
+                                        shared_ptr<Counters> counters) {
+	if (format.nbChannels <= 0 || format.nbSamples <= 0)
+		throw std::invalid_argument("Invalid frame pool audio format");
+
+	if (av_sample_fmt_is_planar(format.sampleFormat) && format.nbChannels > AV_NUM_DATA_POINTERS)
+		throw std::invalid_argument("Too many channels for frame pool");
+
+	auto pool = shared_ptr<FramePool>(new FramePool(std::move(counters), hugePages));
+
+	int linesize = 0;
+	if (av_samples_get_buffer_size(&linesize, format.nbChannels, format.nbSamples,
+	                               format.sampleFormat, 0) < 0)
+		throw std::runtime_error("Failed to compute sample buffer size for frame pool");
+
+	pool->mLinesize[0] = linesize;
+
+	int count = av_sample_fmt_is_planar(format.sampleFormat) ? format.nbChannels : 1;
+	std::vector<size_t> sizes(count, size_t(linesize));
+	pool->initPools(sizes.data(), count);
+	pool->mAudioFormat.emplace(std::move(format));
+	return pool;
+}
+
+FramePool::FramePool(shared_ptr<Counters> counters, bool hugePages)
+    : mCounters(counters ? std::move(counters) : std::make_shared<Counters>()),
+      mHugePages(hugePages) {}
+
+FramePool::~FramePool() {
+	for (AVFrame *frame : mFrames)
+		av_frame_free(&frame);
+}
+
+void FramePool::initPools(const size_t *sizes, int count) {
+	for (int i = 0; i < count; ++i) {
+		auto bufferPool = unique_ptr_deleter<AVBufferPool>(
+		    av_buffer_pool_init2(sizes[i] + BufferPadding, this, PoolAlloc, nullptr),
+		    [](AVBufferPool *p) { av_buffer_pool_uninit(&p); });
+		if (!bufferPool)
+			throw std::runtime_error("Failed to initialize buffer pool");
+
+		mBufferPools.push_back(std::move(bufferPool));
+	}
+}
+
+AVBufferRef *FramePool::PoolAlloc(void *opaque, size_t size) {
+	// Only called from av_buffer_pool_get(), therefore while the FramePool is alive
+	return static_cast<FramePool *>(opaque)->alloc(size);
+}
+
+AVBufferRef *FramePool::alloc(size_t size) {
+	mCounters->misses.fetch_add(1, std::memory_order_relaxed);
+	mCounters->allocatedBytes.fetch_add(size, std::memory_order_relaxed);
+
+#ifndef _WIN32
+	if (mHugePages) {
+		size_t len = align_size(size, HugePageSize);
+		void *mem = ::mmap(NULL, len, PROT_READ | PROT_WRITE,
+		                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+		if (mem == MAP_FAILED) {
+			// No reserved huge pages, fall back to transparent huge pages
+			mem = ::mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+#ifdef MADV_HUGEPAGE
+			if (mem != MAP_FAILED)
+				::madvise(mem, len, MADV_HUGEPAGE);
+#endif
+		}
+
+		if (mem != MAP_FAILED) {
+			AVBufferRef *buf = av_buffer_create(static_cast<uint8_t *>(mem), size,
+			                                    free_buffer_munmap,
+			                                    reinterpret_cast<void *>(len), 0);
+			if (buf) {
+				mCounters->hugePageBytes.fetch_add(len, std::memory_order_relaxed);
+				return buf;
+			}
+
+			::munmap(mem, len);
+		}
+	}
+#endif
+
+	return av_buffer_alloc(size);
+}
+
+shared_ptr<AVFrame> FramePool::get() {
+	if (mBufferPools.empty())
+		throw std::logic_error("Frame pool has no buffer format");
+
+	auto frame = getEmpty();
+	fill(frame.get());
+	return frame;
+}
+
+shared_ptr<AVFrame> FramePool::getReusable() {
+	if (mBufferPools.empty())
+		throw std::logic_error("Frame pool has no buffer format");
+
+	mCounters->requests.fetch_add(1, std::memory_order_relaxed);
+	for (const auto &frame : mReusableFrames) {
+		if (frame.use_count() != 1)
+			continue;
+
+		bool released = true;
+		for (int i = 0; i < AV_NUM_DATA_POINTERS && frame->buf[i]; ++i)
+			released = released && av_buffer_is_writable(frame->buf[i]);
+
+		if (released) {
+			std::atomic_thread_fence(std::memory_order_acquire); // pairs with the release
+			return frame;
+		}
+	}
+
+	mCounters->misses.fetch_add(1, std::memory_order_relaxed);
+	auto frame = shared_ptr<AVFrame>(av_frame_alloc(), [](AVFrame *p) { av_frame_free(&p); });
+	if (!frame)
+		throw std::runtime_error("Failed to allocate AVFrame");
+
+	fill(frame.get());
+	mReusableFrames.push_back(frame);
+	return frame;
+}
+
+void FramePool::fill(AVFrame *frame) {
+	// Not a request on its own, get() and getReusable() count theirs
+	for (size_t i = 0; i < mBufferPools.size(); ++i) {
+		frame->buf[i] = av_buffer_pool_get(mBufferPools[i].get());
+		if (!frame->buf[i])
+			throw std::runtime_error("Failed to get buffer from pool");
+
+		frame->data[i] = frame->buf[i]->data;
+	}
+
+	if (mVideoFormat) {
+		frame->format = mVideoFormat->pixelFormat;
+		frame->width = mVideoFormat->width;
+		frame->height = mVideoFormat->height;
+		for (int i = 0; i < 4; ++i)
+			frame->linesize[i] = mLinesize[i];
+
+	} else if (mAudioFormat) {
+		frame->format = mAudioFormat->sampleFormat;
+		frame->sample_rate = mAudioFormat->sampleRate;
+		frame->nb_samples = mAudioFormat->nbSamples;
+		av_channel_layout_default(&frame->ch_layout, mAudioFormat->nbChannels);
+		frame->linesize[0] = mLinesize[0];
+		frame->extended_data = frame->data;
+	}
+}
+
+shared_ptr<AVFrame> FramePool::getEmpty() {
+	AVFrame *frame = takeFrame();
+	if (!frame)
+		throw std::runtime_error("Failed to allocate AVFrame");
+
+	return shared_ptr<AVFrame>(frame, [self = shared_from_this()](AVFrame *p) {
+		self->recycleFrame(p);
+	});
+}
+
+FramePool::Stats FramePool::stats() const { return mCounters->stats(); }
+
+AVFrame *FramePool::takeFrame() {
+	mCounters->requests.fetch_add(1, std::memory_order_relaxed);
+	{
+		std::lock_guard lock(mFramesMutex);
+		if (!mFrames.empty()) {
+			AVFrame *frame = mFrames.back();
+			mFrames.pop_back();
+			return frame;
+		}
+	}
+
+	mCounters->misses.fetch_add(1, std::memory_order_relaxed);
+	return av_frame_alloc();
+}
+
+void FramePool::recycleFrame(AVFrame *frame) {
+	av_frame_unref(frame); // buffers go back to their pools
+
+	std::lock_guard lock(mFramesMutex);
+	if (mFrames.size() < MaxRecycledFrames)
+		mFrames.push_back(frame);
+	else
+		av_frame_free(&frame);
+}
+
+} // namespace rtcast
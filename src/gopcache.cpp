@@ -0,0 +1,88 @@
+/**
+ * Copyright (c) 2025 Paul-Louis Ageneau
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+#include "gopcache.hpp"
+
+namespace rtcast {
+
+GopCache::GopCache(size_t maxBytes) : mMaxBytes(maxBytes) {}
+
+void GopCache::setMaxBytes(size_t maxBytes) {
+	std::lock_guard lock(mMutex);
+	mMaxBytes = maxBytes;
+	if (mBytes > mMaxBytes) {
+		mItems.clear();
+		mBytes = 0;
+	}
+}
+
+bool GopCache::enabled() const {
+	std::lock_guard lock(mMutex);
+	return mMaxBytes > 0;
+}
+
+void GopCache::push(SendPool::Item item) {
+	std::lock_guard lock(mMutex);
+	if (mMaxBytes == 0 || !item.frame)
+		return;
+
+	if (item.frame->keyframe) {
+		mItems.clear();
+		mBytes = 0;
+
+	} else if (mItems.empty()) {
+		return; // wait for the next keyframe
+	}
+
+	size_t size = item.frame->size();
+	if (mBytes + size > mMaxBytes) {
+		mItems.clear();
+		mBytes = 0;
+		++mOverflows;
+		return;
+	}
+
+	mItems.push_back(std::move(item));
+	mBytes += size;
+}
+
+void GopCache::clear() {
+	std::lock_guard lock(mMutex);
+	mItems.clear();
+	mBytes = 0;
+}
+
+std::vector<SendPool::Item> GopCache::get(std::chrono::microseconds until) const {
+	std::lock_guard lock(mMutex);
+	if (mItems.empty() || mItems.front().frame->timestamp > until)
+		return {};
+
+	std::vector<SendPool::Item> result;
+	for (const auto &item : mItems) {
+		if (item.frame->timestamp > until)
+			break;
+
+		result.push_back(item);
+	}
+
+	if (result.back().frame->timestamp != until)
+		return {}; // the frame is missing from the GOP
+
+	return result;
+}
+
+GopCache::Stats GopCache::stats() const {
+	std::lock_guard lock(mMutex);
+	Stats stats;
+	stats.frames = mItems.size();
+	stats.bytes = mBytes;
+	stats.overflows = mOverflows;
+	return stats;
+}
+
+} // namespace rtcast
@@ -0,0 +1,140 @@
+/**
+ * Copyright (c) 2025 Paul-Louis Ageneau
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+#include "latency.hpp"
+
+#include <algorithm>
+
+namespace rtcast {
+
+namespace {
+
+int highest_bit(uint64_t value) {
+	int bit = 0;
+	while (value >>= 1)
+		++bit;
+	return bit;
+}
+
+} // namespace
+
+LatencyHistogram::LatencyHistogram() {
+	for (auto &count : mCounts)
+		count.store(0, std::memory_order_relaxed);
+}
+
+int LatencyHistogram::IndexOf(uint64_t value) {
+	if (value < SubBucketCount)
+		return int(value);
+
+	int bit = highest_bit(value);
+	if (bit >= MaxValueBits)
+		return BucketCount - 1;
+
+	int shift = bit - SubBucketBits + 1;
+	int sub = int(value >> shift) - SubBucketCount / 2;
+	return shift * SubBucketCount / 2 + SubBucketCount / 2 + sub;
+}
+
+uint64_t LatencyHistogram::ValueOf(int index) {
+	if (index < SubBucketCount)
+		return uint64_t(index);
+
+	int shift = (index - SubBucketCount / 2) / (SubBucketCount / 2);
+	int sub = (index - SubBucketCount / 2) % (SubBucketCount / 2) + SubBucketCount / 2;
+	uint64_t lower = uint64_t(sub) << shift;
+	return lower + ((uint64_t(1) << shift) >> 1); // middle of the bucket
+}
+
+void LatencyHistogram::record(std::chrono::microseconds value) {
+	uint64_t v = value.count() > 0 ? uint64_t(value.count()) : 0;
+	mCounts[IndexOf(v)].fetch_add(1, std::memory_order_relaxed);
+	mCount.fetch_add(1, std::memory_order_relaxed);
+
+	uint64_t max = mMax.load(std::memory_order_relaxed);
+	while (v > max && !mMax.compare_exchange_weak(max, v, std::memory_order_relaxed))
+		;
+}
+
+void LatencyHistogram::reset() {
+	for (auto &count : mCounts)
+		count.store(0, std::memory_order_relaxed);
+
+	mCount.store(0, std::memory_order_relaxed);
+	mMax.store(0, std::memory_order_relaxed);
+}
+
+uint64_t LatencyHistogram::count() const { return mCount.load(std::memory_order_relaxed); }
+
+std::chrono::microseconds LatencyHistogram::max() const {
+	return std::chrono::microseconds(mMax.load(std::memory_order_relaxed));
+}
+
+std::chrono::microseconds LatencyHistogram::percentile(double p) const {
+	// Counts are read without a snapshot, the result is approximate under concurrent recording
+	uint64_t total = 0;
+	for (const auto &count : mCounts)
+		total += count.load(std::memory_order_relaxed);
+
+	if (total == 0)
+		return std::chrono::microseconds::zero();
+
+	auto target = uint64_t(std::clamp(p, 0., 1.) * double(total - 1)) + 1;
+	uint64_t cumulated = 0;
+	for (int i = 0; i < BucketCount; ++i) {
+		cumulated += mCounts[i].load(std::memory_order_relaxed);
+		if (cumulated >= target)
+			return std::min(std::chrono::microseconds(ValueOf(i)), max());
+	}
+
+	return max();
+}
+
+LatencySummary LatencyHistogram::summary() const {
+	LatencySummary summary;
+	summary.count = count();
+	summary.p50 = percentile(0.50);
+	summary.p99 = percentile(0.99);
+	summary.max = max();
+	return summary;
+}
+
+const char *PipelineStageName(PipelineStage stage) {
+	switch (stage) {
+	case PipelineStage::Capture:
+		return "capture";
+	case PipelineStage::Convert:
+		return "convert";
+	case PipelineStage::Queue:
+		return "queue";
+	case PipelineStage::Encode:
+		return "encode";
+	case PipelineStage::Send:
+		return "send";
+	case PipelineStage::Total:
+		return "total";
+	default:
+		return "unknown";
+	}
+}
+
+LatencyStats PipelineLatency::stats() const {
+	LatencyStats stats;
+	for (size_t i = 0; i < StageCount; ++i)
+		if (mHistograms[i].count() > 0)
+			stats.emplace(static_cast<PipelineStage>(i), mHistograms[i].summary());
+
+	return stats;
+}
+
+void PipelineLatency::reset() {
+	for (auto &histogram : mHistograms)
+		histogram.reset();
+}
+
+} // namespace rtcast
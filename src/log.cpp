@@ -0,0 +1,319 @@
+/**
+ * Copyright (c) 2025 Paul-Louis Ageneau
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+#include "log.hpp"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <mutex>
+#include <thread>
+
+namespace rtcast {
+
+namespace logging {
+
+std::atomic<LogLevel> RuntimeLevel = LogLevel::Info;
+
+namespace {
+
+using std::chrono::steady_clock;
+using std::chrono::system_clock;
+
+const size_t ThreadBufferSize = 128; // records per thread
+const auto WriterPeriod = std::chrono::milliseconds(50);
+
+struct Record {
+	system_clock::time_point time;
+	LogLevel level;
+	const char *file;
+	int line;
+	size_t size;
+	char text[Line::MaxSize];
+};
+
+// Single-producer single-consumer ring owned by a logging thread and drained by the writer
+class ThreadBuffer final {
+public:
+	explicit ThreadBuffer(unsigned int id) : mId(id) {}
+
+	unsigned int id() const { return mId; }
+
+	Record *beginWrite() {
+		size_t tail = mTail.load(std::memory_order_relaxed);
+		if (tail - mHead.load(std::memory_order_acquire) >= ThreadBufferSize) {
+			mDropped.fetch_add(1, std::memory_order_relaxed);
+			return nullptr;
+		}
+		return &mRecords[tail % ThreadBufferSize];
+	}
+
+	// Returns true if the buffer is getting full and the writer should be woken up
+	bool commitWrite() {
+		size_t tail = mTail.load(std::memory_order_relaxed) + 1;
+		mTail.store(tail, std::memory_order_release);
+		return tail - mHead.load(std::memory_order_relaxed) >= ThreadBufferSize / 2;
+	}
+
+	template <typename F> void drain(F func) {
+		size_t head = mHead.load(std::memory_order_relaxed);
+		size_t tail = mTail.load(std::memory_order_acquire);
+		while (head != tail) {
+			func(mRecords[head % ThreadBufferSize]);
+			mHead.store(++head, std::memory_order_release);
+		}
+	}
+
+	uint64_t takeDropped() { return mDropped.exchange(0, std::memory_order_relaxed); }
+
+	std::atomic<bool> orphaned = false;
+
+private:
+	const unsigned int mId;
+	Record mRecords[ThreadBufferSize];
+	alignas(64) std::atomic<size_t> mHead = 0;
+	alignas(64) std::atomic<size_t> mTail = 0;
+	std::atomic<uint64_t> mDropped = 0;
+};
+
+const char *level_name(LogLevel level) {
+	switch (level) {
+	case LogLevel::Trace:
+		return "TRACE";
+	case LogLevel::Debug:
+		return "DEBUG";
+	case LogLevel::Info:
+		return "INFO";
+	case LogLevel::Warning:
+		return "WARN";
+	case LogLevel::Error:
+		return "ERROR";
+	default:
+		return "NONE";
+	}
+}
+
+const char *base_name(const char *file) {
+	const char *slash = std::strrchr(file, '/');
+	return slash ? slash + 1 : file;
+}
+
+class Writer final {
+public:
+	static Writer &Instance() {
+		// Intentionally leaked so that logging from static destructors stays valid
+		static Writer *writer = new Writer();
+		return *writer;
+	}
+
+	void setCallback(log_callback callback) {
+		std::lock_guard lock(mCallbackMutex);
+		mCallback = std::move(callback);
+	}
+
+	shared_ptr<ThreadBuffer> registerThread() {
+		std::lock_guard lock(mMutex);
+		if (!mThread.joinable() && !mStopped) {
+			mThread = std::thread(&Writer::run, this);
+			std::atexit([]() { Instance().stop(); });
+		}
+		auto buffer = std::make_shared<ThreadBuffer>(mNextId++);
+		mBuffers.push_back(buffer);
+		return buffer;
+	}
+
+	bool stopped() const { return mStopped.load(std::memory_order_acquire); }
+
+	void wake() { mCondition.notify_one(); }
+
+	void flush() {
+		std::lock_guard lock(mMutex);
+		drainAll();
+	}
+
+	void stop() {
+		{
+			std::lock_guard lock(mMutex);
+			mStopped = true;
+		}
+		mCondition.notify_one();
+		if (mThread.joinable())
+			mThread.join();
+
+		flush();
+	}
+
+	void output(const Record &record, unsigned int threadId) {
+		char header[64];
+		std::time_t t = system_clock::to_time_t(record.time);
+		auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+		              record.time.time_since_epoch())
+		              .count() %
+		          1000;
+		std::tm tm = {};
+#ifdef _WIN32
+		localtime_s(&tm, &t);
+#else
+		localtime_r(&t, &tm);
+#endif
+		size_t len = std::strftime(header, sizeof(header), "%Y-%m-%d %H:%M:%S", &tm);
+		std::snprintf(header + len, sizeof(header) - len, ".%03d %-5s [%u] ", int(ms),
+		              level_name(record.level), threadId);
+
+		std::lock_guard lock(mCallbackMutex);
+		if (mCallback) {
+			mCallback(record.level, string(record.text, record.size));
+			return;
+		}
+
+		std::fputs(header, stderr);
+		std::fwrite(record.text, 1, record.size, stderr);
+		if (record.level <= LogLevel::Debug)
+			std::fprintf(stderr, " (%s:%d)", base_name(record.file), record.line);
+		std::fputc('\n', stderr);
+	}
+
+private:
+	Writer() = default;
+
+	void run() {
+		std::unique_lock lock(mMutex);
+		while (!mStopped) {
+			mCondition.wait_for(lock, WriterPeriod);
+			drainAll();
+		}
+	}
+
+	// Must be called with mMutex held
+	void drainAll() {
+		auto it = mBuffers.begin();
+		while (it != mBuffers.end()) {
+			auto &buffer = *it;
+			bool orphaned = buffer->orphaned.load(std::memory_order_acquire);
+			unsigned int id = buffer->id();
+			buffer->drain([this, id](const Record &record) { output(record, id); });
+			if (uint64_t dropped = buffer->takeDropped())
+				std::fprintf(stderr, "%llu log messages dropped on thread %u\n",
+				             static_cast<unsigned long long>(dropped), id);
+
+			it = orphaned ? mBuffers.erase(it) : ++it;
+		}
+		std::fflush(stderr);
+	}
+
+	std::mutex mMutex;
+	std::condition_variable mCondition;
+	std::thread mThread;
+	std::atomic<bool> mStopped = false;
+	std::vector<shared_ptr<ThreadBuffer>> mBuffers;
+	unsigned int mNextId = 0;
+
+	std::mutex mCallbackMutex;
+	log_callback mCallback;
+};
+
+ThreadBuffer *thread_buffer() {
+	struct Holder {
+		shared_ptr<ThreadBuffer> buffer = Writer::Instance().registerThread();
+		~Holder() { buffer->orphaned.store(true, std::memory_order_release); }
+	};
+	thread_local Holder holder;
+	return holder.buffer.get();
+}
+
+int64_t steady_nanoseconds() {
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(
+	           steady_clock::now().time_since_epoch())
+	    .count();
+}
+
+} // namespace
+
+RateLimiter::RateLimiter(double perSecond, unsigned int burst)
+    : mIntervalNs(static_cast<int64_t>(1e9 / (perSecond > 0. ? perSecond : 1e-9))),
+      mToleranceNs(mIntervalNs * (burst > 0 ? int64_t(burst) - 1 : 0)) {}
+
+bool RateLimiter::allow() {
+	const int64_t now = steady_nanoseconds();
+	int64_t tat = mTheoreticalArrival.load(std::memory_order_relaxed);
+	while (true) {
+		int64_t base = std::max(tat, now);
+		if (base - now > mToleranceNs) {
+			mSuppressed.fetch_add(1, std::memory_order_relaxed);
+			return false;
+		}
+		if (mTheoreticalArrival.compare_exchange_weak(tat, base + mIntervalNs,
+		                                              std::memory_order_relaxed))
+			return true;
+	}
+}
+
+uint64_t RateLimiter::takeSuppressed() {
+	return mSuppressed.exchange(0, std::memory_order_relaxed);
+}
+
+Line::Buffer::Buffer() { setp(mData, mData + MaxSize); }
+
+size_t Line::Buffer::size() const { return size_t(pptr() - pbase()); }
+
+Line::Buffer::int_type Line::Buffer::overflow(int_type ch) {
+	// Truncate silently
+	return traits_type::not_eof(ch);
+}
+
+Line::Line(LogLevel level, const char *file, int line, RateLimiter *limiter)
+    : mLevel(level), mFile(file), mLine(line), mLimiter(limiter), mStream(&mBuffer) {}
+
+Line::~Line() {
+	if (mLimiter)
+		if (uint64_t suppressed = mLimiter->takeSuppressed())
+			mStream << " (" << suppressed << " similar messages suppressed)";
+
+	auto &writer = Writer::Instance();
+	if (writer.stopped()) {
+		// Late message after exit, write synchronously
+		Record record;
+		record.time = system_clock::now();
+		record.level = mLevel;
+		record.file = mFile;
+		record.line = mLine;
+		record.size = mBuffer.size();
+		std::memcpy(record.text, mBuffer.data(), record.size);
+		writer.output(record, 0);
+		std::fflush(stderr);
+		return;
+	}
+
+	ThreadBuffer *buffer = thread_buffer();
+	Record *record = buffer->beginWrite();
+	if (!record)
+		return; // dropped, accounted for by the buffer
+
+	record->time = system_clock::now();
+	record->level = mLevel;
+	record->file = mFile;
+	record->line = mLine;
+	record->size = mBuffer.size();
+	std::memcpy(record->text, mBuffer.data(), record->size);
+
+	if (buffer->commitWrite() || mLevel >= LogLevel::Warning)
+		writer.wake();
+}
+
+} // namespace logging
+
+void InitLogger(LogLevel level, log_callback callback) {
+	logging::RuntimeLevel.store(level, std::memory_order_relaxed);
+	logging::Writer::Instance().setCallback(std::move(callback));
+}
+
+void FlushLogger() { logging::Writer::Instance().flush(); }
+
+} // namespace rtcast
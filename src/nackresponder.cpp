@@ -0,0 +1,110 @@
+/**
+ * Copyright (c) 2025 Paul-Louis Ageneau
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+#include "nackresponder.hpp"
+
+#include <stdexcept>
+
+namespace rtcast {
+
+namespace {
+
+const uint8_t TransportFeedbackType = 205; // RTPFB
+const uint8_t NackFormat = 1;
+
+const size_t RtpHeaderSize = 12;
+const size_t RtcpHeaderSize = 4;
+
+uint16_t read_u16(const byte *p) { return uint16_t(uint16_t(p[0]) << 8 | uint16_t(p[1])); }
+
+uint32_t read_u32(const byte *p) {
+	return uint32_t(p[0]) << 24 | uint32_t(p[1]) << 16 | uint32_t(p[2]) << 8 | uint32_t(p[3]);
+}
+
+} // namespace
+
+NackResponder::NackResponder(uint32_t ssrc, shared_ptr<Counters> counters, size_t maxPackets)
+    : mSsrc(ssrc), mCounters(std::move(counters)), mPackets(maxPackets) {
+	if (maxPackets == 0)
+		throw std::invalid_argument("Invalid NACK responder size");
+}
+
+void NackResponder::outgoing(rtc::message_vector &messages,
+                             [[maybe_unused]] const rtc::message_callback &send) {
+	for (const auto &message : messages) {
+		// RTCP from the RtcpSrReporter is not stored
+		if (!message || message->type != rtc::Message::Binary || message->size() < RtpHeaderSize)
+			continue;
+
+		mCounters->packets.fetch_add(1, std::memory_order_relaxed);
+		mCounters->bytes.fetch_add(message->size(), std::memory_order_relaxed);
+
+		// The transport encrypts messages in place, keep a copy
+		uint16_t sequence = read_u16(message->data() + 2);
+		auto copy = rtc::make_message(message->begin(), message->end());
+		std::lock_guard lock(mMutex);
+		mPackets[sequence % mPackets.size()] = std::move(copy);
+	}
+}
+
+void NackResponder::incoming(rtc::message_vector &messages, const rtc::message_callback &send) {
+	for (const auto &message : messages)
+		if (message && message->type == rtc::Message::Control)
+			parse(message->data(), message->size(), send);
+}
+
+void NackResponder::parse(const byte *data, size_t size, const rtc::message_callback &send) {
+	// Compound packet
+	while (size >= RtcpHeaderSize) {
+		uint8_t first = uint8_t(data[0]);
+		if ((first >> 6) != 2)
+			return; // not RTCP version 2
+
+		uint8_t count = first & 0x1F;
+		uint8_t type = uint8_t(data[1]);
+		size_t length = (size_t(read_u16(data + 2)) + 1) * 4;
+		if (length > size)
+			return;
+
+		if (type == TransportFeedbackType && count == NackFormat && length >= 12 &&
+		    read_u32(data + 8) == mSsrc) {
+			// FCI entries are a packet ID and a bitmask of following lost packets
+			for (size_t i = 12; i + 4 <= length; i += 4) {
+				uint16_t pid = read_u16(data + i);
+				uint16_t blp = read_u16(data + i + 2);
+				retransmit(pid, send);
+				for (unsigned int bit = 0; bit < 16; ++bit)
+					if (blp & (1 << bit))
+						retransmit(uint16_t(pid + bit + 1), send);
+			}
+		}
+
+		data += length;
+		size -= length;
+	}
+}
+
+void NackResponder::retransmit(uint16_t sequence, const rtc::message_callback &send) {
+	mCounters->nacks.fetch_add(1, std::memory_order_relaxed);
+
+	rtc::message_ptr packet;
+	{
+		std::lock_guard lock(mMutex);
+		const auto &stored = mPackets[sequence % mPackets.size()];
+		if (!stored || read_u16(stored->data() + 2) != sequence)
+			return; // too old, overwritten
+
+		packet = rtc::make_message(stored->begin(), stored->end());
+	}
+
+	mCounters->retransmissions.fetch_add(1, std::memory_order_relaxed);
+	mCounters->retransmittedBytes.fetch_add(packet->size(), std::memory_order_relaxed);
+	send(std::move(packet));
+}
+
+} // namespace rtcast
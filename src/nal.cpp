@@ -0,0 +1,253 @@
+/**
+ * Copyright (c) 2025 Paul-Louis Ageneau
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+#include "nal.hpp"
+
+#include <stdexcept>
+
+namespace rtcast {
+
+namespace nal {
+
+namespace {
+
+const byte StartCode[] = {byte(0), byte(0), byte(0), byte(1)};
+
+void append_unit(binary &out, const byte *unit, size_t size) {
+	out.insert(out.end(), StartCode, StartCode + 4);
+	out.insert(out.end(), unit, unit + size);
+}
+
+size_t read_length(const byte *p, size_t lengthSize) {
+	size_t length = 0;
+	for (size_t i = 0; i < lengthSize; ++i)
+		length = length << 8 | size_t(uint8_t(p[i]));
+	return length;
+}
+
+template <typename F> binary filter_units(const byte *data, size_t size, F predicate) {
+	binary out;
+	ForEachUnit(data, size, [&](const byte *unit, size_t unitSize) {
+		if (predicate(unit, unitSize))
+			append_unit(out, unit, unitSize);
+	});
+	return out;
+}
+
+bool is_h264_parameter_set(const byte *unit) {
+	uint8_t type = H264UnitType(unit);
+	return type == uint8_t(H264Type::Sps) || type == uint8_t(H264Type::Pps);
+}
+
+bool is_h265_parameter_set(const byte *unit) {
+	uint8_t type = H265UnitType(unit);
+	return type >= 32 && type <= 34; // VPS, SPS, and PPS
+}
+
+bool is_annex_b(const byte *data, size_t size) {
+	return (size >= 3 && data[0] == byte(0) && data[1] == byte(0) && data[2] == byte(1)) ||
+	       (size >= 4 && data[0] == byte(0) && data[1] == byte(0) && data[2] == byte(0) &&
+	        data[3] == byte(1));
+}
+
+} // namespace
+
+bool IsH264Keyframe(const byte *data, size_t size) {
+	bool keyframe = false;
+	ForEachUnit(data, size, [&keyframe](const byte *unit, size_t) {
+		if (H264UnitType(unit) == uint8_t(H264Type::Idr))
+			keyframe = true;
+	});
+	return keyframe;
+}
+
+bool IsH265Keyframe(const byte *data, size_t size) {
+	bool keyframe = false;
+	ForEachUnit(data, size, [&keyframe](const byte *unit, size_t unitSize) {
+		// IRAP pictures are BLA, IDR and CRA (types 16 to 23)
+		uint8_t type = H265UnitType(unit);
+		if (unitSize >= 2 && type >= 16 && type <= 23)
+			keyframe = true;
+	});
+	return keyframe;
+}
+
+optional<bool> IsH264ConstrainedBaseline(const byte *data, size_t size) {
+	optional<bool> result;
+	ForEachUnit(data, size, [&result](const byte *unit, size_t unitSize) {
+		if (result || unitSize < 4 || H264UnitType(unit) != uint8_t(H264Type::Sps))
+			return;
+
+		// Baseline with constraint_set1, or any profile with constraint_set0 and constraint_set1
+		uint8_t profile = uint8_t(unit[1]);
+		uint8_t constraints = uint8_t(unit[2]);
+		result = (constraints & 0x40) && (profile == 66 || (constraints & 0x80));
+	});
+	return result;
+}
+
+optional<bool> IsH265Main(const byte *data, size_t size) {
+	optional<bool> result;
+	ForEachUnit(data, size, [&result](const byte *unit, size_t unitSize) {
+		if (result || unitSize < 5 || H265UnitType(unit) != 33) // SPS
+			return;
+
+		// The profile_tier_level structure follows the header and the first byte, general
+		// profile_idc then the compatibility flags, which may flag Main for another profile
+		uint8_t profile = uint8_t(unit[3]) & 0x1F;
+		result = profile == 1 || (uint8_t(unit[4]) & 0x40);
+	});
+	return result;
+}
+
+binary H264ParameterSets(const byte *data, size_t size) {
+	return filter_units(data, size, [](const byte *unit, size_t) {
+		return is_h264_parameter_set(unit);
+	});
+}
+
+binary H265ParameterSets(const byte *data, size_t size) {
+	return filter_units(data, size, [](const byte *unit, size_t unitSize) {
+		return unitSize >= 2 && is_h265_parameter_set(unit);
+	});
+}
+
+binary LengthPrefixedToAnnexB(const byte *data, size_t size, size_t lengthSize) {
+	if (lengthSize < 1 || lengthSize > 4)
+		throw std::invalid_argument("Invalid NAL unit length size");
+
+	binary out;
+	out.reserve(size + size / 64);
+	while (size >= lengthSize) {
+		size_t length = read_length(data, lengthSize);
+		data += lengthSize;
+		size -= lengthSize;
+		if (length > size)
+			throw std::runtime_error("Truncated NAL unit");
+
+		if (length > 0)
+			append_unit(out, data, length);
+
+		data += length;
+		size -= length;
+	}
+	return out;
+}
+
+optional<DecoderConfig> ParseH264Config(const byte *data, size_t size) {
+	// Version, profile, compatibility, level, length size, then SPS and PPS lists
+	if (size < 7 || data[0] != byte(1))
+		return nullopt;
+
+	DecoderConfig config;
+	config.lengthSize = (size_t(uint8_t(data[4])) & 0x03) + 1;
+	size_t pos = 5;
+	for (int list = 0; list < 2; ++list) {
+		if (pos >= size)
+			return nullopt;
+
+		size_t count = size_t(uint8_t(data[pos++])) & (list == 0 ? 0x1F : 0xFF);
+		for (size_t i = 0; i < count; ++i) {
+			if (pos + 2 > size)
+				return nullopt;
+
+			size_t length = read_length(data + pos, 2);
+			pos += 2;
+			if (pos + length > size)
+				return nullopt;
+
+			append_unit(config.parameterSets, data + pos, length);
+			pos += length;
+		}
+	}
+	return config;
+}
+
+optional<DecoderConfig> ParseH265Config(const byte *data, size_t size) {
+	// 22-byte header with the length size, then arrays of units grouped by type
+	if (size < 23 || data[0] != byte(1))
+		return nullopt;
+
+	DecoderConfig config;
+	config.lengthSize = (size_t(uint8_t(data[21])) & 0x03) + 1;
+	size_t arrays = size_t(uint8_t(data[22]));
+	size_t pos = 23;
+	for (size_t a = 0; a < arrays; ++a) {
+		if (pos + 3 > size)
+			return nullopt;
+
+		size_t count = read_length(data + pos + 1, 2);
+		pos += 3;
+		for (size_t i = 0; i < count; ++i) {
+			if (pos + 2 > size)
+				return nullopt;
+
+			size_t length = read_length(data + pos, 2);
+			pos += 2;
+			if (pos + length > size)
+				return nullopt;
+
+			if (length >= 2 && is_h265_parameter_set(data + pos))
+				append_unit(config.parameterSets, data + pos, length);
+
+			pos += length;
+		}
+	}
+	return config;
+}
+
+AnnexBNormalizer::AnnexBNormalizer(bool h265, const byte *extradata, size_t extradataSize)
+    : mH265(h265) {
+	if (!extradata || extradataSize == 0)
+		return;
+
+	if (is_annex_b(extradata, extradataSize)) {
+		mParameterSets = mH265 ? H265ParameterSets(extradata, extradataSize)
+		                       : H264ParameterSets(extradata, extradataSize);
+		return;
+	}
+
+	auto config = mH265 ? ParseH265Config(extradata, extradataSize)
+	                    : ParseH264Config(extradata, extradataSize);
+	if (!config)
+		throw std::runtime_error("Invalid decoder configuration record");
+
+	mLengthSize = config->lengthSize;
+	mParameterSets = std::move(config->parameterSets);
+}
+
+AnnexBNormalizer::Unit AnnexBNormalizer::normalize(const byte *data, size_t size) {
+	Unit result;
+	if (mLengthSize > 0) {
+		result.data = LengthPrefixedToAnnexB(data, size, mLengthSize);
+		data = result.data->data();
+		size = result.data->size();
+	}
+
+	result.keyframe = mH265 ? IsH265Keyframe(data, size) : IsH264Keyframe(data, size);
+	if (!result.keyframe)
+		return result;
+
+	// In-band parameter sets replace the previous ones, they may change with the resolution
+	if (auto sets = mH265 ? H265ParameterSets(data, size) : H264ParameterSets(data, size);
+	    !sets.empty()) {
+		mParameterSets = std::move(sets);
+		return result;
+	}
+
+	if (!mParameterSets.empty()) {
+		binary injected(mParameterSets);
+		injected.insert(injected.end(), data, data + size);
+		result.data = std::move(injected);
+	}
+	return result;
+}
+
+} // namespace nal
+
+} // namespace rtcast
@@ -0,0 +1,490 @@
+/**
+ * Copyright (c) 2025 Paul-Louis Ageneau
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+#include "pixelconvert.hpp"
+
+#include <array>
+#include <cstring>
+#include <stdexcept>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define RTCAST_PIXEL_X86 1
+#include <immintrin.h>
+#elif defined(__ARM_NEON)
+#define RTCAST_PIXEL_NEON 1
+#include <arm_neon.h>
+#endif
+
+namespace rtcast {
+
+namespace pixel {
+
+namespace {
+
+// Row kernels, averages round up as (a + b + 1) >> 1 in all implementations so they match exactly
+struct Kernels {
+	void (*yuyvToY)(const uint8_t *src, uint8_t *y, int width);
+	void (*yuyvToUv)(const uint8_t *src0, const uint8_t *src1, uint8_t *u, uint8_t *v, int width);
+	void (*splitUv)(const uint8_t *src, uint8_t *u, uint8_t *v, int count);
+	void (*averageRows)(const uint8_t *a, const uint8_t *b, uint8_t *dst, int count);
+	void (*average2x2)(const uint8_t *a, const uint8_t *b, uint8_t *dst, int count);
+};
+
+inline uint8_t avg(uint8_t a, uint8_t b) { return uint8_t((unsigned(a) + unsigned(b) + 1) >> 1); }
+
+void yuyv_to_y_scalar(const uint8_t *src, uint8_t *y, int width) {
+	for (int i = 0; i < width; ++i)
+		y[i] = src[2 * i];
+}
+
+void yuyv_to_uv_scalar(const uint8_t *src0, const uint8_t *src1, uint8_t *u, uint8_t *v,
+                       int width) {
+	for (int i = 0; i < width / 2; ++i) {
+		u[i] = avg(src0[4 * i + 1], src1[4 * i + 1]);
+		v[i] = avg(src0[4 * i + 3], src1[4 * i + 3]);
+	}
+}
+
+void split_uv_scalar(const uint8_t *src, uint8_t *u, uint8_t *v, int count) {
+	for (int i = 0; i < count; ++i) {
+		u[i] = src[2 * i];
+		v[i] = src[2 * i + 1];
+	}
+}
+
+void average_rows_scalar(const uint8_t *a, const uint8_t *b, uint8_t *dst, int count) {
+	for (int i = 0; i < count; ++i)
+		dst[i] = avg(a[i], b[i]);
+}
+
+void average_2x2_scalar(const uint8_t *a, const uint8_t *b, uint8_t *dst, int count) {
+	for (int i = 0; i < count; ++i)
+		dst[i] = avg(avg(a[2 * i], b[2 * i]), avg(a[2 * i + 1], b[2 * i + 1]));
+}
+
+const Kernels ScalarKernels = {yuyv_to_y_scalar, yuyv_to_uv_scalar, split_uv_scalar,
+                               average_rows_scalar, average_2x2_scalar};
+
+#ifdef RTCAST_PIXEL_X86
+
+#define RTCAST_TARGET(isa) __attribute__((target(isa)))
+
+RTCAST_TARGET("sse4.1") void yuyv_to_y_sse41(const uint8_t *src, uint8_t *y, int width) {
+	const __m128i mask = _mm_set1_epi16(0x00FF);
+	int i = 0;
+	for (; i + 16 <= width; i += 16) {
+		__m128i lo = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + 2 * i));
+		__m128i hi = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + 2 * i + 16));
+		__m128i packed = _mm_packus_epi16(_mm_and_si128(lo, mask), _mm_and_si128(hi, mask));
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(y + i), packed);
+	}
+	yuyv_to_y_scalar(src + 2 * i, y + i, width - i);
+}
+
+RTCAST_TARGET("sse4.1")
+void yuyv_to_uv_sse41(const uint8_t *src0, const uint8_t *src1, uint8_t *u, uint8_t *v,
+                      int width) {
+	const __m128i mask = _mm_set1_epi16(0x00FF);
+	auto load_avg = [&](int offset) RTCAST_TARGET("sse4.1") {
+		__m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src0 + offset));
+		__m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src1 + offset));
+		return _mm_srli_epi16(_mm_avg_epu8(a, b), 8); // chroma samples
+	};
+	int i = 0;
+	for (; i + 32 <= width; i += 32) {
+		__m128i uv0 = _mm_packus_epi16(load_avg(2 * i), load_avg(2 * i + 16));
+		__m128i uv1 = _mm_packus_epi16(load_avg(2 * i + 32), load_avg(2 * i + 48));
+		__m128i us = _mm_packus_epi16(_mm_and_si128(uv0, mask), _mm_and_si128(uv1, mask));
+		__m128i vs = _mm_packus_epi16(_mm_srli_epi16(uv0, 8), _mm_srli_epi16(uv1, 8));
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(u + i / 2), us);
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(v + i / 2), vs);
+	}
+	yuyv_to_uv_scalar(src0 + 2 * i, src1 + 2 * i, u + i / 2, v + i / 2, width - i);
+}
+
+RTCAST_TARGET("sse4.1") void split_uv_sse41(const uint8_t *src, uint8_t *u, uint8_t *v, int count) {
+	const __m128i mask = _mm_set1_epi16(0x00FF);
+	int i = 0;
+	for (; i + 16 <= count; i += 16) {
+		__m128i lo = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + 2 * i));
+		__m128i hi = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + 2 * i + 16));
+		__m128i us = _mm_packus_epi16(_mm_and_si128(lo, mask), _mm_and_si128(hi, mask));
+		__m128i vs = _mm_packus_epi16(_mm_srli_epi16(lo, 8), _mm_srli_epi16(hi, 8));
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(u + i), us);
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(v + i), vs);
+	}
+	split_uv_scalar(src + 2 * i, u + i, v + i, count - i);
+}
+
+RTCAST_TARGET("sse4.1")
+void average_rows_sse41(const uint8_t *a, const uint8_t *b, uint8_t *dst, int count) {
+	int i = 0;
+	for (; i + 16 <= count; i += 16) {
+		__m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i *>(a + i));
+		__m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i *>(b + i));
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), _mm_avg_epu8(va, vb));
+	}
+	average_rows_scalar(a + i, b + i, dst + i, count - i);
+}
+
+RTCAST_TARGET("sse4.1")
+void average_2x2_sse41(const uint8_t *a, const uint8_t *b, uint8_t *dst, int count) {
+	const __m128i mask = _mm_set1_epi16(0x00FF);
+	auto average = [&](int offset) RTCAST_TARGET("sse4.1") {
+		__m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i *>(a + offset));
+		__m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i *>(b + offset));
+		__m128i vertical = _mm_avg_epu8(va, vb);
+		return _mm_avg_epu16(_mm_and_si128(vertical, mask), _mm_srli_epi16(vertical, 8));
+	};
+	int i = 0;
+	for (; i + 16 <= count; i += 16) {
+		__m128i packed = _mm_packus_epi16(average(2 * i), average(2 * i + 16));
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), packed);
+	}
+	average_2x2_scalar(a + 2 * i, b + 2 * i, dst + i, count - i);
+}
+
+const Kernels Sse41Kernels = {yuyv_to_y_sse41, yuyv_to_uv_sse41, split_uv_sse41,
+                              average_rows_sse41, average_2x2_sse41};
+
+// Packing works within 128-bit lanes, restore the order of 64-bit quarters
+#define RTCAST_PACKUS256(a, b) _mm256_permute4x64_epi64(_mm256_packus_epi16(a, b), 0xD8)
+
+RTCAST_TARGET("avx2") void yuyv_to_y_avx2(const uint8_t *src, uint8_t *y, int width) {
+	const __m256i mask = _mm256_set1_epi16(0x00FF);
+	int i = 0;
+	for (; i + 32 <= width; i += 32) {
+		__m256i lo = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + 2 * i));
+		__m256i hi = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + 2 * i + 32));
+		__m256i packed =
+		    RTCAST_PACKUS256(_mm256_and_si256(lo, mask), _mm256_and_si256(hi, mask));
+		_mm256_storeu_si256(reinterpret_cast<__m256i *>(y + i), packed);
+	}
+	yuyv_to_y_sse41(src + 2 * i, y + i, width - i);
+}
+
+RTCAST_TARGET("avx2")
+void yuyv_to_uv_avx2(const uint8_t *src0, const uint8_t *src1, uint8_t *u, uint8_t *v,
+                     int width) {
+	const __m256i mask = _mm256_set1_epi16(0x00FF);
+	auto load_avg = [&](int offset) RTCAST_TARGET("avx2") {
+		__m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src0 + offset));
+		__m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src1 + offset));
+		return _mm256_srli_epi16(_mm256_avg_epu8(a, b), 8);
+	};
+	int i = 0;
+	for (; i + 64 <= width; i += 64) {
+		__m256i uv0 = RTCAST_PACKUS256(load_avg(2 * i), load_avg(2 * i + 32));
+		__m256i uv1 = RTCAST_PACKUS256(load_avg(2 * i + 64), load_avg(2 * i + 96));
+		__m256i us =
+		    RTCAST_PACKUS256(_mm256_and_si256(uv0, mask), _mm256_and_si256(uv1, mask));
+		__m256i vs = RTCAST_PACKUS256(_mm256_srli_epi16(uv0, 8), _mm256_srli_epi16(uv1, 8));
+		_mm256_storeu_si256(reinterpret_cast<__m256i *>(u + i / 2), us);
+		_mm256_storeu_si256(reinterpret_cast<__m256i *>(v + i / 2), vs);
+	}
+	yuyv_to_uv_sse41(src0 + 2 * i, src1 + 2 * i, u + i / 2, v + i / 2, width - i);
+}
+
+RTCAST_TARGET("avx2") void split_uv_avx2(const uint8_t *src, uint8_t *u, uint8_t *v, int count) {
+	const __m256i mask = _mm256_set1_epi16(0x00FF);
+	int i = 0;
+	for (; i + 32 <= count; i += 32) {
+		__m256i lo = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + 2 * i));
+		__m256i hi = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + 2 * i + 32));
+		__m256i us = RTCAST_PACKUS256(_mm256_and_si256(lo, mask), _mm256_and_si256(hi, mask));
+		__m256i vs = RTCAST_PACKUS256(_mm256_srli_epi16(lo, 8), _mm256_srli_epi16(hi, 8));
+		_mm256_storeu_si256(reinterpret_cast<__m256i *>(u + i), us);
+		_mm256_storeu_si256(reinterpret_cast<__m256i *>(v + i), vs);
+	}
+	split_uv_sse41(src + 2 * i, u + i, v + i, count - i);
+}
+
+RTCAST_TARGET("avx2")
+void average_rows_avx2(const uint8_t *a, const uint8_t *b, uint8_t *dst, int count) {
+	int i = 0;
+	for (; i + 32 <= count; i += 32) {
+		__m256i va = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(a + i));
+		__m256i vb = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(b + i));
+		_mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i), _mm256_avg_epu8(va, vb));
+	}
+	average_rows_sse41(a + i, b + i, dst + i, count - i);
+}
+
+RTCAST_TARGET("avx2")
+void average_2x2_avx2(const uint8_t *a, const uint8_t *b, uint8_t *dst, int count) {
+	const __m256i mask = _mm256_set1_epi16(0x00FF);
+	auto average = [&](int offset) RTCAST_TARGET("avx2") {
+		__m256i va = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(a + offset));
+		__m256i vb = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(b + offset));
+		__m256i vertical = _mm256_avg_epu8(va, vb);
+		return _mm256_avg_epu16(_mm256_and_si256(vertical, mask),
+		                        _mm256_srli_epi16(vertical, 8));
+	};
+	int i = 0;
+	for (; i + 32 <= count; i += 32) {
+		__m256i packed = RTCAST_PACKUS256(average(2 * i), average(2 * i + 32));
+		_mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i), packed);
+	}
+	average_2x2_sse41(a + 2 * i, b + 2 * i, dst + i, count - i);
+}
+
+#undef RTCAST_PACKUS256
+
+const Kernels Avx2Kernels = {yuyv_to_y_avx2, yuyv_to_uv_avx2, split_uv_avx2, average_rows_avx2,
+                             average_2x2_avx2};
+
+#endif // RTCAST_PIXEL_X86
+
+#ifdef RTCAST_PIXEL_NEON
+
+void yuyv_to_y_neon(const uint8_t *src, uint8_t *y, int width) {
+	int i = 0;
+	for (; i + 32 <= width; i += 32) {
+		uint8x16x4_t yuyv = vld4q_u8(src + 2 * i); // Y0, U, Y1, V
+		uint8x16x2_t luma = {{yuyv.val[0], yuyv.val[2]}};
+		vst2q_u8(y + i, luma);
+	}
+	yuyv_to_y_scalar(src + 2 * i, y + i, width - i);
+}
+
+void yuyv_to_uv_neon(const uint8_t *src0, const uint8_t *src1, uint8_t *u, uint8_t *v,
+                     int width) {
+	int i = 0;
+	for (; i + 32 <= width; i += 32) {
+		uint8x16x4_t a = vld4q_u8(src0 + 2 * i);
+		uint8x16x4_t b = vld4q_u8(src1 + 2 * i);
+		vst1q_u8(u + i / 2, vrhaddq_u8(a.val[1], b.val[1]));
+		vst1q_u8(v + i / 2, vrhaddq_u8(a.val[3], b.val[3]));
+	}
+	yuyv_to_uv_scalar(src0 + 2 * i, src1 + 2 * i, u + i / 2, v + i / 2, width - i);
+}
+
+void split_uv_neon(const uint8_t *src, uint8_t *u, uint8_t *v, int count) {
+	int i = 0;
+	for (; i + 16 <= count; i += 16) {
+		uint8x16x2_t uv = vld2q_u8(src + 2 * i);
+		vst1q_u8(u + i, uv.val[0]);
+		vst1q_u8(v + i, uv.val[1]);
+	}
+	split_uv_scalar(src + 2 * i, u + i, v + i, count - i);
+}
+
+void average_rows_neon(const uint8_t *a, const uint8_t *b, uint8_t *dst, int count) {
+	int i = 0;
+	for (; i + 16 <= count; i += 16)
+		vst1q_u8(dst + i, vrhaddq_u8(vld1q_u8(a + i), vld1q_u8(b + i)));
+
+	average_rows_scalar(a + i, b + i, dst + i, count - i);
+}
+
+void average_2x2_neon(const uint8_t *a, const uint8_t *b, uint8_t *dst, int count) {
+	int i = 0;
+	for (; i + 16 <= count; i += 16) {
+		uint8x16x2_t va = vld2q_u8(a + 2 * i);
+		uint8x16x2_t vb = vld2q_u8(b + 2 * i);
+		uint8x16_t even = vrhaddq_u8(va.val[0], vb.val[0]);
+		uint8x16_t odd = vrhaddq_u8(va.val[1], vb.val[1]);
+		vst1q_u8(dst + i, vrhaddq_u8(even, odd));
+	}
+	average_2x2_scalar(a + 2 * i, b + 2 * i, dst + i, count - i);
+}
+
+const Kernels NeonKernels = {yuyv_to_y_neon, yuyv_to_uv_neon, split_uv_neon, average_rows_neon,
+                             average_2x2_neon};
+
+#endif // RTCAST_PIXEL_NEON
+
+const Kernels &kernels(Isa isa) {
+	if (!IsSupported(isa))
+		throw std::invalid_argument(string("Unsupported instruction set: ") + IsaName(isa));
+
+	switch (isa) {
+#ifdef RTCAST_PIXEL_X86
+	case Isa::Sse41:
+		return Sse41Kernels;
+	case Isa::Avx2:
+		return Avx2Kernels;
+#endif
+#ifdef RTCAST_PIXEL_NEON
+	case Isa::Neon:
+		return NeonKernels;
+#endif
+	default:
+		return ScalarKernels;
+	}
+}
+
+// Full to limited range, 219/255 for luma and 224/255 for chroma
+struct RangeTables {
+	std::array<uint8_t, 256> luma;
+	std::array<uint8_t, 256> chroma;
+
+	RangeTables() {
+		for (int i = 0; i < 256; ++i) {
+			luma[i] = uint8_t(16 + (i * 219 + 127) / 255);
+			chroma[i] = uint8_t(128 + ((i - 128) * 224 + (i >= 128 ? 127 : -127)) / 255);
+		}
+	}
+};
+
+void compress_range(uint8_t *row, int count, const std::array<uint8_t, 256> &table) {
+	for (int i = 0; i < count; ++i)
+		row[i] = table[row[i]];
+}
+
+bool is_full_range(const AVFrame *frame) {
+	switch (frame->format) {
+	case AV_PIX_FMT_YUVJ420P:
+	case AV_PIX_FMT_YUVJ422P:
+	case AV_PIX_FMT_YUVJ444P:
+		return true;
+	default:
+		return frame->color_range == AVCOL_RANGE_JPEG;
+	}
+}
+
+} // namespace
+
+Isa BestIsa() {
+	static const Isa best = []() {
+#ifdef RTCAST_PIXEL_X86
+		__builtin_cpu_init();
+		if (__builtin_cpu_supports("avx2"))
+			return Isa::Avx2;
+		if (__builtin_cpu_supports("sse4.1"))
+			return Isa::Sse41;
+#endif
+#ifdef RTCAST_PIXEL_NEON
+		return Isa::Neon;
+#endif
+		return Isa::Scalar;
+	}();
+	return best;
+}
+
+bool IsSupported(Isa isa) {
+	switch (isa) {
+	case Isa::Scalar:
+		return true;
+#ifdef RTCAST_PIXEL_X86
+	case Isa::Sse41:
+		return BestIsa() == Isa::Sse41 || BestIsa() == Isa::Avx2;
+	case Isa::Avx2:
+		return BestIsa() == Isa::Avx2;
+#endif
+#ifdef RTCAST_PIXEL_NEON
+	case Isa::Neon:
+		return true;
+#endif
+	default:
+		return false;
+	}
+}
+
+const char *IsaName(Isa isa) {
+	switch (isa) {
+	case Isa::Sse41:
+		return "sse4.1";
+	case Isa::Avx2:
+		return "avx2";
+	case Isa::Neon:
+		return "neon";
+	default:
+		return "scalar";
+	}
+}
+
+bool HasI420Kernel(AVPixelFormat format, int width, int height) {
+	if (width <= 0 || height <= 0 || width % 2 != 0 || height % 2 != 0)
+		return false;
+
+	switch (format) {
+	case AV_PIX_FMT_YUYV422:
+	case AV_PIX_FMT_NV12:
+	case AV_PIX_FMT_YUV420P:
+	case AV_PIX_FMT_YUVJ420P:
+	case AV_PIX_FMT_YUV422P:
+	case AV_PIX_FMT_YUVJ422P:
+	case AV_PIX_FMT_YUV444P:
+	case AV_PIX_FMT_YUVJ444P:
+		return true;
+	default:
+		return false;
+	}
+}
+
+void ConvertToI420(const AVFrame *input, AVFrame *output, int begin, int end, Isa isa) {
+	const auto format = AVPixelFormat(input->format);
+	const int width = input->width;
+	if (!HasI420Kernel(format, width, input->height) || output->format != AV_PIX_FMT_YUV420P ||
+	    output->width != width || output->height != input->height)
+		throw std::invalid_argument("No conversion kernel for the frame format");
+
+	if (begin % 2 != 0 || end % 2 != 0 || begin < 0 || end > input->height)
+		throw std::invalid_argument("Invalid conversion rows");
+
+	const Kernels &k = kernels(isa);
+	const bool compress = is_full_range(input) && output->color_range == AVCOL_RANGE_MPEG;
+	static const RangeTables tables;
+
+	auto in = [input](int plane, int row) {
+		return input->data[plane] + ptrdiff_t(row) * input->linesize[plane];
+	};
+	auto out = [output](int plane, int row) {
+		return output->data[plane] + ptrdiff_t(row) * output->linesize[plane];
+	};
+
+	const int chromaWidth = width / 2;
+	for (int y = begin; y < end; y += 2) {
+		uint8_t *u = out(1, y / 2);
+		uint8_t *v = out(2, y / 2);
+		switch (format) {
+		case AV_PIX_FMT_YUYV422:
+			k.yuyvToY(in(0, y), out(0, y), width);
+			k.yuyvToY(in(0, y + 1), out(0, y + 1), width);
+			k.yuyvToUv(in(0, y), in(0, y + 1), u, v, width);
+			break;
+		case AV_PIX_FMT_NV12:
+			std::memcpy(out(0, y), in(0, y), width);
+			std::memcpy(out(0, y + 1), in(0, y + 1), width);
+			k.splitUv(in(1, y / 2), u, v, chromaWidth);
+			break;
+		case AV_PIX_FMT_YUV422P:
+		case AV_PIX_FMT_YUVJ422P:
+			std::memcpy(out(0, y), in(0, y), width);
+			std::memcpy(out(0, y + 1), in(0, y + 1), width);
+			k.averageRows(in(1, y), in(1, y + 1), u, chromaWidth);
+			k.averageRows(in(2, y), in(2, y + 1), v, chromaWidth);
+			break;
+		case AV_PIX_FMT_YUV444P:
+		case AV_PIX_FMT_YUVJ444P:
+			std::memcpy(out(0, y), in(0, y), width);
+			std::memcpy(out(0, y + 1), in(0, y + 1), width);
+			k.average2x2(in(1, y), in(1, y + 1), u, chromaWidth);
+			k.average2x2(in(2, y), in(2, y + 1), v, chromaWidth);
+			break;
+		default: // I420
+			std::memcpy(out(0, y), in(0, y), width);
+			std::memcpy(out(0, y + 1), in(0, y + 1), width);
+			std::memcpy(u, in(1, y / 2), chromaWidth);
+			std::memcpy(v, in(2, y / 2), chromaWidth);
+			break;
+		}
+
+		if (compress) {
+			compress_range(out(0, y), width, tables.luma);
+			compress_range(out(0, y + 1), width, tables.luma);
+			compress_range(u, chromaWidth, tables.chroma);
+			compress_range(v, chromaWidth, tables.chroma);
+		}
+	}
+}
+
+} // namespace pixel
+
+} // namespace rtcast
@@ -0,0 +1,192 @@
+/**
+ * Copyright (c) 2025 Paul-Louis Ageneau
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+#include "reddepacketizer.hpp"
+
+#include <cstring>
+#include <stdexcept>
+
+namespace rtcast {
+
+namespace {
+
+const size_t RtpHeaderSize = 12;
+const size_t BlockHeaderSize = 4;
+
+uint16_t read_u16(const byte *p) { return uint16_t(uint16_t(p[0]) << 8 | uint16_t(p[1])); }
+
+uint32_t read_u32(const byte *p) {
+	return uint32_t(p[0]) << 24 | uint32_t(p[1]) << 16 | uint32_t(p[2]) << 8 | uint32_t(p[3]);
+}
+
+void write_u32(byte *p, uint32_t value) {
+	p[0] = byte(value >> 24);
+	p[1] = byte(value >> 16);
+	p[2] = byte(value >> 8);
+	p[3] = byte(value);
+}
+
+} // namespace
+
+RedDepacketizer::RedDepacketizer(int payloadType, shared_ptr<Counters> counters)
+    : mPayloadType(uint8_t(payloadType)),
+      mCounters(counters ? std::move(counters) : std::make_shared<Counters>()) {
+	if (payloadType < 0 || payloadType > 127)
+		throw std::invalid_argument("Invalid RED payload type");
+}
+
+void RedDepacketizer::incoming(rtc::message_vector &messages,
+                               [[maybe_unused]] const rtc::message_callback &send) {
+	rtc::message_vector result;
+	result.reserve(messages.size());
+	for (auto &message : messages) {
+		if (!message || message->type != rtc::Message::Binary || message->size() < RtpHeaderSize ||
+		    (uint8_t(message->data()[0]) >> 6) != 2) {
+			result.push_back(std::move(message));
+			continue;
+		}
+
+		const byte *data = message->data();
+		if ((uint8_t(data[1]) & 0x7F) == mPayloadType) {
+			mCounters->packets.fetch_add(1, std::memory_order_relaxed);
+			split(message, result);
+			continue;
+		}
+
+		// Plain packet, possibly received before RED was used
+		uint32_t timestamp = read_u32(data + 4);
+		if (!isForwarded(timestamp))
+			markForwarded(timestamp);
+
+		result.push_back(std::move(message));
+	}
+	messages.swap(result);
+}
+
+void RedDepacketizer::split(const rtc::message_ptr &message, rtc::message_vector &result) {
+	const byte *data = message->data();
+	size_t size = message->size();
+	uint8_t first = uint8_t(data[0]);
+	size_t headerSize = RtpHeaderSize + 4 * size_t(first & 0x0F);
+	if (first & 0x10) { // extension
+		if (headerSize + 4 > size) {
+			mCounters->malformed.fetch_add(1, std::memory_order_relaxed);
+			return;
+		}
+		headerSize += 4 + 4 * size_t(read_u16(data + headerSize + 2));
+	}
+	if (first & 0x20) { // padding
+		size_t padding = uint8_t(data[size - 1]);
+		size = padding <= size ? size - padding : 0;
+	}
+
+	// Block headers, then the blocks in the same order and the primary frame
+	const uint32_t timestamp = read_u32(data + 4);
+	const uint16_t sequence = read_u16(data + 2);
+	mBlocks.clear();
+	size_t pos = headerSize;
+	while (pos < size && (uint8_t(data[pos]) & 0x80)) {
+		if (pos + BlockHeaderSize > size)
+			break;
+
+		Block block;
+		block.payloadType = uint8_t(data[pos]) & 0x7F;
+		block.timestamp = timestamp - (read_u16(data + pos + 1) >> 2);
+		block.size = size_t(read_u16(data + pos + 2) & 0x03FF);
+		mBlocks.push_back(block);
+		pos += BlockHeaderSize;
+	}
+	if (pos >= size || (uint8_t(data[pos]) & 0x80)) {
+		mCounters->malformed.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+
+	Block primary;
+	primary.payloadType = uint8_t(data[pos]) & 0x7F;
+	primary.timestamp = timestamp;
+	primary.sequence = sequence;
+	++pos;
+	for (size_t i = 0; i < mBlocks.size(); ++i) {
+		auto &block = mBlocks[i];
+		block.sequence = uint16_t(sequence - uint16_t(mBlocks.size() - i));
+		block.offset = pos;
+		pos += block.size;
+	}
+	if (pos > size) {
+		mCounters->malformed.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+	primary.offset = pos;
+	primary.size = size - pos;
+
+	// Redundant blocks are oldest first, the ones not forwarded yet were lost or are late
+	for (const auto &block : mBlocks) {
+		if (block.size == 0 || isForwarded(block.timestamp) || isOlderThanWindow(block.timestamp))
+			continue;
+
+		result.push_back(forward(message, headerSize, block));
+		markForwarded(block.timestamp);
+		mCounters->recovered.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	if (primary.size == 0)
+		return;
+
+	// A late primary only duplicates a frame if it was recovered in the meantime
+	if (isForwarded(primary.timestamp)) {
+		mCounters->duplicates.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+
+	result.push_back(forward(message, headerSize, primary));
+	markForwarded(primary.timestamp);
+}
+
+rtc::message_ptr RedDepacketizer::forward(const rtc::message_ptr &message, size_t headerSize,
+                                          const Block &block) {
+	// Same header with the block payload type, sequence number and timestamp, without padding
+	auto packet = rtc::make_message(headerSize + block.size, rtc::Message::Binary);
+	byte *data = packet->data();
+	std::memcpy(data, message->data(), headerSize);
+	std::memcpy(data + headerSize, message->data() + block.offset, block.size);
+	data[0] &= byte(0xDF);
+	data[1] = (data[1] & byte(0x80)) | byte(block.payloadType);
+	data[2] = byte(block.sequence >> 8);
+	data[3] = byte(block.sequence & 0xFF);
+	write_u32(data + 4, block.timestamp);
+	return packet;
+}
+
+bool RedDepacketizer::isForwarded(uint32_t timestamp) const {
+	for (size_t i = 0; i < mForwardedCount; ++i)
+		if (mForwarded[i] == timestamp)
+			return true;
+
+	return false;
+}
+
+bool RedDepacketizer::isOlderThanWindow(uint32_t timestamp) const {
+	// Frames before the window may have been forwarded already, recovering them is pointless
+	if (mForwardedCount < WindowSize)
+		return false;
+
+	for (size_t i = 0; i < mForwardedCount; ++i)
+		if (int32_t(timestamp - mForwarded[i]) >= 0)
+			return false;
+
+	return true;
+}
+
+void RedDepacketizer::markForwarded(uint32_t timestamp) {
+	mForwarded[mForwardedNext] = timestamp;
+	mForwardedNext = (mForwardedNext + 1) % WindowSize;
+	if (mForwardedCount < WindowSize)
+		++mForwardedCount;
+}
+
+} // namespace rtcast
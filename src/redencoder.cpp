@@ -0,0 +1,110 @@
+/**
+ * Copyright (c) 2025 Paul-Louis Ageneau
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+#include "redencoder.hpp"
+
+#include <stdexcept>
+
+namespace rtcast {
+
+namespace {
+
+const uint32_t MaxTimestampOffset = (1 << 14) - 1; // 14-bit field
+const size_t MaxBlockSize = (1 << 10) - 1;         // 10-bit field
+const size_t BlockHeaderSize = 4;
+const size_t PrimaryHeaderSize = 1;
+const size_t MaxPayloadSize = 1200; // keeps packets under common MTUs
+
+} // namespace
+
+RedEncoder::RedEncoder(int payloadType, unsigned int distance)
+    : mPayloadType(uint8_t(payloadType)), mDistance(distance) {
+	if (payloadType < 0 || payloadType > 127)
+		throw std::invalid_argument("Invalid RED block payload type");
+
+	if (distance == 0 || distance > MaxDistance)
+		throw std::invalid_argument("Invalid RED distance");
+}
+
+shared_ptr<EncodedFrame> RedEncoder::encode(shared_ptr<const EncodedFrame> frame) {
+	// Select the most recent previous frames that fit, then write them oldest first
+	size_t size = PrimaryHeaderSize + frame->size();
+	size_t count = 0;
+	for (auto it = mHistory.rbegin(); it != mHistory.rend(); ++it) {
+		const auto &block = *it;
+		uint32_t offset = frame->rtpTimestamp - block->rtpTimestamp;
+		if (offset == 0 || offset > MaxTimestampOffset || block->size() > MaxBlockSize ||
+		    size + BlockHeaderSize + block->size() > MaxPayloadSize)
+			break;
+
+		size += BlockHeaderSize + block->size();
+		++count;
+	}
+
+	binary payload;
+	payload.reserve(size);
+	const auto first = mHistory.end() - std::ptrdiff_t(count);
+	for (auto it = first; it != mHistory.end(); ++it) {
+		uint32_t offset = frame->rtpTimestamp - (*it)->rtpTimestamp;
+		size_t length = (*it)->size();
+		payload.push_back(byte(0x80 | mPayloadType));
+		payload.push_back(byte(offset >> 6));
+		payload.push_back(byte((offset << 2 & 0xFC) | (length >> 8 & 0x03)));
+		payload.push_back(byte(length & 0xFF));
+	}
+	payload.push_back(byte(mPayloadType));
+	for (auto it = first; it != mHistory.end(); ++it)
+		payload.insert(payload.end(), (*it)->data(), (*it)->data() + (*it)->size());
+
+	payload.insert(payload.end(), frame->data(), frame->data() + frame->size());
+
+	auto red = EncodedFrame::Create(std::move(payload));
+	red->timestamp = frame->timestamp;
+	red->rtpTimestamp = frame->rtpTimestamp;
+
+	mHistory.push_back(std::move(frame));
+	if (mHistory.size() > mDistance)
+		mHistory.pop_front();
+
+	return red;
+}
+
+void RedEncoder::reset() { mHistory.clear(); }
+
+shared_ptr<EncodedFrame> RedEncoder::Relabel(const EncodedFrame &red, int payloadType) {
+	if (payloadType < 0 || payloadType > 127)
+		throw std::invalid_argument("Invalid RED block payload type");
+
+	// Block headers have the F bit set, the primary header ends them
+	binary payload(red.data(), red.data() + red.size());
+	size_t pos = 0;
+	while (pos < payload.size()) {
+		bool last = (uint8_t(payload[pos]) & 0x80) == 0;
+		payload[pos] = (payload[pos] & byte(0x80)) | byte(payloadType);
+		if (last)
+			break;
+
+		pos += BlockHeaderSize;
+	}
+
+	auto frame = EncodedFrame::Create(std::move(payload));
+	frame->timestamp = red.timestamp;
+	frame->rtpTimestamp = red.rtpTimestamp;
+	return frame;
+}
+
+string RedEncoder::Profile(int payloadType, unsigned int distance) {
+	string pt = std::to_string(payloadType);
+	string result = pt;
+	for (unsigned int i = 0; i < distance; ++i)
+		result += "/" + pt;
+
+	return result;
+}
+
+} // namespace rtcast
@@ -0,0 +1,186 @@
+/**
+ * Copyright (c) 2025 Paul-Louis Ageneau
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+#include "rtcpobserver.hpp"
+
+#include <cstring>
+
+namespace rtcast {
+
+namespace {
+
+const uint8_t SenderReportType = 200;
+const uint8_t ReceiverReportType = 201;
+const uint8_t TransportFeedbackType = 205; // RTPFB
+const uint8_t PayloadFeedbackType = 206;   // PSFB
+
+const uint8_t NackFormat = 1;
+const uint8_t PliFormat = 1;
+const uint8_t FirFormat = 4;
+const uint8_t AfbFormat = 15; // application layer feedback, used by REMB
+
+const size_t HeaderSize = 4;
+const size_t ReportBlockSize = 24;
+const size_t SenderInfoSize = 20;
+
+const uint64_t NtpEpochOffset = 2208988800ULL; // seconds between 1900 and 1970
+
+uint16_t read_u16(const byte *p) { return uint16_t(uint16_t(p[0]) << 8 | uint16_t(p[1])); }
+
+uint32_t read_u32(const byte *p) {
+	return uint32_t(p[0]) << 24 | uint32_t(p[1]) << 16 | uint32_t(p[2]) << 8 | uint32_t(p[3]);
+}
+
+// Middle 32 bits of the current NTP timestamp, as used in LSR and DLSR (1/65536 s units)
+uint32_t ntp_middle_now() {
+	auto now = std::chrono::system_clock::now().time_since_epoch();
+	auto us = std::chrono::duration_cast<std::chrono::microseconds>(now).count();
+	uint64_t seconds = uint64_t(us / 1000000) + NtpEpochOffset;
+	uint64_t fraction = (uint64_t(us % 1000000) << 16) / 1000000;
+	return uint32_t((seconds & 0xFFFF) << 16 | (fraction & 0xFFFF));
+}
+
+unsigned int popcount16(uint16_t v) {
+	unsigned int count = 0;
+	for (; v; v &= uint16_t(v - 1))
+		++count;
+	return count;
+}
+
+} // namespace
+
+RtcpObserver::RtcpObserver(uint32_t ssrc, Callbacks callbacks)
+    : mSsrc(ssrc), mCallbacks(std::move(callbacks)) {}
+
+void RtcpObserver::incoming(rtc::message_vector &messages,
+                            [[maybe_unused]] const rtc::message_callback &send) {
+	for (const auto &message : messages)
+		if (message && message->type == rtc::Message::Control)
+			parse(message->data(), message->size());
+}
+
+void RtcpObserver::parse(const byte *data, size_t size) {
+	// Compound packet
+	while (size >= HeaderSize) {
+		uint8_t first = uint8_t(data[0]);
+		if ((first >> 6) != 2)
+			return; // not RTCP version 2
+
+		uint8_t count = first & 0x1F;
+		uint8_t type = uint8_t(data[1]);
+		size_t length = (size_t(read_u16(data + 2)) + 1) * 4;
+		if (length > size)
+			return;
+
+		switch (type) {
+		case SenderReportType:
+			if (length >= 8 + SenderInfoSize)
+				parseReportBlocks(data + 8 + SenderInfoSize, length - 8 - SenderInfoSize, count);
+			break;
+
+		case ReceiverReportType:
+			if (length >= 8)
+				parseReportBlocks(data + 8, length - 8, count);
+			break;
+
+		case TransportFeedbackType:
+			if (count == NackFormat && length >= 12 && read_u32(data + 8) == mSsrc &&
+			    mCallbacks.nack) {
+				unsigned int lost = 0;
+				for (size_t i = 12; i + 4 <= length; i += 4)
+					lost += 1 + popcount16(read_u16(data + i + 2)); // PID and BLP
+				mCallbacks.nack(lost);
+			}
+			break;
+
+		case PayloadFeedbackType:
+			if (count == PliFormat && length >= 12 && read_u32(data + 8) == mSsrc) {
+				if (mCallbacks.keyframeRequest)
+					mCallbacks.keyframeRequest();
+
+			} else if (count == FirFormat) {
+				// FCI entries are SSRC and sequence number, repeated requests keep the same number
+				for (size_t i = 12; i + 8 <= length; i += 8) {
+					if (read_u32(data + i) != mSsrc)
+						continue;
+
+					uint8_t seq = uint8_t(data[i + 4]);
+					if (!mHasFirSequence || seq != mLastFirSequence) {
+						mHasFirSequence = true;
+						mLastFirSequence = seq;
+						if (mCallbacks.keyframeRequest)
+							mCallbacks.keyframeRequest();
+					}
+				}
+
+			} else if (count == AfbFormat && length >= 20 &&
+			           std::memcmp(data + 12, "REMB", 4) == 0) {
+				parseRemb(data + 16, length - 16);
+			}
+			break;
+
+		default:
+			break;
+		}
+
+		data += length;
+		size -= length;
+	}
+}
+
+void RtcpObserver::parseRemb(const byte *data, size_t size) {
+	// Number of SSRCs, 6-bit exponent and 18-bit mantissa, then the list of SSRCs
+	size_t count = size_t(uint8_t(data[0]));
+	if (size < 4 + count * 4 || !mCallbacks.remb)
+		return;
+
+	bool matches = count == 0;
+	for (size_t i = 0; i < count; ++i)
+		if (read_u32(data + 4 + i * 4) == mSsrc)
+			matches = true;
+
+	if (!matches)
+		return;
+
+	uint32_t value = read_u32(data) & 0xFFFFFF;
+	unsigned int exponent = value >> 18;
+	uint64_t mantissa = value & 0x3FFFF;
+	if (exponent > 45)
+		return; // overflow, not a meaningful bitrate
+
+	mCallbacks.remb(int64_t(mantissa << exponent));
+}
+
+void RtcpObserver::parseReportBlocks(const byte *data, size_t size, int count) {
+	for (int i = 0; i < count && size >= ReportBlockSize; ++i) {
+		if (read_u32(data) == mSsrc && mCallbacks.receiverReport) {
+			ReceiverReport report;
+			report.fractionLost = double(uint8_t(data[4])) / 256.;
+			uint32_t lost = read_u32(data + 4) & 0xFFFFFF;
+			report.cumulativeLost = (lost & 0x800000) ? int32_t(lost | 0xFF000000) : int32_t(lost);
+			report.highestSequence = read_u32(data + 8);
+			report.jitter = read_u32(data + 12);
+
+			// RTT = arrival - LSR - DLSR, in 1/65536 s units
+			uint32_t lsr = read_u32(data + 16);
+			uint32_t dlsr = read_u32(data + 20);
+			if (lsr != 0) {
+				uint32_t rtt = ntp_middle_now() - lsr - dlsr;
+				if (rtt < 0x80000000) // discard negative values due to clock jumps
+					report.rtt = std::chrono::microseconds(uint64_t(rtt) * 1000000 / 65536);
+			}
+
+			mCallbacks.receiverReport(report);
+		}
+
+		data += ReportBlockSize;
+		size -= ReportBlockSize;
+	}
+}
+
+} // namespace rtcast
@@ -0,0 +1,48 @@
+/**
+ * Copyright (c) 2025 Paul-Louis Ageneau
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+#include "sdp.hpp"
+
+#include <algorithm>
+#include <cctype>
+
+namespace rtcast {
+
+namespace sdp {
+
+namespace {
+
+string to_upper(string str) {
+	std::transform(str.begin(), str.end(), str.begin(), [](char c) {
+		return char(std::toupper(static_cast<unsigned char>(c)));
+	});
+	return str;
+}
+
+} // namespace
+
+optional<int> FindPayloadType(const rtc::Description::Media &media, const string &format) {
+	const string upper = to_upper(format);
+	for (int payloadType : media.payloadTypes())
+		if (auto map = media.rtpMap(payloadType); map && to_upper(map->format) == upper)
+			return payloadType;
+
+	return nullopt;
+}
+
+string FirstFormat(const rtc::Description::Media &media) {
+	for (int payloadType : media.payloadTypes())
+		if (auto map = media.rtpMap(payloadType))
+			return to_upper(map->format);
+
+	return "";
+}
+
+} // namespace sdp
+
+} // namespace rtcast
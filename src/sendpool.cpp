@@ -0,0 +1,168 @@
+/**
+ * Copyright (c) 2025 Paul-Louis Ageneau
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+#include "sendpool.hpp"
+#include "log.hpp"
+
+#include <stdexcept>
+
+namespace rtcast {
+
+namespace {
+
+const size_t MaxBatchSize = 4; // items sent before yielding to other queues
+
+} // namespace
+
+SendPool::SendPool(unsigned int threads) {
+	if (threads == 0)
+		throw std::invalid_argument("Send pool requires at least one thread");
+
+	for (unsigned int i = 0; i < threads; ++i)
+		mThreads.emplace_back(std::bind(&SendPool::run, this));
+}
+
+SendPool::~SendPool() {
+	{
+		std::lock_guard lock(mMutex);
+		mStopping = true;
+		mReady.clear();
+		mTasks.clear();
+	}
+	mCondition.notify_all();
+
+	for (auto &thread : mThreads)
+		thread.join();
+}
+
+shared_ptr<SendPool::Queue> SendPool::createQueue(handler func, size_t capacity,
+                                                  DropPolicy policy) {
+	return std::make_shared<Queue>(weak_from_this(), std::move(func), capacity, policy);
+}
+
+void SendPool::post(clock::time_point time, std::function<void()> task) {
+	{
+		std::lock_guard lock(mMutex);
+		if (mStopping)
+			return;
+
+		mTasks.emplace(time, std::move(task));
+	}
+	// Any waiting worker re-evaluates the earliest task
+	mCondition.notify_one();
+}
+
+unsigned int SendPool::threadsCount() const { return static_cast<unsigned int>(mThreads.size()); }
+
+void SendPool::schedule(shared_ptr<Queue> queue) {
+	{
+		std::lock_guard lock(mMutex);
+		if (mStopping)
+			return;
+
+		mReady.push_back(std::move(queue));
+	}
+	mCondition.notify_one();
+}
+
+void SendPool::run() {
+	while (true) {
+		shared_ptr<Queue> queue;
+		std::function<void()> task;
+		{
+			std::unique_lock lock(mMutex);
+			while (true) {
+				if (mStopping)
+					return;
+
+				if (!mTasks.empty() && mTasks.begin()->first <= clock::now()) {
+					task = std::move(mTasks.begin()->second);
+					mTasks.erase(mTasks.begin());
+					break;
+				}
+
+				if (!mReady.empty()) {
+					queue = std::move(mReady.front());
+					mReady.pop_front();
+					break;
+				}
+
+				if (mTasks.empty())
+					mCondition.wait(lock);
+				else
+					mCondition.wait_until(lock, mTasks.begin()->first);
+			}
+		}
+
+		if (task) {
+			try {
+				task();
+			} catch (const std::exception &e) {
+				RTCAST_LOG_LIMITED(LogLevel::Error, 1) << "Send task failed: " << e.what();
+			}
+			continue;
+		}
+
+		queue->drain(*this, MaxBatchSize);
+	}
+}
+
+SendPool::Queue::Queue(weak_ptr<SendPool> pool, handler func, size_t capacity, DropPolicy policy)
+    : mPool(std::move(pool)), mHandler(std::move(func)), mQueue(capacity, policy) {}
+
+bool SendPool::Queue::push(Item item) {
+	bool pushed = mQueue.push(std::move(item));
+
+	// The first pending push schedules the queue, the worker reschedules it as needed
+	if (mPending.fetch_add(1, std::memory_order_acq_rel) == 0)
+		if (auto pool = mPool.lock())
+			pool->schedule(shared_from_this());
+
+	return pushed;
+}
+
+void SendPool::Queue::close() { mQueue.close(); }
+
+void SendPool::Queue::setPolicy(DropPolicy policy) { mQueue.setPolicy(policy); }
+
+void SendPool::Queue::setDeadline(std::chrono::microseconds deadline) {
+	mQueue.setDeadline(deadline);
+}
+
+DropPolicy SendPool::Queue::policy() const { return mQueue.policy(); }
+
+size_t SendPool::Queue::size() const { return mQueue.size(); }
+
+size_t SendPool::Queue::capacity() const { return mQueue.capacity(); }
+
+SendPool::Queue::Stats SendPool::Queue::stats() const { return mQueue.stats(); }
+
+void SendPool::Queue::drain(SendPool &pool, size_t maxItems) {
+	size_t pending = mPending.load(std::memory_order_acquire);
+	for (size_t i = 0; i < maxItems; ++i) {
+		auto item = mQueue.tryPop();
+		if (!item) {
+			// Pushes since the load above keep the queue scheduled
+			if (mPending.fetch_sub(pending, std::memory_order_acq_rel) == pending)
+				return;
+
+			break;
+		}
+
+		try {
+			mHandler(item->value, item->enqueued);
+		} catch (const std::exception &e) {
+			RTCAST_LOG_LIMITED(LogLevel::Error, 1) << "Send failed: " << e.what();
+		}
+	}
+
+	// Batch exhausted or new pushes, yield to other queues
+	pool.schedule(shared_from_this());
+}
+
+} // namespace rtcast
@@ -0,0 +1,104 @@
+/**
+ * Copyright (c) 2025 Paul-Louis Ageneau
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+#include "sharedpacketizer.hpp"
+
+#include "rtc/rtc.hpp"
+
+#include <stdexcept>
+
+namespace rtcast {
+
+namespace {
+
+const size_t RtpHeaderSize = 12;
+
+uint32_t read_u32(const byte *p) {
+	return uint32_t(p[0]) << 24 | uint32_t(p[1]) << 16 | uint32_t(p[2]) << 8 | uint32_t(p[3]);
+}
+
+void write_u16(byte *p, uint16_t value) {
+	p[0] = byte(value >> 8);
+	p[1] = byte(value & 0xFF);
+}
+
+void write_u32(byte *p, uint32_t value) {
+	p[0] = byte(value >> 24);
+	p[1] = byte((value >> 16) & 0xFF);
+	p[2] = byte((value >> 8) & 0xFF);
+	p[3] = byte(value & 0xFF);
+}
+
+} // namespace
+
+SharedPacketizer::SharedPacketizer(shared_ptr<rtc::RtpPacketizer> packetizer)
+    : mPacketizer(std::move(packetizer)) {
+	if (!mPacketizer)
+		throw std::invalid_argument("Shared packetizer requires a packetizer");
+}
+
+SharedPacketizer::~SharedPacketizer() = default;
+
+shared_ptr<const SharedPacketizer::Frame>
+SharedPacketizer::packetize(const byte *data, size_t size, std::chrono::microseconds timestamp) {
+	auto message = rtc::make_message(data, data + size);
+	message->frameInfo =
+	    std::make_shared<rtc::FrameInfo>(std::chrono::duration<double>(timestamp));
+
+	rtc::message_vector messages{std::move(message)};
+	mPacketizer->outgoing(messages, [](rtc::message_ptr) {});
+
+	auto frame = std::make_shared<Frame>();
+	frame->packets.reserve(messages.size());
+	for (auto &packet : messages)
+		if (packet && packet->size() >= RtpHeaderSize)
+			frame->packets.push_back(std::move(packet));
+
+	if (!frame->packets.empty())
+		frame->timestamp = read_u32(frame->packets.front()->data() + 4);
+
+	return frame;
+}
+
+shared_ptr<SharedPacketizer::Session>
+SharedPacketizer::createSession(shared_ptr<rtc::RtpPacketizationConfig> config) const {
+	return std::make_shared<Session>(std::move(config), startTimestamp());
+}
+
+uint32_t SharedPacketizer::startTimestamp() const { return mPacketizer->rtpConfig->startTimestamp; }
+
+SharedPacketizer::Session::Session(shared_ptr<rtc::RtpPacketizationConfig> config,
+                                   uint32_t sourceStartTimestamp)
+    : mConfig(std::move(config)), mTimestampOffset(mConfig->startTimestamp - sourceStartTimestamp) {
+}
+
+size_t SharedPacketizer::Session::send(const Frame &frame, rtc::Track &track,
+                                      uint32_t timestampShift) {
+	return send(
+	    frame, [&track](binary packet) { track.send(std::move(packet)); }, timestampShift);
+}
+
+size_t SharedPacketizer::Session::send(const Frame &frame, const sink &func,
+                                      uint32_t timestampShift) {
+	// Keep the config in sync for the RtcpSrReporter
+	const uint32_t timestamp = frame.timestamp + mTimestampOffset + timestampShift;
+	mConfig->timestamp = timestamp;
+
+	for (const auto &shared : frame.packets) {
+		// The copy is required anyway since SRTP protects packets in place
+		binary packet(shared->begin(), shared->end());
+		write_u16(packet.data() + 2, mConfig->sequenceNumber++);
+		write_u32(packet.data() + 4, timestamp);
+		write_u32(packet.data() + 8, mConfig->ssrc);
+		func(std::move(packet));
+	}
+
+	return frame.packets.size();
+}
+
+} // namespace rtcast
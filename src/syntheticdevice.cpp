@@ -0,0 +1,344 @@
+/**
+ * Copyright (c) 2025 Paul-Louis Ageneau
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+#include "syntheticdevice.hpp"
+#include "log.hpp"
+
+extern "C" {
+#include <libavutil/imgutils.h>
+}
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace rtcast {
+
+namespace {
+
+const double Pi = 3.14159265358979323846;
+
+uint32_t xorshift32(uint32_t &state) {
+	state ^= state << 13;
+	state ^= state >> 17;
+	state ^= state << 5;
+	return state;
+}
+
+size_t video_buffer_size(const SyntheticVideoDevice::Settings &settings) {
+	if (settings.width <= 0 || settings.height <= 0 || settings.framerate <= 0)
+		throw std::invalid_argument("Invalid synthetic video settings");
+
+	int size = av_image_get_buffer_size(settings.pixelFormat, settings.width, settings.height, 1);
+	if (size < 0)
+		throw std::invalid_argument("Unsupported synthetic video pixel format");
+
+	return size_t(size);
+}
+
+// Checkerboard with gradients so that blocks are neither flat nor random
+uint8_t pattern(int component, int x, int y) {
+	switch (component) {
+	case 0:
+		return uint8_t(((x >> 5) ^ (y >> 5)) & 1 ? 180 + (x & 31) : 60 + (y & 31));
+	case 1:
+		return uint8_t(96 + ((x >> 3) & 63));
+	default:
+		return uint8_t(96 + ((y >> 3) & 63));
+	}
+}
+
+} // namespace
+
+SyntheticDevice::SyntheticDevice(Pacing pacing, size_t bufferSize)
+    : mPacing(pacing), mBuffers(std::make_shared<Buffers>()) {
+	if (mPacing.period.count() <= 0 || mPacing.buffersCount == 0)
+		throw std::invalid_argument("Invalid synthetic device pacing");
+
+	mBuffers->data.assign(mPacing.buffersCount, binary(bufferSize));
+	mBuffers->inUse.assign(mPacing.buffersCount, false);
+}
+
+SyntheticDevice::~SyntheticDevice() { stop(); }
+
+void SyntheticDevice::start() {
+	if (mRunning)
+		return;
+
+	if (mThread.joinable())
+		mThread.join(); // finished after maxFrames
+
+	if (!mEncoderStarted.exchange(true))
+		startEncoder();
+
+	mRunning = true;
+	mThread = std::thread(std::bind(&SyntheticDevice::run, this));
+}
+
+void SyntheticDevice::stop() {
+	{
+		// Under the lock so that a waiting producer cannot miss the notification
+		std::lock_guard lock(mBuffers->mutex);
+		mRunning = false;
+	}
+	mBuffers->condition.notify_all();
+	if (mThread.joinable())
+		mThread.join();
+
+	if (mEncoderStarted.exchange(false))
+		stopEncoder();
+}
+
+void SyntheticDevice::wait() {
+	if (mThread.joinable())
+		mThread.join();
+}
+
+SyntheticDevice::Stats SyntheticDevice::stats() const {
+	Stats stats;
+	stats.frames = mFrames.load(std::memory_order_relaxed);
+	stats.stalls = mStalls.load(std::memory_order_relaxed);
+	return stats;
+}
+
+optional<size_t> SyntheticDevice::acquire(bool wait) {
+	std::unique_lock lock(mBuffers->mutex);
+	auto &inUse = mBuffers->inUse;
+	auto it = inUse.end();
+	auto free = [&]() {
+		it = std::find(inUse.begin(), inUse.end(), false);
+		return it != inUse.end();
+	};
+
+	if (wait)
+		mBuffers->condition.wait(lock, [&]() { return !mRunning || free(); });
+	else
+		free();
+
+	if (it == inUse.end() || !mRunning)
+		return nullopt;
+
+	*it = true;
+	return size_t(it - inUse.begin());
+}
+
+void SyntheticDevice::run() {
+	RTCAST_LOG_DEBUG << "Starting synthetic capture loop";
+
+	using clock = std::chrono::steady_clock;
+	const auto start = clock::now();
+	for (uint64_t index = 0; mRunning; ++index) {
+		if (mPacing.maxFrames > 0 && index >= mPacing.maxFrames)
+			break;
+
+		if (mPacing.realtime)
+			std::this_thread::sleep_until(start + mPacing.period * index);
+
+		auto slot = acquire(!mPacing.realtime);
+		if (!slot) {
+			if (mRunning)
+				mStalls.fetch_add(1, std::memory_order_relaxed);
+
+			continue;
+		}
+
+		auto buffers = mBuffers;
+		size_t s = *slot;
+		auto finished = [buffers, s]() {
+			{
+				std::lock_guard lock(buffers->mutex);
+				buffers->inUse[s] = false;
+			}
+			buffers->condition.notify_all();
+		};
+
+		try {
+			produce(index, s, buffers->data[s].data(), std::move(finished));
+			mFrames.fetch_add(1, std::memory_order_relaxed);
+
+		} catch (const std::exception &e) {
+			RTCAST_LOG_LIMITED(LogLevel::Error, 1) << "Failed to push frame: " << e.what();
+		}
+	}
+
+	mRunning = false;
+}
+
+SyntheticVideoDevice::SyntheticVideoDevice(shared_ptr<VideoEncoder> encoder, Settings settings)
+    : SyntheticDevice({std::chrono::microseconds(1000000 / std::max(settings.framerate, 1)),
+                       settings.realtime, settings.maxFrames, settings.buffersCount},
+                      video_buffer_size(settings)),
+      mEncoder(std::move(encoder)), mSettings(std::move(settings)),
+      mDrawn(mSettings.buffersCount, false) {
+	switch (mSettings.pixelFormat) {
+	case AV_PIX_FMT_YUV420P:
+	case AV_PIX_FMT_YUV422P:
+	case AV_PIX_FMT_YUV444P:
+	case AV_PIX_FMT_NV12:
+	case AV_PIX_FMT_YUYV422:
+		break;
+	default:
+		throw std::invalid_argument("Unsupported synthetic video pixel format");
+	}
+
+	if (av_image_fill_linesizes(mLinesize, mSettings.pixelFormat, mSettings.width) < 0)
+		throw std::invalid_argument("Invalid synthetic video size");
+
+	mEncoder->setSize(mSettings.width, mSettings.height);
+	mEncoder->setFramerate(mSettings.framerate);
+}
+
+SyntheticVideoDevice::~SyntheticVideoDevice() { stop(); }
+
+void SyntheticVideoDevice::startEncoder() { mEncoder->start(); }
+
+void SyntheticVideoDevice::stopEncoder() { mEncoder->stop(); }
+
+void SyntheticVideoDevice::produce(uint64_t index, size_t slot, byte *buffer,
+                                   std::function<void()> finished) {
+	auto data = reinterpret_cast<uint8_t *>(buffer);
+	if (mSettings.motion != Motion::Static || !mDrawn[slot]) {
+		draw(index, data);
+		mDrawn[slot] = true;
+	}
+
+	VideoEncoder::InputFrame frame = {};
+	frame.ts = std::chrono::microseconds(int64_t(index) * 1000000 / mSettings.framerate);
+	frame.pixelFormat = mSettings.pixelFormat;
+	frame.width = mSettings.width;
+	frame.height = mSettings.height;
+	frame.finished = std::move(finished);
+
+	// A single contiguous plane, the encoder derives the plane pointers from the linesizes
+	VideoEncoder::Plane plane;
+	plane.data = data;
+	plane.size = video_buffer_size(mSettings);
+	frame.planes.push_back(plane);
+	for (int i = 0; i < 4 && mLinesize[i] > 0; ++i)
+		frame.linesize.push_back(mLinesize[i]);
+
+	mEncoder->push(std::move(frame));
+}
+
+void SyntheticVideoDevice::draw(uint64_t index, uint8_t *buffer) {
+	uint8_t *planes[4] = {};
+	av_image_fill_pointers(planes, mSettings.pixelFormat, mSettings.height, buffer, mLinesize);
+
+	const int shift = mSettings.motion == Motion::Scrolling ? int(index % 4096) * 4 : 0;
+	uint32_t state = uint32_t(index) * 2654435761u + 1;
+	auto sample = [&](int component, int x, int y) -> uint8_t {
+		if (mSettings.motion == Motion::Noise)
+			return uint8_t(xorshift32(state) >> 24);
+
+		return pattern(component, x + shift, y);
+	};
+
+	const int width = mSettings.width;
+	const int height = mSettings.height;
+	switch (mSettings.pixelFormat) {
+	case AV_PIX_FMT_YUYV422:
+		for (int y = 0; y < height; ++y) {
+			uint8_t *row = planes[0] + ptrdiff_t(y) * mLinesize[0];
+			for (int x = 0; x + 1 < width; x += 2) {
+				row[2 * x] = sample(0, x, y);
+				row[2 * x + 1] = sample(1, x, y);
+				row[2 * x + 2] = sample(0, x + 1, y);
+				row[2 * x + 3] = sample(2, x, y);
+			}
+		}
+		break;
+
+	case AV_PIX_FMT_NV12:
+		for (int y = 0; y < height; ++y) {
+			uint8_t *row = planes[0] + ptrdiff_t(y) * mLinesize[0];
+			for (int x = 0; x < width; ++x)
+				row[x] = sample(0, x, y);
+		}
+		for (int y = 0; y < (height + 1) / 2; ++y) {
+			uint8_t *row = planes[1] + ptrdiff_t(y) * mLinesize[1];
+			for (int x = 0; x < (width + 1) / 2; ++x) {
+				row[2 * x] = sample(1, 2 * x, 2 * y);
+				row[2 * x + 1] = sample(2, 2 * x, 2 * y);
+			}
+		}
+		break;
+
+	default: {
+		// Planar formats
+		int shiftX = mSettings.pixelFormat == AV_PIX_FMT_YUV444P ? 0 : 1;
+		int shiftY = mSettings.pixelFormat == AV_PIX_FMT_YUV420P ? 1 : 0;
+		for (int c = 0; c < 3; ++c) {
+			int sx = c > 0 ? shiftX : 0;
+			int sy = c > 0 ? shiftY : 0;
+			int planeWidth = (width + (1 << sx) - 1) >> sx;
+			int planeHeight = (height + (1 << sy) - 1) >> sy;
+			for (int y = 0; y < planeHeight; ++y) {
+				uint8_t *row = planes[c] + ptrdiff_t(y) * mLinesize[c];
+				for (int x = 0; x < planeWidth; ++x)
+					row[x] = sample(c, x << sx, y << sy);
+			}
+		}
+		break;
+	}
+	}
+}
+
+SyntheticAudioDevice::SyntheticAudioDevice(shared_ptr<AudioEncoder> encoder, Settings settings)
+    : SyntheticDevice({std::chrono::microseconds(int64_t(std::max(settings.frameSize, 1)) *
+                                                 1000000 / encoder->sampleRate()),
+                       settings.realtime, settings.maxFrames, settings.buffersCount},
+                      size_t(std::max(settings.frameSize, 1)) *
+                          size_t(encoder->channelsCount()) * sizeof(int16_t)),
+      mEncoder(std::move(encoder)), mSettings(std::move(settings)),
+      mSampleRate(mEncoder->sampleRate()), mChannels(mEncoder->channelsCount()) {
+	if (mSettings.frameSize <= 0 || mSettings.amplitude < 0. || mSettings.amplitude > 1.)
+		throw std::invalid_argument("Invalid synthetic audio settings");
+}
+
+SyntheticAudioDevice::~SyntheticAudioDevice() { stop(); }
+
+void SyntheticAudioDevice::startEncoder() { mEncoder->start(); }
+
+void SyntheticAudioDevice::stopEncoder() { mEncoder->stop(); }
+
+void SyntheticAudioDevice::produce([[maybe_unused]] uint64_t index, [[maybe_unused]] size_t slot,
+                                   byte *buffer, std::function<void()> finished) {
+	auto samples = reinterpret_cast<int16_t *>(buffer);
+	const double scale = mSettings.amplitude * 32767.;
+	const double step = 2. * Pi * mSettings.frequency / mSampleRate;
+	for (int i = 0; i < mSettings.frameSize; ++i) {
+		double value = 0.;
+		switch (mSettings.signal) {
+		case Signal::Tone:
+			value = std::sin(mPhase);
+			mPhase = std::fmod(mPhase + step, 2. * Pi);
+			break;
+		case Signal::Noise:
+			value = double(int32_t(xorshift32(mNoiseState))) / 2147483648.;
+			break;
+		case Signal::Silence:
+			break;
+		}
+
+		auto sample = int16_t(std::lround(value * scale));
+		for (int c = 0; c < mChannels; ++c)
+			samples[i * mChannels + c] = sample;
+	}
+
+	AudioEncoder::InputFrame frame = {};
+	frame.format = AV_SAMPLE_FMT_S16;
+	frame.sampleRate = mSampleRate;
+	frame.nbChannels = mChannels;
+	frame.nbSamples = mSettings.frameSize;
+	frame.data = buffer;
+	frame.size = size_t(mSettings.frameSize) * size_t(mChannels) * sizeof(int16_t);
+	frame.finished = std::move(finished);
+	mEncoder->push(std::move(frame));
+}
+
+} // namespace rtcast
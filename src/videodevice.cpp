@@ -7,12 +7,20 @@
  */
 
 #include "videodevice.hpp"
+#include "log.hpp"
 
-#include <iostream>
+#include <algorithm>
+#include <chrono>
 #include <stdexcept>
 
 namespace rtcast {
 
+namespace {
+
+const int DefaultFramerate = 30; // for timestamps if the input has none
+
+} // namespace
+
 VideoDevice::VideoDevice(string deviceName, shared_ptr<VideoEncoder> encoder, Settings settings)
     : mEncoder(encoder), mSettings(std::move(settings)) {
 	static std::once_flag onceFlag;
@@ -38,6 +46,9 @@ VideoDevice::VideoDevice(string deviceName, shared_ptr<VideoEncoder> encoder, Se
 	if (mSettings.framerate > 0) {
 		av_dict_set(&options, "framerate", std::to_string(mSettings.framerate).c_str(), 0);
 	}
+	if (!mSettings.inputFormat.empty()) {
+		av_dict_set(&options, "input_format", mSettings.inputFormat.c_str(), 0);
+	}
 
 	AVFormatContext *formatContext = nullptr;
 	if (avformat_open_input(&formatContext, deviceName.c_str(), inputFormat, &options) < 0)
@@ -63,6 +74,39 @@ VideoDevice::VideoDevice(string deviceName, shared_ptr<VideoEncoder> encoder, Se
 	if (!mInputStream)
 		throw std::runtime_error("Failed to find an input video stream");
 
+	const AVRational framerate = mInputStream->avg_frame_rate;
+	mFrameInterval = std::chrono::microseconds(
+	    framerate.num > 0 && framerate.den > 0 ? av_rescale(1000000, framerate.den, framerate.num)
+	                                           : 1000000 / DefaultFramerate);
+
+	const AVCodecParameters *parameters = mInputStream->codecpar;
+	bool forwardable =
+	    mSettings.passthrough && parameters->codec_id == mEncoder->codecID() &&
+	    (parameters->codec_id == AV_CODEC_ID_H264 || parameters->codec_id == AV_CODEC_ID_H265);
+	if (forwardable && parameters->video_delay > 0) {
+		// Reordered frames would be sent out of order with decreasing timestamps
+		RTCAST_LOG_INFO << "Input has frame reordering, transcoding";
+
+	} else if (forwardable) {
+		mNormalizer = std::make_unique<nal::AnnexBNormalizer>(
+		    parameters->codec_id == AV_CODEC_ID_H265,
+		    reinterpret_cast<const byte *>(parameters->extradata),
+		    size_t(std::max(parameters->extradata_size, 0)));
+
+		// Without parameter sets in extradata, the profile is checked on the first keyframe
+		const auto &sets = mNormalizer->parameterSets();
+		auto compatible = isForwardable(sets.data(), sets.size());
+		if (compatible.value_or(true)) {
+			mProfileChecked = compatible.has_value();
+			mPassthrough = true;
+			RTCAST_LOG_INFO << "Forwarding " << avcodec_get_name(parameters->codec_id)
+			                << " input without transcoding";
+		} else {
+			mNormalizer.reset();
+			RTCAST_LOG_INFO << "Input profile does not match the offered one, transcoding";
+		}
+	}
+
 	mInputCodec = avcodec_find_decoder(mInputStream->codecpar->codec_id);
 	if (!mInputCodec)
 		throw std::runtime_error("Failed to find codec for input video stream");
@@ -89,10 +133,9 @@ VideoDevice::VideoDevice(string deviceName, shared_ptr<VideoEncoder> encoder, Se
 VideoDevice::~VideoDevice() {}
 
 void VideoDevice::start() {
-	if (avcodec_open2(mInputCodecContext.get(), mInputCodec, NULL) < 0)
-		throw std::runtime_error("Failed to open codec for input video stream");
+	if (!mPassthrough)
+		startTranscoding();
 
-	mEncoder->start();
 	mRunning = true;
 	mThread = std::thread(std::bind(&VideoDevice::run, this));
 }
@@ -104,12 +147,17 @@ void VideoDevice::stop() {
 	}
 }
 
+void VideoDevice::startTranscoding() {
+	if (avcodec_open2(mInputCodecContext.get(), mInputCodec, NULL) < 0)
+		throw std::runtime_error("Failed to open codec for input video stream");
+
+	mEncoder->start();
+}
+
 void VideoDevice::run() {
-	std::cout << "Starting loop" << std::endl;
+	RTCAST_LOG_DEBUG << "Starting video capture loop";
 
-	auto frame = shared_ptr<AVFrame>(av_frame_alloc(), [](AVFrame *p) { av_frame_free(&p); });
-	if (!frame)
-		throw std::runtime_error("Failed to allocate frame");
+	auto frame = mFramePool->getEmpty();
 
 	auto packet = shared_ptr<AVPacket>(av_packet_alloc(), [](AVPacket *p) { av_packet_free(&p); });
 	if (!packet)
@@ -120,17 +168,83 @@ void VideoDevice::run() {
 		if (ret < 0)
 			throw std::runtime_error("Failed to read frame");
 
+		if (mPassthrough) {
+			if (forward(packet.get())) {
+				av_packet_unref(packet.get());
+				continue;
+			}
+
+			// Transcode from now on, starting with this keyframe
+			mPassthrough = false;
+			startTranscoding();
+		}
+
+		// Capture latency covers input decoding, the device does not expose when it sampled
+		auto received = std::chrono::steady_clock::now();
 		avcodec_send_packet(mInputCodecContext.get(), packet.get());
 		av_packet_unref(packet.get());
 
 		while ((ret = avcodec_receive_frame(mInputCodecContext.get(), frame.get())) == 0) {
+			mEncoder->recordLatency(PipelineStage::Capture,
+			                        std::chrono::duration_cast<std::chrono::microseconds>(
+			                            std::chrono::steady_clock::now() - received));
 			mEncoder->push(std::move(frame));
+			frame = mFramePool->getEmpty();
+		}
+	}
+}
 
-			frame = shared_ptr<AVFrame>(av_frame_alloc(), [](AVFrame *p) { av_frame_free(&p); });
-			if (!frame)
-				throw std::runtime_error("Failed to allocate frame");
+bool VideoDevice::forward(const AVPacket *packet) {
+	if (packet->size <= 0)
+		return true;
+
+	auto unit = mNormalizer->normalize(reinterpret_cast<const byte *>(packet->data),
+	                                   size_t(packet->size));
+
+	if (!mProfileChecked) {
+		// Nothing is decodable before a keyframe with parameter sets anyway
+		const byte *data =
+		    unit.data ? unit.data->data() : reinterpret_cast<const byte *>(packet->data);
+		size_t size = unit.data ? unit.data->size() : size_t(packet->size);
+		auto compatible = unit.keyframe ? isForwardable(data, size) : nullopt;
+		if (!compatible)
+			return true;
+
+		if (!*compatible) {
+			RTCAST_LOG_INFO << "Input profile does not match the offered one, transcoding";
+			return false;
 		}
+
+		mProfileChecked = true;
 	}
+
+	// The packet is referenced as-is unless it had to be rewritten
+	auto frame = unit.data ? EncodedFrame::Create(std::move(*unit.data))
+	                       : EncodedFrame::Create(packet);
+	frame->keyframe = unit.keyframe;
+
+	// Devices may not timestamp packets, continue at the frame rate from the previous one
+	int64_t pts = packet->pts != AV_NOPTS_VALUE ? packet->pts : packet->dts;
+	if (pts != AV_NOPTS_VALUE)
+		frame->timestamp = std::chrono::microseconds(
+		    av_rescale_q(pts, mInputStream->time_base, AVRational{1, 1000000}));
+	else
+		frame->timestamp = mLastTimestamp ? *mLastTimestamp + mFrameInterval
+		                                  : std::chrono::microseconds::zero();
+
+	mLastTimestamp = frame->timestamp;
+	mEncoder->pushEncoded(std::move(frame));
+	return true;
+}
+
+optional<bool> VideoDevice::isForwardable(const byte *data, size_t size) const {
+	// The endpoint offers the default profiles of libdatachannel: H264 Constrained Baseline
+	// (profile-level-id=42e01f with level asymmetry allowed, packetization-mode=1 so that any
+	// unit size is fragmented) and H265 Main
+	if (mInputStream->codecpar->codec_id == AV_CODEC_ID_H265)
+		return nal::IsH265Main(data, size);
+
+	return nal::IsH264ConstrainedBaseline(data, size);
 }
 
 } // namespace rtcast
@@ -7,10 +7,7 @@
  */
 
 #include "videoencoder.hpp"
-
-#ifndef _WIN32
-#include <sys/mman.h>
-#endif
+#include "log.hpp"
 
 #include <chrono>
 #include <iostream>
@@ -18,6 +15,12 @@
 
 namespace rtcast {
 
+namespace {
+
+const size_t ConversionQueueSize = 2;
+
+}
+
 extern "C" {
 
 static void free_buffer_release_func(void *opaque, [[maybe_unused]] uint8_t *data) {
@@ -35,7 +38,12 @@ static void free_buffer_shared_ptr(void *opaque, [[maybe_unused]] uint8_t *data)
 }
 
 VideoEncoder::VideoEncoder(string codecName, std::shared_ptr<Endpoint> endpoint)
-    : Encoder(std::move(codecName)), mEndpoint(std::move(endpoint)) {
+    : VideoEncoder(std::move(codecName), std::move(endpoint), 0) {}
+
+VideoEncoder::VideoEncoder(string codecName, std::shared_ptr<Endpoint> endpoint,
+                           unsigned int rendition)
+    : Encoder(std::move(codecName)), mEndpoint(std::move(endpoint)), mRendition(rendition),
+      mConversionQueue(ConversionQueueSize, DropPolicy::DropOldest) {
 
 	mCodecContext->pix_fmt = AV_PIX_FMT_YUV420P;
 	mCodecContext->sw_pix_fmt = AV_PIX_FMT_YUV420P;
@@ -56,6 +64,7 @@ VideoEncoder::VideoEncoder(string codecName, std::shared_ptr<Endpoint> endpoint)
 		mCodecContext->level = FF_LEVEL_UNKNOWN;
 		av_opt_set(mCodecContext->priv_data, "profile", "baseline", 0);
 		av_opt_set(mCodecContext->priv_data, "x264opts", "no-scenecut", 0);
+		av_opt_set(mCodecContext->priv_data, "forced-idr", "1", 0); // for requestKeyframe()
 		break;
 	case AV_CODEC_ID_H265:
 		endpointCodec = Endpoint::VideoCodec::H265;
@@ -73,7 +82,8 @@ VideoEncoder::VideoEncoder(string codecName, std::shared_ptr<Endpoint> endpoint)
 		throw std::runtime_error("Unsupported video codec");
 	}
 
-	mEndpoint->setVideo(endpointCodec);
+	if (mRendition == 0)
+		mEndpoint->setVideo(endpointCodec);
 
 	// Defaults
 	setSize(1280, 720);
@@ -103,10 +113,63 @@ void VideoEncoder::setColorSettings(ColorSettings settings) {
 	mCodecContext->color_range = settings.range;
 }
 
+void VideoEncoder::setConversionThreads(unsigned int threads) { mConversionThreads = threads; }
+
+void VideoEncoder::start() {
+	Encoder::start();
+	if (mConversionStage && mConversionThreads > 0) {
+		mConversionQueue.reopen();
+		mConversionThread = std::thread(std::bind(&VideoEncoder::runConversion, this));
+	}
+}
+
+void VideoEncoder::stop() {
+	if (mConversionThread.joinable()) {
+		mConversionQueue.close();
+		mConversionThread.join();
+	}
+	Encoder::stop();
+}
+
+void VideoEncoder::requestKeyframe(unsigned int rendition) {
+	if (rendition == mRendition)
+		requestKeyframe();
+}
+
+bool VideoEncoder::active() const { return mEndpoint->clientsCount() > 0; }
+
 void VideoEncoder::push(shared_ptr<AVFrame> frame) {
-	if(mEndpoint->clientsCount() == 0)
+	if(!active())
 		return; // no clients, no need to encode
 
+	auto origin = clock::now();
+	if (mConversionThread.joinable()) {
+		// The capture thread only hands the frame over
+		mConversionQueue.push({std::move(frame), origin});
+		return;
+	}
+
+	process(std::move(frame), origin);
+}
+
+void VideoEncoder::process(shared_ptr<AVFrame> frame, clock::time_point origin) {
+	enqueue(convert(std::move(frame)), origin);
+}
+
+void VideoEncoder::runConversion() {
+	while (auto item = mConversionQueue.pop()) {
+		try {
+			process(std::move(item->value.frame), item->value.origin);
+
+		} catch (const std::exception &e) {
+			RTCAST_LOG_LIMITED(LogLevel::Error, 1) << "Failed to convert video: " << e.what();
+		}
+	}
+}
+
+shared_ptr<AVFrame> VideoEncoder::convert(shared_ptr<AVFrame> frame) {
+	auto start = clock::now();
+
 	// MJPEG may output deprecated pixel formats
 	switch (static_cast<AVPixelFormat>(frame->format)) {
 	case AV_PIX_FMT_YUVJ420P:
@@ -124,54 +187,33 @@ void VideoEncoder::push(shared_ptr<AVFrame> frame) {
 		break;
 	}
 
+	bool compressRange =
+	    frame->color_range == AVCOL_RANGE_JPEG && mCodecContext->color_range == AVCOL_RANGE_MPEG;
 	if (frame->width == mCodecContext->width && frame->height == mCodecContext->height &&
-	    static_cast<AVPixelFormat>(frame->format) == mCodecContext->pix_fmt) {
-		Encoder::push(std::move(frame));
-		return;
-	}
+	    static_cast<AVPixelFormat>(frame->format) == mCodecContext->pix_fmt && !compressRange)
+		return frame;
 
-	auto framePixelFormat = static_cast<AVPixelFormat>(frame->format);
-	if (!mSwsContext || mSwsInputWidth != frame->width || mSwsInputHeight != frame->height ||
-	    mSwsInputPixelFormat != framePixelFormat) {
-		mSwsContext = unique_ptr_deleter<SwsContext>(
-		    sws_getContext(frame->width, frame->height, framePixelFormat, //
-		                   mCodecContext->width, mCodecContext->height, mCodecContext->pix_fmt,
-		                   SWS_FAST_BILINEAR | SWS_FULL_CHR_H_INT | SWS_ACCURATE_RND, NULL, NULL,
-		                   NULL),
-		    sws_freeContext);
-		if (!mSwsContext)
-			throw std::runtime_error("Failed to get SWS context");
-
-		mSwsInputWidth = frame->width;
-		mSwsInputHeight = frame->height;
-		mSwsInputPixelFormat = framePixelFormat;
-	}
+	unsigned int threads = std::max(mConversionThreads.load(), 1u);
+	if (!mConverter || mConverter->threadsCount() != threads)
+		mConverter = std::make_unique<FrameConverter>(threads);
 
-	auto converted = shared_ptr<AVFrame>(av_frame_alloc(), [](AVFrame *p) { av_frame_free(&p); });
-	if (!converted)
-		throw std::runtime_error("Failed to allocate AVFrame");
+	FramePool::VideoFormat poolFormat{mCodecContext->width, mCodecContext->height,
+	                                  mCodecContext->pix_fmt};
+	if (!mFramePool || mFramePool->videoFormat() != poolFormat)
+		mFramePool = FramePool::Create(poolFormat, mHugePages, mFramePoolCounters);
 
-	converted->width = mCodecContext->width;
-	converted->height = mCodecContext->height;
-	converted->format = mCodecContext->pix_fmt;
-	converted->color_range = frame->color_range;
+	auto converted = mFramePool->get();
+	converted->color_range = compressRange ? AVCOL_RANGE_MPEG : frame->color_range;
 	converted->time_base = frame->time_base;
 	converted->pts = frame->pts;
 
-	int ret = av_frame_get_buffer(converted.get(), 32);
-	if (ret < 0)
-		throw std::runtime_error("Failed to allocate buffer for converted frame");
-
-	ret = sws_scale(mSwsContext.get(), frame->data, frame->linesize, 0, frame->height,
-	                converted->data, converted->linesize);
-	if (ret < 0)
-		throw std::runtime_error("Video frame conversion failed");
-
-	Encoder::push(std::move(converted));
+	mConverter->convert(frame.get(), converted.get());
+	mLatency.record(PipelineStage::Convert, clock::now() - start);
+	return converted;
 }
 
 void VideoEncoder::push(InputFrame input) {
-	if(mEndpoint->clientsCount() == 0) {
+	if(!active()) {
 		// no clients, no need to encode
 		if (input.finished)
 			input.finished();
@@ -182,10 +224,7 @@ void VideoEncoder::push(InputFrame input) {
 	if (input.planes.empty())
 		throw std::logic_error("Input frame has no planes");
 
-	auto frame = shared_ptr<AVFrame>(av_frame_alloc(), [](AVFrame *p) { av_frame_free(&p); });
-	if (!frame)
-		throw std::runtime_error("Failed to allocate AVFrame");
-
+	auto frame = mEmptyFramePool->getEmpty();
 	frame->pts = input.ts.count();
 	frame->format = input.pixelFormat;
 	frame->width = input.width;
@@ -201,27 +240,29 @@ void VideoEncoder::push(InputFrame input) {
 		}
 	};
 	auto finishedWrapper = std::make_shared<FinishedWrapper>();
+	finishedWrapper->finished = std::move(input.finished); // also called if planes fail below
 
 	int nbPlanes = std::min(int(input.planes.size()), int(AV_NUM_DATA_POINTERS));
 	for (int i = 0; i < nbPlanes; ++i) {
 		auto &plane = input.planes[i];
 		if (plane.fd >= 0) {
-#ifdef _WIN32
-			throw std::logic_error("Memory mapping is not implemented on Windows");
-#else
-			plane.data = ::mmap(NULL, plane.size, PROT_READ, MAP_SHARED, plane.fd, 0);
-			if (plane.data == MAP_FAILED)
-				throw std::runtime_error("Memory mapping failed");
-
-			auto release = new std::function<void()>(
-			    [plane, finishedWrapper]() { ::munmap(plane.data, plane.size); });
-			frame->buf[i] = av_buffer_create(reinterpret_cast<uint8_t *>(plane.data), plane.size,
-			                                 free_buffer_release_func, release, 0);
-#endif
+			auto mapping = mMappings.map(plane.fd, plane.size);
+			mapping->beginAccess();
+			auto release = new std::function<void()>([mapping, finishedWrapper]() {
+				mapping->endAccess();
+			});
+			frame->buf[i] = av_buffer_create(mapping->data(), plane.size, free_buffer_release_func,
+			                                 release, 0);
+			if (!frame->buf[i]) {
+				delete release;
+				mapping->endAccess();
+			}
 		} else {
-			frame->buf[i] =
-			    av_buffer_create(reinterpret_cast<uint8_t *>(plane.data), plane.size,
-			                     free_buffer_shared_ptr, new shared_ptr<void>(finishedWrapper), 0);
+			auto owner = new shared_ptr<void>(finishedWrapper);
+			frame->buf[i] = av_buffer_create(reinterpret_cast<uint8_t *>(plane.data), plane.size,
+			                                 free_buffer_shared_ptr, owner, 0);
+			if (!frame->buf[i])
+				delete owner;
 		}
 
 		if(!frame->buf[i])
@@ -236,14 +277,25 @@ void VideoEncoder::push(InputFrame input) {
 			frame->data[i] = frame->buf[i]->data;
 	}
 
-	finishedWrapper->finished = std::move(input.finished);
 	push(std::move(frame));
 }
 
+void VideoEncoder::releaseMapping(int fd) { mMappings.evict(fd); }
+
+DmaBufCache::Stats VideoEncoder::mappingStats() const { return mMappings.stats(); }
+
+void VideoEncoder::pushEncoded(shared_ptr<EncodedFrame> frame) {
+	// Frames are cheap to forward, keep the GOP cache warm even without clients
+	frame->rendition = mRendition;
+	mEndpoint->broadcastVideo(std::move(frame));
+}
+
 void VideoEncoder::output(AVPacket *packet) {
 	int64_t usecs = av_rescale_q(packet->pts, mCodecContext->time_base, AVRational{1, 1000000});
-	mEndpoint->broadcastVideo(reinterpret_cast<const byte *>(packet->data), packet->size,
-	                          std::chrono::microseconds(usecs));
+	auto frame = EncodedFrame::Create(packet);
+	frame->timestamp = std::chrono::microseconds(usecs);
+	frame->rendition = mRendition;
+	mEndpoint->broadcastVideo(std::move(frame));
 }
 
 } // namespace rtcast
@@ -0,0 +1,148 @@
+/**
+ * Copyright (c) 2025 Paul-Louis Ageneau
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+#include "videoencodergroup.hpp"
+#include "log.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace rtcast {
+
+class VideoEncoderGroup::Lower final : public VideoEncoder {
+public:
+	Lower(string codecName, shared_ptr<Endpoint> endpoint, unsigned int rendition)
+	    : VideoEncoder(std::move(codecName), std::move(endpoint), rendition) {
+		mConversionStage = false; // fed by the group
+	}
+
+	~Lower() { stop(); }
+
+	// Scales and encodes the frame, returns the scaled frame for the next rendition
+	shared_ptr<AVFrame> feed(shared_ptr<AVFrame> frame, clock::time_point origin) {
+		auto scaled = convert(std::move(frame));
+		enqueue(scaled, origin);
+		return scaled;
+	}
+};
+
+VideoEncoderGroup::VideoEncoderGroup(string codecName, shared_ptr<Endpoint> endpoint,
+                                     std::vector<Rendition> renditions)
+    : VideoEncoder(codecName, endpoint), mRenditions(std::move(renditions)) {
+	if (mRenditions.empty())
+		throw std::invalid_argument("Encoder group requires at least one rendition");
+
+	for (size_t i = 1; i < mRenditions.size(); ++i) {
+		// A rendition of the same size would share its frames with the previous encoder
+		const auto &larger = mRenditions[i - 1];
+		const auto &rendition = mRenditions[i];
+		if (rendition.width > larger.width || rendition.height > larger.height ||
+		    (rendition.width == larger.width && rendition.height == larger.height))
+			throw std::invalid_argument("Renditions must be ordered by decreasing size");
+	}
+
+	std::vector<int64_t> bitrates;
+	for (const auto &rendition : mRenditions)
+		bitrates.push_back(rendition.bitrate);
+
+	mEndpoint->setRenditions(std::move(bitrates));
+
+	VideoEncoder::setSize(mRenditions[0].width, mRenditions[0].height);
+	setBitrate(mRenditions[0].bitrate);
+
+	for (size_t i = 1; i < mRenditions.size(); ++i) {
+		auto lower = std::make_unique<Lower>(codecName, endpoint, static_cast<unsigned int>(i));
+		lower->setSize(mRenditions[i].width, mRenditions[i].height);
+		lower->setBitrate(mRenditions[i].bitrate);
+		mLowers.push_back(std::move(lower));
+	}
+}
+
+VideoEncoderGroup::~VideoEncoderGroup() { stop(); }
+
+unsigned int VideoEncoderGroup::renditionsCount() const {
+	return static_cast<unsigned int>(mRenditions.size());
+}
+
+const VideoEncoderGroup::Rendition &VideoEncoderGroup::rendition(unsigned int index) const {
+	return mRenditions.at(index);
+}
+
+void VideoEncoderGroup::setRenditionBitrate(unsigned int rendition, int64_t bitrate) {
+	bitrate = std::min(bitrate, mRenditions.at(rendition).bitrate);
+	if (rendition == 0)
+		setBitrate(bitrate);
+	else
+		mLowers[rendition - 1]->setBitrate(bitrate);
+}
+
+VideoEncoder::Stats VideoEncoderGroup::renditionStats(unsigned int rendition) const {
+	if (rendition >= mRenditions.size())
+		throw std::out_of_range("Invalid rendition");
+
+	return rendition == 0 ? stats() : mLowers[rendition - 1]->stats();
+}
+
+void VideoEncoderGroup::setSize(int width, int height) {
+	RTCAST_LOG_DEBUG << "Encoder group input size: " << width << "x" << height;
+}
+
+void VideoEncoderGroup::setFramerate(AVRational framerate) {
+	VideoEncoder::setFramerate(framerate);
+	for (auto &lower : mLowers)
+		lower->setFramerate(framerate);
+}
+
+void VideoEncoderGroup::setGopSize(int gopsize) {
+	VideoEncoder::setGopSize(gopsize);
+	for (auto &lower : mLowers)
+		lower->setGopSize(gopsize);
+}
+
+void VideoEncoderGroup::setColorSettings(ColorSettings settings) {
+	VideoEncoder::setColorSettings(settings);
+	for (auto &lower : mLowers)
+		lower->setColorSettings(settings);
+}
+
+void VideoEncoderGroup::setConversionThreads(unsigned int threads) {
+	VideoEncoder::setConversionThreads(threads);
+	for (auto &lower : mLowers)
+		lower->setConversionThreads(threads);
+}
+
+void VideoEncoderGroup::requestKeyframe(unsigned int rendition) {
+	if (rendition == 0)
+		requestKeyframe();
+	else if (rendition < mRenditions.size())
+		mLowers[rendition - 1]->requestKeyframe();
+}
+
+void VideoEncoderGroup::start() {
+	for (auto &lower : mLowers)
+		lower->start();
+
+	VideoEncoder::start();
+}
+
+void VideoEncoderGroup::stop() {
+	VideoEncoder::stop();
+	for (auto &lower : mLowers)
+		lower->stop();
+}
+
+void VideoEncoderGroup::process(shared_ptr<AVFrame> frame, clock::time_point origin) {
+	// Encoders run in parallel, scaling cascades down the ladder
+	auto scaled = convert(std::move(frame));
+	enqueue(scaled, origin);
+
+	for (auto &lower : mLowers)
+		scaled = lower->feed(std::move(scaled), origin);
+}
+
+} // namespace rtcast
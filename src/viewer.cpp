@@ -0,0 +1,311 @@
+/**
+ * Copyright (c) 2025 Paul-Louis Ageneau
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+#include "viewer.hpp"
+#include "log.hpp"
+#include "reddepacketizer.hpp"
+#include "sdp.hpp"
+
+#include "nlohmann/json.hpp"
+#include "rtc/rtc.hpp"
+
+#include <cmath>
+#include <stdexcept>
+
+namespace rtcast {
+
+using json = nlohmann::json;
+
+namespace {
+
+const size_t RtpHeaderSize = 12;
+const uint32_t VideoClockRate = 90000;
+const uint32_t AudioClockRate = 48000;
+const uint32_t NarrowbandClockRate = 8000; // PCMU and PCMA
+
+uint16_t read_u16(const byte *p) { return uint16_t(uint16_t(p[0]) << 8 | uint16_t(p[1])); }
+
+uint32_t read_u32(const byte *p) {
+	return uint32_t(p[0]) << 24 | uint32_t(p[1]) << 16 | uint32_t(p[2]) << 8 | uint32_t(p[3]);
+}
+
+int64_t steady_microseconds(std::chrono::steady_clock::time_point time) {
+	return std::chrono::duration_cast<std::chrono::microseconds>(time.time_since_epoch()).count();
+}
+
+} // namespace
+
+// Parses RTP headers before depacketization, messages are left untouched
+// Must be chained last on the track so that it sees packets before any depacketizer.
+class Viewer::StatsObserver final : public rtc::MediaHandler {
+public:
+	StatsObserver(shared_ptr<Counters> counters, uint32_t clockRate)
+	    : mCounters(std::move(counters)), mClockRate(clockRate) {}
+
+	void incoming(rtc::message_vector &messages,
+	              [[maybe_unused]] const rtc::message_callback &send) override {
+		const int64_t now = steady_microseconds(std::chrono::steady_clock::now());
+		for (const auto &message : messages) {
+			if (!message || message->type != rtc::Message::Binary ||
+			    message->size() < RtpHeaderSize)
+				continue;
+
+			const byte *data = message->data();
+			if ((uint8_t(data[0]) >> 6) != 2)
+				continue; // not RTP version 2
+
+			mCounters->packets.fetch_add(1, std::memory_order_relaxed);
+			mCounters->bytes.fetch_add(message->size(), std::memory_order_relaxed);
+			record(read_u16(data + 2), read_u32(data + 4), now);
+		}
+	}
+
+private:
+	void record(uint16_t sequence, uint32_t timestamp, int64_t arrivalUs) {
+		// Extended sequence number, a large backward step is a wrap-around
+		if (!mHasSequence) {
+			mBaseSequence = mHighestSequence = sequence;
+			mHasSequence = true;
+
+		} else {
+			int64_t delta = int64_t(int16_t(uint16_t(sequence - uint16_t(mHighestSequence))));
+			if (delta > 0)
+				mHighestSequence += uint64_t(delta);
+		}
+		mCounters->expected.store(mHighestSequence - mBaseSequence + 1, std::memory_order_relaxed);
+
+		// Interarrival jitter in timestamp units, J += (|D| - J) / 16
+		double arrival = double(arrivalUs) * double(mClockRate) / 1e6;
+		double transit = arrival - double(timestamp);
+		if (mHasTransit) {
+			double d = std::abs(transit - mLastTransit);
+			mJitter += (d - mJitter) / 16.;
+			mCounters->jitterUs.store(mJitter * 1e6 / double(mClockRate),
+			                          std::memory_order_relaxed);
+		}
+		mLastTransit = transit;
+		mHasTransit = true;
+	}
+
+	const shared_ptr<Counters> mCounters;
+	const uint32_t mClockRate;
+
+	// Owned by the transport thread
+	uint64_t mBaseSequence = 0;
+	uint64_t mHighestSequence = 0;
+	bool mHasSequence = false;
+	double mLastTransit = 0.;
+	bool mHasTransit = false;
+	double mJitter = 0.;
+};
+
+Viewer::Viewer(Settings settings)
+    : mSettings(std::move(settings)), mVideoCounters(std::make_shared<Counters>()),
+      mAudioCounters(std::make_shared<Counters>()) {}
+
+Viewer::~Viewer() { close(); }
+
+void Viewer::open() {
+	if (mWebSocket)
+		throw std::logic_error("Viewer is already open");
+
+	auto weak = weak_from_this();
+	mOpenedAt = clock::now();
+
+	rtc::Configuration config;
+	for (const auto &server : mSettings.iceServers)
+		config.iceServers.emplace_back(server);
+
+	config.bindAddress = mSettings.bindAddress;
+	mPeerConnection = std::make_shared<rtc::PeerConnection>(std::move(config));
+
+	mPeerConnection->onStateChange([weak](rtc::PeerConnection::State state) {
+		auto viewer = weak.lock();
+		if (!viewer)
+			return;
+
+		RTCAST_LOG_DEBUG << "Viewer state: " << state;
+		using State = rtc::PeerConnection::State;
+		switch (state) {
+		case State::Connected: {
+			auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+			    clock::now() - viewer->mOpenedAt);
+			viewer->mConnectedUs = elapsed.count();
+			viewer->mConnected = true;
+			break;
+		}
+		case State::Disconnected:
+		case State::Failed:
+			viewer->mFailed = true;
+			viewer->mConnected = false;
+			break;
+		case State::Closed:
+			viewer->mConnected = false;
+			break;
+		default:
+			break;
+		}
+	});
+
+	mPeerConnection->onTrack([weak](shared_ptr<rtc::Track> track) {
+		if (auto viewer = weak.lock())
+			viewer->setupTrack(std::move(track));
+	});
+
+	mPeerConnection->onDataChannel([weak](shared_ptr<rtc::DataChannel> dc) {
+		if (auto viewer = weak.lock()) {
+			std::lock_guard lock(viewer->mMutex);
+			viewer->mDataChannel = std::move(dc);
+		}
+	});
+
+	mWebSocket = std::make_shared<rtc::WebSocket>();
+
+	// Same messages as client.js
+	mPeerConnection->onLocalDescription([weak](rtc::Description description) {
+		if (auto viewer = weak.lock()) {
+			json message = {{"type", description.typeString()},
+			                {"description", string(description)}};
+			viewer->mWebSocket->send(message.dump());
+		}
+	});
+
+	mPeerConnection->onLocalCandidate([weak](rtc::Candidate candidate) {
+		if (auto viewer = weak.lock()) {
+			json message = {
+			    {"type", "candidate"}, {"candidate", string(candidate)}, {"mid", candidate.mid()}};
+			viewer->mWebSocket->send(message.dump());
+		}
+	});
+
+	mWebSocket->onError([weak](string error) {
+		RTCAST_LOG_WARNING << "Viewer WebSocket failed: " << error;
+		if (auto viewer = weak.lock())
+			viewer->mFailed = true;
+	});
+
+	mWebSocket->onMessage([weak](auto data) {
+		auto viewer = weak.lock();
+		if (!viewer || !std::holds_alternative<string>(data))
+			return;
+
+		try {
+			viewer->handleMessage(std::get<string>(data));
+
+		} catch (const std::exception &e) {
+			RTCAST_LOG_WARNING << "Viewer signaling failed: " << e.what();
+			viewer->mFailed = true;
+		}
+	});
+
+	mWebSocket->open(mSettings.url);
+}
+
+void Viewer::close() {
+	if (mWebSocket)
+		mWebSocket->close();
+
+	if (mPeerConnection)
+		mPeerConnection->close();
+}
+
+bool Viewer::isConnected() const { return mConnected; }
+
+bool Viewer::hasFailed() const { return mFailed; }
+
+void Viewer::handleMessage(const string &message) {
+	json parsed = json::parse(message);
+	auto type = parsed["type"].get<string>();
+	if (type == "offer" || type == "answer") {
+		// The answer is generated and sent by onLocalDescription
+		auto sdp = parsed["description"].get<string>();
+		mPeerConnection->setRemoteDescription(rtc::Description(sdp, type));
+
+	} else if (type == "candidate") {
+		auto sdp = parsed["candidate"].get<string>();
+		auto mid = parsed["mid"].get<string>();
+		mPeerConnection->addRemoteCandidate(rtc::Candidate(sdp, mid));
+	}
+}
+
+void Viewer::setupTrack(shared_ptr<rtc::Track> track) {
+	auto media = track->description();
+	const string format = sdp::FirstFormat(media);
+	const bool video = media.type() == "video";
+
+	shared_ptr<Counters> counters;
+	uint32_t clockRate;
+	if (video) {
+		counters = mVideoCounters;
+		clockRate = VideoClockRate;
+		if (format == "H264")
+			track->chainMediaHandler(std::make_shared<rtc::H264RtpDepacketizer>(
+			    rtc::H264RtpDepacketizer::Separator::ShortStartSequence));
+		else if (format == "H265")
+			track->chainMediaHandler(std::make_shared<rtc::H265RtpDepacketizer>(
+			    rtc::H265RtpDepacketizer::Separator::ShortStartSequence));
+		else
+			RTCAST_LOG_WARNING << "Viewer cannot depacketize video format " << format;
+
+	} else {
+		counters = mAudioCounters;
+		clockRate = format == "PCMU" || format == "PCMA" ? NarrowbandClockRate : AudioClockRate;
+		track->chainMediaHandler(std::make_shared<rtc::RtpDepacketizer>(clockRate));
+
+		// Frames recovered from redundant blocks are counted as received
+		if (auto payloadType = sdp::FindPayloadType(media, "red"))
+			track->chainMediaHandler(std::make_shared<RedDepacketizer>(*payloadType));
+	}
+
+	// Receiver reports feed the endpoint's congestion state and bandwidth estimation
+	track->chainMediaHandler(std::make_shared<rtc::RtcpReceivingSession>());
+	track->chainMediaHandler(std::make_shared<StatsObserver>(counters, clockRate));
+
+	track->onFrame([counters](binary, rtc::FrameInfo) {
+		int64_t now = steady_microseconds(clock::now());
+		int64_t unset = -1;
+		counters->firstFrameUs.compare_exchange_strong(unset, now, std::memory_order_relaxed);
+		counters->lastFrameUs.store(now, std::memory_order_relaxed);
+		counters->frames.fetch_add(1, std::memory_order_relaxed);
+	});
+
+	std::lock_guard lock(mMutex);
+	mTracks.push_back(std::move(track));
+}
+
+Viewer::TrackStats Viewer::Collect(const Counters &counters, clock::time_point openedAt) {
+	TrackStats stats;
+	stats.frames = counters.frames.load(std::memory_order_relaxed);
+	stats.packets = counters.packets.load(std::memory_order_relaxed);
+	stats.bytes = counters.bytes.load(std::memory_order_relaxed);
+	uint64_t expected = counters.expected.load(std::memory_order_relaxed);
+	stats.lost = expected > stats.packets ? expected - stats.packets : 0;
+	stats.jitter =
+	    std::chrono::microseconds(int64_t(counters.jitterUs.load(std::memory_order_relaxed)));
+
+	int64_t first = counters.firstFrameUs.load(std::memory_order_relaxed);
+	int64_t last = counters.lastFrameUs.load(std::memory_order_relaxed);
+	if (first >= 0) {
+		stats.timeToFirstFrame = std::chrono::microseconds(first - steady_microseconds(openedAt));
+		if (last > first && stats.frames > 1)
+			stats.framerate = double(stats.frames - 1) * 1e6 / double(last - first);
+	}
+	return stats;
+}
+
+Viewer::Stats Viewer::stats() const {
+	Stats stats;
+	if (int64_t connected = mConnectedUs; connected >= 0)
+		stats.timeToConnected = std::chrono::microseconds(connected);
+
+	stats.video = Collect(*mVideoCounters, mOpenedAt);
+	stats.audio = Collect(*mAudioCounters, mOpenedAt);
+	return stats;
+}
+
+} // namespace rtcast